@@ -16,6 +16,12 @@ BrewEngine::BrewEngine(SettingsManager *settingsManager)
 {
 	ESP_LOGI(TAG, "BrewEngine Construct");
 	this->settingsManager = settingsManager;
+	this->sensorMutex = xSemaphoreCreateMutex();
+	this->runStateMutex = xSemaphoreCreateMutex();
+	this->programMutex = xSemaphoreCreateMutex();
+	this->liveMutex = xSemaphoreCreateMutex();
+	this->taskMutex = xSemaphoreCreateMutex();
+	this->commandStats.resize(BrewEngine::commands().size());
 	mainInstance = this;
 }
 
@@ -64,17 +70,44 @@ void BrewEngine::Init()
 
 	this->readTempSensorSettings();
 
-	this->initOneWire();
+	this->initBuses();
 
 	this->detectOnewireTemperatureSensors();
 
+	this->initSensorDrivers();
+
+	// without the partition (older partition table) we just don't keep sessions
+	esp_err_t err = this->brewLog.Init(BREWLOG_PARTITION);
+	if (err != ESP_OK)
+	{
+		ESP_LOGW(TAG, "Brew log not available: %s", esp_err_to_name(err));
+	}
+
 	this->initMqtt();
 
 	this->run = true;
 
-	xTaskCreate(&this->readLoop, "readloop_task", 4096, this, 5, NULL);
+	// every bus gets its own acquisition task so they are sampled concurrently
+	for (auto const &bus : this->temperatureBuses)
+	{
+		if (!bus->ready)
+		{
+			continue;
+		}
+
+		string taskName = "readloop_" + to_string(bus->id);
+		this->createTask(&this->readLoop, taskName.c_str(), 4096, bus, 5, &bus->readLoopHandle);
+	}
+
+	// sensors are running, so the pid has a temperature when we continue a program
+	// it waits for ntp, so it gets its own task
+	xTaskCreate(&this->resumeLoop, "resume_task", 6144, this, 4, NULL);
+
+	this->mountWebFiles();
 
 	this->server = this->startWebserver();
+
+	this->createTask(&this->pushLoop, "pushloop_task", 6144, this, 4, &this->pushLoopHandle);
 }
 
 void BrewEngine::initHeaters()
@@ -94,10 +127,11 @@ void BrewEngine::readSystemSettings()
 	ESP_LOGI(TAG, "Reading System Settings");
 
 	// io settings
-	this->oneWire_PIN = (gpio_num_t)this->settingsManager->Read("onewirePin", (uint16_t)CONFIG_ONEWIRE);
+	this->readTemperatureBusSettings();
 	this->stir_PIN = (gpio_num_t)this->settingsManager->Read("stirPin", (uint16_t)CONFIG_STIR);
 	this->buzzer_PIN = (gpio_num_t)this->settingsManager->Read("buzzerPin", (uint16_t)CONFIG_BUZZER);
 	this->buzzerTime = this->settingsManager->Read("buzzerTime", (uint8_t)2);
+	this->tempReadInterval = this->settingsManager->Read("tempInterval", (uint16_t)1000);
 
 	bool configInvertOutputs = false;
 // is there a cleaner way to do this?, config to bool doesn't seem to work properly
@@ -124,37 +158,50 @@ void BrewEngine::saveSystemSettingsJson(const json &config)
 {
 	ESP_LOGI(TAG, "Saving System Settings");
 
-	if (!config["onewirePin"].is_null() && config["onewirePin"].is_number())
+	if (config.contains("onewireBuses") && config["onewireBuses"].is_array())
 	{
-		this->settingsManager->Write("onewirePin", (uint16_t)config["onewirePin"]);
-		this->oneWire_PIN = (gpio_num_t)config["onewirePin"];
+		// buses are only created at boot, so we only save them here
+		this->saveTemperatureBusSettings(config["onewireBuses"]);
 	}
-	if (!config["stirPin"].is_null() && config["stirPin"].is_number())
+	if (config.contains("stirPin") && config["stirPin"].is_number())
 	{
 		this->settingsManager->Write("stirPin", (uint16_t)config["stirPin"]);
 		this->stir_PIN = (gpio_num_t)config["stirPin"];
 	}
-	if (!config["buzzerPin"].is_null() && config["buzzerPin"].is_number())
+	if (config.contains("buzzerPin") && config["buzzerPin"].is_number())
 	{
 		this->settingsManager->Write("buzzerPin", (uint16_t)config["buzzerPin"]);
 		this->buzzer_PIN = (gpio_num_t)config["buzzerPin"];
 	}
-	if (!config["buzzerTime"].is_null() && config["buzzerTime"].is_number())
+	if (config.contains("buzzerTime") && config["buzzerTime"].is_number())
 	{
 		this->settingsManager->Write("buzzerTime", (uint8_t)config["buzzerTime"]);
 		this->buzzerTime = (uint8_t)config["buzzerTime"];
 	}
-	if (!config["invertOutputs"].is_null() && config["invertOutputs"].is_boolean())
+	if (config.contains("tempReadInterval") && config["tempReadInterval"].is_number())
+	{
+		uint16_t interval = (uint16_t)config["tempReadInterval"];
+
+		// the read loop never goes faster then the slowest conversion, but we need a sane minimum
+		if (interval < TEMP_READ_INTERVAL_MIN)
+		{
+			interval = TEMP_READ_INTERVAL_MIN;
+		}
+
+		this->settingsManager->Write("tempInterval", interval); // key is limited to x chars so we shorten it
+		this->tempReadInterval = interval;
+	}
+	if (config.contains("invertOutputs") && config["invertOutputs"].is_boolean())
 	{
 		this->settingsManager->Write("invertOutputs", (bool)config["invertOutputs"]);
 		this->invertOutputs = (bool)config["invertOutputs"];
 	}
-	if (!config["mqttUri"].is_null() && config["mqttUri"].is_string())
+	if (config.contains("mqttUri") && config["mqttUri"].is_string())
 	{
 		this->settingsManager->Write("mqttUri", (string)config["mqttUri"]);
 		this->mqttUri = config["mqttUri"];
 	}
-	if (!config["temperatureScale"].is_null() && config["temperatureScale"].is_number())
+	if (config.contains("temperatureScale") && config["temperatureScale"].is_number())
 	{
 		uint8_t scale = (uint8_t)config["temperatureScale"];
 		this->settingsManager->Write("tempScale", scale); // key is limited to x chars so we shorten it
@@ -611,55 +658,136 @@ void BrewEngine::saveTempSensorSettings(const json &jTempSensors)
 	this->skipTempLoop = true;
 	vTaskDelay(pdMS_TO_TICKS(2000));
 
+	// ids of the list we got, new manual sensors get one assigned
+	vector<string> keepIds;
+
 	// update running data
 	for (auto &el : jTempSensors.items())
 	{
 		auto jSensor = el.value();
-		string stringId = jSensor["id"].get<string>();
-		uint64_t sensorId = std::stoull(stringId);
+		string stringId = jSensor.contains("id") && jSensor["id"].is_string() ? jSensor["id"].get<string>() : "";
+		uint64_t sensorId = stringId.empty() ? 0 : strtoull(stringId.c_str(), NULL, 10);
 
 		std::map<uint64_t, TemperatureSensor *>::iterator it;
 		it = this->sensors.find(sensorId);
 
 		if (it == this->sensors.end())
 		{
-			// doesn't exist anymore, just ignore
-			ESP_LOGI(TAG, "doesn't exist anymore, just ignore %llu", sensorId);
-			continue;
+			SensorType type = SensorDS18B20;
+			if (jSensor.contains("type") && jSensor["type"].is_number())
+			{
+				type = (SensorType)jSensor["type"].get<uint8_t>();
+			}
+
+			if (type == SensorDS18B20)
+			{
+				// doesn't exist anymore, just ignore, 1-Wire sensors are only added by detection
+				ESP_LOGI(TAG, "doesn't exist anymore, just ignore %llu", sensorId);
+				continue;
+			}
+
+			// manual sensors have no rom code, we make an id from type, bus and chip select
+			uint8_t busId = jSensor.contains("busId") && jSensor["busId"].is_number() ? jSensor["busId"].get<uint8_t>() : 0;
+			int csPin = jSensor.contains("csPin") && jSensor["csPin"].is_number() ? jSensor["csPin"].get<int>() : 0xFF;
+			sensorId = ((uint64_t)type << 56) | ((uint64_t)busId << 48) | ((uint64_t)(csPin & 0xFF) << 40);
+			while (this->sensors.find(sensorId) != this->sensors.end())
+			{
+				sensorId++;
+			}
+
+			jSensor["id"] = to_string(sensorId);
+			if (!jSensor.contains("name") || !jSensor["name"].is_string())
+			{
+				jSensor["name"] = to_string(sensorId);
+			}
+			if (!jSensor.contains("color") || !jSensor["color"].is_string())
+			{
+				jSensor["color"] = "#ffffff";
+			}
+
+			ESP_LOGI(TAG, "Adding Sensor %llu type %d", sensorId, type);
+
+			auto sensor = new TemperatureSensor();
+			sensor->from_json(jSensor);
+
+			xSemaphoreTake(this->sensorMutex, portMAX_DELAY);
+			this->sensors.insert_or_assign(sensorId, sensor);
+			xSemaphoreGive(this->sensorMutex);
+
+			this->initSensorDriver(sensor);
+
+			keepIds.push_back(to_string(sensorId));
 		}
 		else
 		{
 			ESP_LOGI(TAG, "Updating Sensor %llu", sensorId);
+			keepIds.push_back(stringId);
+
 			// update it
 			TemperatureSensor *sensor = it->second;
-			sensor->name = jSensor["name"];
-			sensor->color = jSensor["color"];
+			if (jSensor.contains("name") && jSensor["name"].is_string())
+			{
+				sensor->name = jSensor["name"];
+			}
+			if (jSensor.contains("color") && jSensor["color"].is_string())
+			{
+				sensor->color = jSensor["color"];
+			}
 
-			if (!jSensor["useForControl"].is_null() && jSensor["useForControl"].is_boolean())
+			if (jSensor.contains("useForControl") && jSensor["useForControl"].is_boolean())
 			{
 				sensor->useForControl = jSensor["useForControl"];
 			}
 
-			if (!jSensor["show"].is_null() && jSensor["show"].is_boolean())
+			if (jSensor.contains("show") && jSensor["show"].is_boolean())
 			{
 				sensor->show = jSensor["show"];
 
 				if (!sensor->show)
 				{
 					// when show is disabled we also remove it from current, so it doesn't showup anymore
+					xSemaphoreTake(this->sensorMutex, portMAX_DELAY);
 					this->currentTemperatures.erase(sensorId);
+					xSemaphoreGive(this->sensorMutex);
 				}
 			}
 
-			if (!jSensor["compensateAbsolute"].is_null() && jSensor["compensateAbsolute"].is_number())
+			if (jSensor.contains("compensateAbsolute") && jSensor["compensateAbsolute"].is_number())
 			{
 				sensor->compensateAbsolute = (float)jSensor["compensateAbsolute"];
 			}
 
-			if (!jSensor["compensateRelative"].is_null() && jSensor["compensateRelative"].is_number())
+			if (jSensor.contains("compensateRelative") && jSensor["compensateRelative"].is_number())
 			{
 				sensor->compensateRelative = (float)jSensor["compensateRelative"];
 			}
+
+			if (jSensor.contains("resolution") && jSensor["resolution"].is_number())
+			{
+				sensor->resolution = (SensorResolution)jSensor["resolution"].get<uint8_t>();
+			}
+
+			// manual sensors get a new driver when their hardware settings change
+			if (sensor->type != SensorDS18B20)
+			{
+				json jOld = sensor->to_json();
+				if (jSensor.contains("busId") && jSensor["busId"].is_number())
+				{
+					sensor->busId = jSensor["busId"].get<uint8_t>();
+				}
+				sensor->driver_from_json(jSensor);
+
+				// lastTemp and runtime stats don't change here, so any difference is a driver setting
+				json jNew = sensor->to_json();
+				jNew["lastTemp"] = jOld["lastTemp"];
+				jNew["sampleRate"] = jOld["sampleRate"];
+
+				if (jOld != jNew)
+				{
+					ESP_LOGI(TAG, "Sensor %llu driver settings changed", sensorId);
+					this->initSensorDriver(sensor);
+				}
+			}
 		}
 	}
 
@@ -670,25 +798,36 @@ void BrewEngine::saveTempSensorSettings(const json &jTempSensors)
 	{
 		uint64_t sensorId = sensor->id;
 		string stringId = to_string(sensorId); // json doesn't support unit64 so in out json id is string
-		auto foundSensor = std::find_if(jTempSensors.begin(), jTempSensors.end(), [&stringId](const json &x)
-										{
-											auto it = x.find("id");
-											return it != x.end() and it.value() == stringId; });
+		auto foundSensor = std::find(keepIds.begin(), keepIds.end(), stringId);
 
 		// remove it
-		if (foundSensor == jTempSensors.end())
+		if (foundSensor == keepIds.end())
 		{
 			ESP_LOGI(TAG, "Erasing Sensor %llu", sensorId);
 			sensorsToDelete.push_back(sensorId);
-			this->currentTemperatures.erase(sensorId);
 		}
 	}
 
 	// erase in second loop, we can't mutate wile in auto loop (c++ limitation atm)
+	xSemaphoreTake(this->sensorMutex, portMAX_DELAY);
 	for (auto &sensorId : sensorsToDelete)
 	{
+		TemperatureSensor *sensor = this->sensors[sensorId];
+		if (sensor->driver)
+		{
+			delete sensor->driver;
+		}
+		if (sensor->nextDriver)
+		{
+			delete sensor->nextDriver;
+		}
+		delete sensor;
 		this->sensors.erase(sensorId);
+		this->currentTemperatures.erase(sensorId);
+		this->fusion.Remove(sensorId);
+		this->tempLog.RemoveChannel("s" + to_string(sensorId));
 	}
+	xSemaphoreGive(this->sensorMutex);
 
 	// // Convert sensors to json and save to nvram
 	json jSensors = json::array({});
@@ -742,1643 +881,4299 @@ void BrewEngine::initMqtt()
 	// we create a topic and just post all out data to runningLog, more complex configuration can follow in the future
 	this->mqttTopic = "esp-brew-engine/" + this->Hostname + "/history";
 	this->mqttTopicLog = "esp-brew-engine/" + this->Hostname + "/log";
+	this->mqttTopicHealth = "esp-brew-engine/" + this->Hostname + "/health";
 	this->mqttEnabled = true;
 
 	ESP_LOGI(TAG, "initMqtt: Done");
 }
 
-void BrewEngine::initOneWire()
+void BrewEngine::readTemperatureBusSettings()
 {
-	ESP_LOGI(TAG, "initOneWire: Start");
+	vector<uint8_t> empty = json::to_msgpack(json::array({}));
+	vector<uint8_t> serialized = this->settingsManager->Read("onewirebuses", empty);
+
+	json jBuses = json::from_msgpack(serialized);
 
-	onewire_bus_config_t bus_config;
-	bus_config.bus_gpio_num = this->oneWire_PIN;
+	if (jBuses.empty())
+	{
+		// older versions only had one bus, its pin is our default
+		auto bus = new TemperatureBus();
+		bus->from_json({{"id", 0}, {"pinNr", this->settingsManager->Read("onewirePin", (uint16_t)CONFIG_ONEWIRE)}});
+		this->temperatureBuses.push_back(bus);
+		return;
+	}
 
-	onewire_bus_rmt_config_t rmt_config;
-	rmt_config.max_rx_bytes = 10; // 1byte ROM command + 8byte ROM number + 1byte device command
+	for (auto &el : jBuses.items())
+	{
+		auto bus = new TemperatureBus();
+		bus->from_json(el.value());
 
-	ESP_ERROR_CHECK(onewire_new_bus_rmt(&bus_config, &rmt_config, &this->obh));
-	ESP_LOGI(TAG, "1-Wire bus installed on GPIO%d", this->oneWire_PIN);
+		ESP_LOGI(TAG, "Bus From Settings ID:%d Type:%d GPIO%d", bus->id, bus->type, bus->pinNr);
 
-	ESP_LOGI(TAG, "initOneWire: Done");
+		this->temperatureBuses.push_back(bus);
+	}
 }
 
-void BrewEngine::detectOnewireTemperatureSensors()
+void BrewEngine::saveTemperatureBusSettings(const json &jBuses)
 {
+	ESP_LOGI(TAG, "Saving Bus Settings");
 
-	// we need to temp stop our temp read loop while we change the sensor data
-	this->skipTempLoop = true;
-	vTaskDelay(pdMS_TO_TICKS(2000));
+	json jSaveBuses = json::array({});
+	uint8_t newId = 0;
 
-	// sensors are already loaded via json settings, but we need to add handles and status
-	onewire_device_iter_handle_t iter = NULL;
-	esp_err_t search_result = ESP_OK;
+	for (auto &el : jBuses.items())
+	{
+		auto jBus = el.value();
 
-	// create 1-wire device iterator, which is used for device search
-	ESP_ERROR_CHECK(onewire_new_device_iter(this->obh, &iter));
-	ESP_LOGI(TAG, "Device iterator created, start searching...");
+		bool oneWire = !jBus.contains("type") || !jBus["type"].is_number() || jBus["type"].get<uint8_t>() == BusOneWire;
 
-	int i = 0;
-	do
-	{
+		if (oneWire && (!jBus.contains("pinNr") || !jBus["pinNr"].is_number()))
+		{
+			ESP_LOGW(TAG, "1-Wire bus without pin, ignoring!");
+			continue;
+		}
 
-		onewire_device_t next_onewire_device = {};
+		// ids are only used to link sensors to buses, keep them when given
+		if (jBus["id"].is_null() || !jBus["id"].is_number())
+		{
+			jBus["id"] = newId;
+		}
+		newId = std::max<uint8_t>(newId, jBus["id"].get<uint8_t>()) + 1;
 
-		search_result = onewire_device_iter_get_next(iter, &next_onewire_device);
-		if (search_result == ESP_OK)
-		{ // found a new device, let's check if we can upgrade it to a DS18B20
-			ds18b20_config_t ds_cfg = {};
+		TemperatureBus bus;
+		bus.from_json(jBus);
+		jSaveBuses.push_back(bus.to_json());
+	}
 
-			ds18b20_device_handle_t newHandle;
+	// Serialize to MessagePack for size
+	vector<uint8_t> serialized = json::to_msgpack(jSaveBuses);
 
-			if (ds18b20_new_device(&next_onewire_device, &ds_cfg, &newHandle) == ESP_OK)
-			{
-				uint64_t sensorId = next_onewire_device.address;
+	this->settingsManager->Write("onewirebuses", serialized);
 
-				ESP_LOGI(TAG, "Found a DS18B20[%d], address: %016llX ID:%llu", i, sensorId, sensorId);
-				i++;
+	ESP_LOGI(TAG, "Saving Bus Settings Done");
+}
 
-				if (this->sensors.size() >= ONEWIRE_MAX_DS18B20)
-				{
-					ESP_LOGI(TAG, "Max DS18B20 number reached, stop searching...");
-					break;
-				}
+void BrewEngine::initBuses()
+{
+	ESP_LOGI(TAG, "initBuses: Start");
 
-				std::map<uint64_t, TemperatureSensor *>::iterator it;
-				it = this->sensors.find(sensorId);
+	// spi buses get the next free host, depends on the chip how many there are
+	vector<spi_host_device_t> freeSpiHosts = {SPI2_HOST};
+#if SOC_SPI_PERIPH_NUM > 2
+	freeSpiHosts.push_back(SPI3_HOST);
+#endif
 
-				if (it == this->sensors.end())
-				{
-					ESP_LOGI(TAG, "New Sensor");
-
-					// doesn't exist yet, we need to add it
-					auto sensor = new TemperatureSensor();
-					sensor->id = sensorId;
-					sensor->name = to_string(sensorId);
-					sensor->color = "#ffffff";
-					sensor->useForControl = true;
-					sensor->show = true;
-					sensor->connected = true;
-					sensor->compensateAbsolute = 0;
-					sensor->compensateRelative = 1;
-					sensor->handle = newHandle;
-					this->sensors.insert_or_assign(sensor->id, sensor);
-				}
-				else
-				{
-					ESP_LOGI(TAG, "Existing Sensor");
-					// just set connected and handle
-					TemperatureSensor *sensor = it->second;
-					sensor->handle = newHandle;
-					sensor->connected = true;
-				}
+	for (auto const &bus : this->temperatureBuses)
+	{
+		if (bus->type == BusOneWire)
+		{
+			onewire_bus_config_t bus_config;
+			bus_config.bus_gpio_num = bus->pinNr;
 
-				// set resolution for all DS18B20s
-				ds18b20_set_resolution(newHandle, DS18B20_RESOLUTION_12B);
+			onewire_bus_rmt_config_t rmt_config;
+			rmt_config.max_rx_bytes = 10; // 1byte ROM command + 8byte ROM number + 1byte device command
+
+			// every bus takes its own rmt tx and rx channel, when we run out the bus stays disabled
+			esp_err_t err = onewire_new_bus_rmt(&bus_config, &rmt_config, &bus->handle);
+			if (err != ESP_OK)
+			{
+				ESP_LOGE(TAG, "Unable to install 1-Wire bus %d on GPIO%d: %s", bus->id, bus->pinNr, esp_err_to_name(err));
+				bus->handle = NULL;
+				continue;
 			}
-			else
+
+			ESP_LOGI(TAG, "1-Wire bus %d installed on GPIO%d", bus->id, bus->pinNr);
+		}
+		else if (bus->type == BusSpi)
+		{
+			if (freeSpiHosts.empty())
+			{
+				ESP_LOGE(TAG, "No free SPI host for bus %d", bus->id);
+				continue;
+			}
+
+			spi_bus_config_t bus_config = {};
+			bus_config.miso_io_num = bus->misoPin;
+			bus_config.mosi_io_num = bus->mosiPin;
+			bus_config.sclk_io_num = bus->clkPin;
+			bus_config.quadwp_io_num = -1;
+			bus_config.quadhd_io_num = -1;
+
+			esp_err_t err = spi_bus_initialize(freeSpiHosts.front(), &bus_config, SPI_DMA_DISABLED);
+			if (err != ESP_OK)
 			{
-				ESP_LOGI(TAG, "Found an unknown device, address: %016llX", next_onewire_device.address);
+				ESP_LOGE(TAG, "Unable to install SPI bus %d: %s", bus->id, esp_err_to_name(err));
+				continue;
 			}
+
+			bus->spiHost = freeSpiHosts.front();
+			freeSpiHosts.erase(freeSpiHosts.begin());
+
+			ESP_LOGI(TAG, "SPI bus %d installed on MISO:%d MOSI:%d CLK:%d", bus->id, bus->misoPin, bus->mosiPin, bus->clkPin);
 		}
-	} while (search_result != ESP_ERR_NOT_FOUND);
 
-	ESP_ERROR_CHECK(onewire_del_device_iter(iter));
-	ESP_LOGI(TAG, "Searching done, %d DS18B20 device(s) found", this->sensors.size());
+		bus->ready = true;
+	}
 
-	this->skipTempLoop = false;
+	ESP_LOGI(TAG, "initBuses: Done");
 }
 
-void BrewEngine::start()
+void BrewEngine::initSensorDrivers()
 {
-	// don't start if we are already running
-	if (!this->controlRun)
+	// 1-Wire sensors get their driver from detection, other types are configured by the user
+	for (auto const &[key, sensor] : this->sensors)
 	{
-		this->controlRun = true;
-		this->inOverTime = false;
-		this->boostStatus = Off;
-		this->overrideTargetTemperature = std::nullopt;
-		// clear old temp log
-		this->tempLog.clear();
-
-		// also clear old steps
-		for (auto const &step : this->executionSteps)
+		if (sensor->type != SensorDS18B20)
 		{
-			delete step.second;
+			this->initSensorDriver(sensor);
 		}
-		this->executionSteps.clear();
+	}
+}
 
-		if (this->selectedMashScheduleName.empty() == false)
+void BrewEngine::initSensorDriver(TemperatureSensor *sensor)
+{
+	auto bus = std::find_if(this->temperatureBuses.begin(), this->temperatureBuses.end(), [&sensor](TemperatureBus *b)
+							{ return b->id == sensor->busId; });
+
+	SensorDriver *driver = NULL;
+
+	if (bus == this->temperatureBuses.end() || !(*bus)->ready)
+	{
+		ESP_LOGW(TAG, "Bus %d for sensor [%llu] is not availible", sensor->busId, sensor->id);
+	}
+	else
+	{
+		switch (sensor->type)
 		{
-			this->loadSchedule();
-			this->currentMashStep = 1; // 0 is current temp, so we can start at 1
-			xTaskCreate(&this->controlLoop, "controlloop_task", 4096, this, 5, NULL);
+		case SensorMAX31865:
+			driver = new MAX31865Driver((*bus)->spiHost, sensor->csPin, sensor->rtdNominal, sensor->refResistor, sensor->rtdWires);
+			break;
+		case SensorMAX31855:
+			driver = new MAX31855Driver((*bus)->spiHost, sensor->csPin);
+			break;
+		case SensorMock:
+			driver = new MockSensorDriver(20, 0.1);
+			break;
+		default:
+			ESP_LOGW(TAG, "Sensor [%llu] type %d can't be configured manually", sensor->id, sensor->type);
+			break;
 		}
-		else
-		{
+	}
 
-			// if no schedule is selected, we set the boil flag based on temperature
-			if ((this->temperatureScale == Celsius && this->targetTemperature >= 100) || (this->temperatureScale == Fahrenheit && this->targetTemperature >= 212))
-			{
-				this->boilRun = true;
-			}
-			else
-			{
-				this->boilRun = false;
-			}
+	// nobody else has the new driver yet, so we can init it here
+	// we keep the driver when init fails, the read loop retries it between samples
+	bool connected = false;
+	if (driver)
+	{
+		esp_err_t err = driver->Init();
+		if (err != ESP_OK)
+		{
+			ESP_LOGW(TAG, "Unable to init sensor [%llu]: %s", sensor->id, esp_err_to_name(err));
 		}
+		connected = err == ESP_OK;
+	}
 
-		xTaskCreate(&this->pidLoop, "pidloop_task", 8192, this, 5, NULL);
+	xSemaphoreTake(this->sensorMutex, portMAX_DELAY);
+	this->setSensorDriver(sensor, driver, connected);
+	xSemaphoreGive(this->sensorMutex);
+}
 
-		xTaskCreate(&this->outputLoop, "outputloop_task", 4096, this, 5, NULL);
+void BrewEngine::setSensorDriver(TemperatureSensor *sensor, SensorDriver *driver, bool connected)
+{
+	// only call while holding sensorMutex
+	// the read task of the bus the old driver is on may be using it outside the lock, so that task swaps it in
+	if (sensor->nextDriver)
+	{
+		delete sensor->nextDriver;
+	}
+	sensor->nextDriver = driver;
+	sensor->nextConnected = connected;
+	sensor->replaceDriver = true;
 
-		this->statusText = "Running";
+	// without an old driver or before the read tasks run nobody can be using it
+	if (!sensor->driver || !this->run)
+	{
+		this->swapSensorDriver(sensor);
 	}
 }
 
-void BrewEngine::loadSchedule()
+void BrewEngine::swapSensorDriver(TemperatureSensor *sensor)
 {
-	auto pos = this->mashSchedules.find(this->selectedMashScheduleName);
-
-	if (pos == this->mashSchedules.end())
+	if (sensor->driver)
 	{
-		ESP_LOGE(TAG, "Program with name: %s not found!", this->selectedMashScheduleName.c_str());
-		return;
+		delete sensor->driver;
 	}
-	auto schedule = pos->second;
-
-	system_clock::time_point prevTime = std::chrono::system_clock::now();
+	sensor->driver = sensor->nextDriver;
+	sensor->driverBusId = sensor->busId;
+	sensor->connected = sensor->nextConnected;
+	sensor->consecutiveErrors = 0;
+	sensor->activeResolution = 0; // a new device, startConversion sets the resolution again
+	sensor->nextDriver = NULL;
+	sensor->replaceDriver = false;
+}
 
-	for (auto const &step : this->executionSteps)
+void BrewEngine::handOverDrivers(TemperatureBus *bus)
+{
+	// called by the read task of the bus before it starts a conversion, so none of its drivers are in use
+	xSemaphoreTake(this->sensorMutex, portMAX_DELAY);
+	for (auto const &[key, sensor] : this->sensors)
 	{
-		delete step.second;
+		if (sensor->replaceDriver && sensor->driverBusId == bus->id)
+		{
+			ESP_LOGD(TAG, "Sensor [%llu] new driver on bus %d", sensor->id, sensor->busId);
+			this->swapSensorDriver(sensor);
+		}
 	}
-	this->executionSteps.clear();
+	xSemaphoreGive(this->sensorMutex);
+}
 
-	this->currentExecutionStep = 0;
-	this->boilRun = schedule->boil;
-	int stepIndex = 0;
+vector<TemperatureSensor *> BrewEngine::busSensors(TemperatureBus *bus)
+{
+	// sensors can be added by discovery of other buses, so we only walk the map while locked
+	vector<TemperatureSensor *> busSensors;
 
-	float prevTemp = this->temperature;
-	// insert the current as starting point
-	auto execStep0 = new ExecutionStep();
-	execStep0->time = prevTime;
-	execStep0->temperature = prevTemp;
-	execStep0->extendIfNeeded = false;
-	this->executionSteps.insert(std::make_pair(stepIndex, execStep0));
+	xSemaphoreTake(this->sensorMutex, portMAX_DELAY);
+	for (auto const &[key, sensor] : this->sensors)
+	{
+		if (sensor->driverBusId == bus->id && sensor->driver && sensor->connected)
+		{
+			busSensors.push_back(sensor);
+		}
+	}
+	xSemaphoreGive(this->sensorMutex);
 
-	string iso_string = this->to_iso_8601(prevTime);
-	ESP_LOGI(TAG, "Time:%s, Temp:%f Extend:%d", iso_string.c_str(), prevTemp, execStep0->extendIfNeeded);
+	return busSensors;
+}
 
-	int extendNotifications = 0;
+esp_err_t BrewEngine::startConversion(TemperatureBus *bus, uint16_t &conversionTime)
+{
+	conversionTime = 0;
+	bus->conversionStart = esp_timer_get_time();
 
-	stepIndex++;
+	this->handOverDrivers(bus);
 
-	for (auto const &step : schedule->steps)
+	for (auto const &sensor : this->busSensors(bus))
 	{
-		// a step can actualy be 2 different executions, 1 step time that needs substeps calcualted, and one fixed
-
-		if (step->stepTime > 0 || step->extendStepTimeIfNeeded)
+		// resolution is written to the sensor, so this needs to happen before we start the conversion
+		if (sensor->type == SensorDS18B20)
 		{
-
-			int stepTime = step->stepTime;
-
-			// when the users request step extended, we need a step so 0 isn't valid we default to 1 min
-			if (stepTime == 0)
+			uint8_t resolution = this->desiredResolution(sensor);
+			if (resolution != sensor->activeResolution && sensor->driver->SetResolution(resolution) == ESP_OK)
 			{
-				stepTime = 1;
-				extendNotifications += 60;
+				ESP_LOGD(TAG, "Sensor [%llu] resolution %d bit", sensor->id, resolution);
+				sensor->activeResolution = resolution;
 			}
+		}
 
-			auto stepEndTime = prevTime + minutes(stepTime);
+		sensor->driver->Start();
 
-			int subStepsInStep;
+		// the slowest sensor decides when the bus is done
+		conversionTime = std::max(conversionTime, sensor->driver->ConversionTime());
+	}
 
-			// When boost mode is active we don't want substeps this only complicates things
-			if (step->allowBoost && this->boostModeUntil > 0)
-			{
-				subStepsInStep = 1;
-			}
-			else
-			{
-				auto secondsInStep = chrono::duration_cast<chrono::seconds>(stepEndTime - prevTime).count();
-				subStepsInStep = (secondsInStep / this->stepInterval) - 1;
+	// nothing to convert
+	if (conversionTime == 0)
+	{
+		return ESP_ERR_NOT_FOUND;
+	}
 
-				// we need atleast one step
-				if (subStepsInStep < 1)
-				{
-					subStepsInStep = 1;
-				}
-			}
+	// ds18b20s don't start by themselfs, we start all of them with one command
+	if (bus->type == BusOneWire)
+	{
+		return DS18B20Driver::StartAll(bus->handle);
+	}
 
-			float tempDiffPerStep = (step->temperature - prevTemp) / (float)subStepsInStep;
+	return ESP_OK;
+}
 
-			float prevStepTemp = 0;
+uint8_t BrewEngine::desiredResolution(TemperatureSensor *sensor)
+{
+	if (sensor->resolution != ResolutionAuto)
+	{
+		return sensor->resolution;
+	}
 
-			for (int j = 0; j < subStepsInStep; j++)
-			{
-				system_clock::time_point executionStepTime = prevTime;
-				executionStepTime += seconds((j + 1) * stepInterval);
+	// without a program there is no target, precision is more usefull then speed
+	if (!this->controlRun)
+	{
+		return Resolution12Bit;
+	}
 
-				float subStepTemp = prevTemp + (tempDiffPerStep * ((float)j + 1));
-
-				// insert the current as starting point
-				auto execStep = new ExecutionStep();
-				execStep->time = executionStepTime;
-				execStep->temperature = subStepTemp;
-				execStep->extendIfNeeded = false;
-
-				if (step->allowBoost && this->boostModeUntil > 0)
-				{
-					execStep->allowBoost = true;
-				}
-				else
-				{
-					execStep->allowBoost = false;
-				}
-
-				// set extend if needed on last step if configured
-				if (j == (subStepsInStep - 1) && step->extendStepTimeIfNeeded)
-				{
-					execStep->extendIfNeeded = true;
-				}
-
-				float diff = abs(subStepTemp - prevStepTemp);
-				// ESP_LOGI(TAG, "Diff:%f, subStepTemp:%f prevStepTemp:%f", diff, subStepTemp, prevStepTemp);
-
-				// only insert if difference or if last step more then 1 degree
-				if (diff > 1 || (j == subStepsInStep - 1))
-				{
-					this->executionSteps.insert(std::make_pair(stepIndex, execStep));
-					prevStepTemp = execStep->temperature;
-					stepIndex++;
+	// boiling or ramping, we want fast samples
+	if (this->boilRun || abs(this->targetTemperature - this->temperature) > this->resolutionMargin)
+	{
+		return Resolution10Bit;
+	}
 
-					// Convert the time_point to an ISO 8601 string
-					string iso_string = this->to_iso_8601(executionStepTime);
+	// resting close to target, we want precision
+	return Resolution12Bit;
+}
 
-					ESP_LOGI(TAG, "Time:%s, Temp:%f Extend:%d", iso_string.c_str(), subStepTemp, execStep->extendIfNeeded);
-				}
+void BrewEngine::detectOnewireTemperatureSensors()
+{
+	// before the read tasks run we can search the buses directly
+	if (!this->run)
+	{
+		for (auto const &bus : this->temperatureBuses)
+		{
+			if (bus->type == BusOneWire && bus->ready)
+			{
+				this->searchOnewireBus(bus);
 			}
-
-			prevTime = stepEndTime;
-			prevTemp = prevStepTemp;
 		}
-		else
-		{
-			// we start in 10 seconds
-			auto stepEndTime = prevTime + seconds(10);
-
-			// go directly to temp
-			auto execStep = new ExecutionStep();
-			execStep->time = stepEndTime;
-			execStep->temperature = (float)step->temperature;
-			execStep->extendIfNeeded = step->extendStepTimeIfNeeded;
 
-			this->executionSteps.insert(std::make_pair(stepIndex, execStep));
-
-			stepIndex++;
-
-			// Convert the time_point to an ISO 8601 string
-			string iso_string = this->to_iso_8601(prevTime);
-
-			ESP_LOGI(TAG, "Time:%s, Temp:%f Extend:%d", iso_string.c_str(), (float)step->temperature, execStep->extendIfNeeded);
+		ESP_LOGI(TAG, "Searching done, %d sensor(s) known", this->sensors.size());
+		return;
+	}
 
-			prevTime = stepEndTime;
-			prevTemp = (float)step->temperature;
+	// afterwards the read tasks search between conversions, we ask for a pass now and wait for it
+	map<uint8_t, uint32_t> passes;
+	for (auto const &bus : this->temperatureBuses)
+	{
+		if (bus->type == BusOneWire && bus->ready)
+		{
+			passes[bus->id] = bus->searchPasses;
+			bus->nextSearch = 0;
 		}
+	}
 
-		// for the hold time we just need add one point
-		auto holdEndTime = prevTime + minutes(step->time);
-
-		auto holdStep = new ExecutionStep();
-		holdStep->time = holdEndTime;
-		holdStep->temperature = (float)step->temperature;
-		holdStep->extendIfNeeded = false;
+	for (int i = 0; i < 100; i++)
+	{
+		bool done = std::all_of(this->temperatureBuses.begin(), this->temperatureBuses.end(), [&passes](TemperatureBus *bus)
+								{ return !passes.contains(bus->id) || bus->searchPasses != passes[bus->id]; });
+		if (done)
+		{
+			break;
+		}
+		vTaskDelay(pdMS_TO_TICKS(100));
+	}
 
-		this->executionSteps.insert(std::make_pair(stepIndex, holdStep));
-		stepIndex++;
+	ESP_LOGI(TAG, "Searching done, %d sensor(s) known", this->sensors.size());
+}
 
-		prevTime = holdEndTime;
-		prevTemp = step->temperature; // is normaly the same but this could change in futrure
+void BrewEngine::searchOnewireBus(TemperatureBus *bus)
+{
+	// sensors are already loaded via json settings, but we need to add drivers and status
+	onewire_device_iter_handle_t iter = NULL;
+	esp_err_t search_result = ESP_OK;
 
-		string iso_string2 = this->to_iso_8601(holdEndTime);
-		ESP_LOGI(TAG, "Hold Time:%s, Temp:%f ", iso_string2.c_str(), (float)step->temperature);
-	}
+	// create 1-wire device iterator, which is used for device search
+	ESP_ERROR_CHECK(onewire_new_device_iter(bus->handle, &iter));
+	ESP_LOGI(TAG, "Device iterator created, start searching bus %d...", bus->id);
 
-	// also add notifications
-	for (auto const &notification : this->notifications)
-	{
-		delete notification;
-	}
-	this->notifications.clear();
+	// the cap is per bus, sensors that moved to this bus are counted again
+	bus->searchCount = 0;
 
-	for (auto const &notification : schedule->notifications)
+	do
 	{
-		auto notificationTime = execStep0->time + minutes(notification->timeFromStart) + seconds(extendNotifications);
+		onewire_device_t next_onewire_device = {};
 
-		// copy notification to new map
-		auto newNotification = new Notification();
-		newNotification->name = notification->name;
-		newNotification->message = notification->message;
-		newNotification->timeFromStart = notification->timeFromStart + (extendNotifications / 60); // in minutes
-		newNotification->timePoint = notificationTime;
+		search_result = onewire_device_iter_get_next(iter, &next_onewire_device);
+		if (search_result == ESP_OK && !this->attachOnewireDevice(bus, next_onewire_device))
+		{
+			break;
+		}
+	} while (search_result != ESP_ERR_NOT_FOUND);
 
-		this->notifications.push_back(newNotification);
-	}
+	ESP_ERROR_CHECK(onewire_del_device_iter(iter));
+	bus->searchPasses++;
+	bus->nextSearch = esp_timer_get_time() + ONEWIRE_SEARCH_INTERVAL;
 
-	// increate version so client can follow changes
-	this->runningVersion++;
+	ESP_LOGI(TAG, "Searching bus %d done, %d DS18B20 device(s) found", bus->id, bus->searchCount);
 }
 
-void BrewEngine::recalculateScheduleAfterOverTime()
+void BrewEngine::discoverStep(TemperatureBus *bus, int64_t deadline)
 {
-	ESP_LOGI(TAG, "Recalculate Schedule after OverTime");
-
-	int currentStepIndex = this->currentMashStep;
-
-	auto currentPos = this->executionSteps.find(currentStepIndex);
+	int64_t now = esp_timer_get_time();
 
-	if (currentPos == this->executionSteps.end())
+	// only when it's time and one step fits before the next conversion, sampling has priority
+	if (now < bus->nextSearch || deadline - now < ONEWIRE_SEARCH_STEP_TIME || this->skipTempLoop)
 	{
-		ESP_LOGE(TAG, "Steps not availible anymore");
-		this->stop();
 		return;
 	}
 
-	auto currentStep = currentPos->second;
-	system_clock::time_point plannedEnd = currentStep->time;
-
-	system_clock::time_point now = std::chrono::system_clock::now();
-	auto extraSeconds = chrono::duration_cast<chrono::seconds>(now - plannedEnd).count();
-
-	for (auto it = currentPos; it != this->executionSteps.end(); ++it)
+	if (bus->type != BusOneWire)
 	{
-		auto step = it->second;
-		auto newTime = step->time + seconds(extraSeconds);
+		// spi and mock sensors can't be searched, we just retry the init of the ones that failed
+		vector<TemperatureSensor *> failed;
 
-		string iso_string = this->to_iso_8601(step->time);
-		string iso_string2 = this->to_iso_8601(newTime);
+		xSemaphoreTake(this->sensorMutex, portMAX_DELAY);
+		for (auto const &[key, sensor] : this->sensors)
+		{
+			if (sensor->driverBusId == bus->id && sensor->driver && !sensor->connected)
+			{
+				failed.push_back(sensor);
+			}
+		}
+		xSemaphoreGive(this->sensorMutex);
 
-		ESP_LOGI(TAG, "Time Changend From: %s, To:%s ", iso_string.c_str(), iso_string2.c_str());
+		for (auto &sensor : failed)
+		{
+			if (sensor->driver->Init() == ESP_OK)
+			{
+				ESP_LOGI(TAG, "Sensor [%llu] reconnected", sensor->id);
+				xSemaphoreTake(this->sensorMutex, portMAX_DELAY);
+				sensor->consecutiveErrors = 0;
+				sensor->connected = true;
+				xSemaphoreGive(this->sensorMutex);
+			}
+		}
 
-		step->time = newTime;
+		bus->searchPasses++;
+		bus->nextSearch = now + ONEWIRE_SEARCH_INTERVAL;
+		return;
 	}
 
-	// also increase notifications
-	for (auto &notification : this->notifications)
+	// a pass is spread over several idle gaps, one rom per step
+	if (!bus->searchIter)
 	{
-		auto newTime = notification->timePoint + seconds(extraSeconds);
-
-		string iso_string = this->to_iso_8601(notification->timePoint);
-		string iso_string2 = this->to_iso_8601(newTime);
+		if (onewire_new_device_iter(bus->handle, &bus->searchIter) != ESP_OK)
+		{
+			bus->nextSearch = now + ONEWIRE_SEARCH_INTERVAL;
+			return;
+		}
+		bus->searchCount = 0;
+	}
 
-		ESP_LOGI(TAG, "Notification Time Changend From: %s, To:%s ", iso_string.c_str(), iso_string2.c_str());
+	onewire_device_t device = {};
+	esp_err_t err = onewire_device_iter_get_next(bus->searchIter, &device);
 
-		notification->timePoint = newTime;
+	if (err == ESP_OK && this->attachOnewireDevice(bus, device))
+	{
+		return;
 	}
 
-	// increate version so client can follow changes
-	this->runningVersion++;
-}
+	// end of the pass, not found means no more devices, other errors we retry next pass
+	onewire_del_device_iter(bus->searchIter);
+	bus->searchIter = NULL;
+	bus->searchPasses++;
+	bus->nextSearch = now + ONEWIRE_SEARCH_INTERVAL;
 
-void BrewEngine::stop()
-{
-	this->controlRun = false;
-	this->boostStatus = Off;
-	this->inOverTime = false;
-	this->statusText = "Idle";
+	ESP_LOGD(TAG, "Search pass bus %d done, %d DS18B20 device(s) found", bus->id, bus->searchCount);
 }
 
-void BrewEngine::startStir(const json &stirConfig)
+bool BrewEngine::attachOnewireDevice(TemperatureBus *bus, onewire_device_t &device)
 {
-	if (!this->stir_PIN)
+	// let's check if we can upgrade it to a DS18B20
+	ds18b20_config_t ds_cfg = {};
+	ds18b20_device_handle_t newHandle;
+
+	if (ds18b20_new_device(&device, &ds_cfg, &newHandle) != ESP_OK)
 	{
-		ESP_LOGW(TAG, "StirPin is not configured, ignoring startStir!");
-		return;
+		ESP_LOGD(TAG, "Found an unknown device, address: %016llX", device.address);
+		return true;
 	}
 
-	system_clock::time_point now = std::chrono::system_clock::now();
-	this->stirStartCycle = now;
+	uint64_t sensorId = device.address;
 
-	if (!stirConfig["max"].is_null() && stirConfig["max"].is_number())
+	if (bus->searchCount >= bus->maxSensors)
 	{
-		this->stirTimeSpan = stirConfig["max"];
+		ESP_LOGI(TAG, "Max DS18B20 number reached for bus %d, stop searching...", bus->id);
+		ds18b20_del_device(newHandle);
+		return false;
 	}
+	bus->searchCount++;
 
-	if (!stirConfig["intervalStart"].is_null() && stirConfig["intervalStart"].is_number())
+	xSemaphoreTake(this->sensorMutex, portMAX_DELAY);
+
+	TemperatureSensor *sensor;
+
+	auto it = this->sensors.find(sensorId);
+	if (it == this->sensors.end())
 	{
-		this->stirIntervalStart = stirConfig["intervalStart"];
+		ESP_LOGI(TAG, "New DS18B20 on bus %d, address: %016llX ID:%llu", bus->id, sensorId, sensorId);
+
+		// doesn't exist yet, we need to add it
+		sensor = new TemperatureSensor();
+		sensor->id = sensorId;
+		sensor->name = to_string(sensorId);
+		sensor->color = "#ffffff";
+		sensor->useForControl = true;
+		sensor->show = true;
+		sensor->compensateAbsolute = 0;
+		sensor->compensateRelative = 1;
+		sensor->resolution = ResolutionAuto;
+		sensor->sampleRate = 0;
+		sensor->lastReadTime = 0;
+		sensor->lastTemp = 0;
+		sensor->driver_from_json(json::object()); // no type in json means ds18b20
+		sensor->driver = NULL;
+		sensor->driverBusId = bus->id;
+		sensor->nextDriver = NULL;
+		sensor->replaceDriver = false;
+		this->sensors.insert_or_assign(sensor->id, sensor);
 	}
-
-	if (!stirConfig["intervalStop"].is_null() && stirConfig["intervalStop"].is_number())
+	else
 	{
-		this->stirIntervalStop = stirConfig["intervalStop"];
+		sensor = it->second;
+
+		// already working or waiting for its new driver, nothing to do
+		bool waiting = sensor->replaceDriver && sensor->nextDriver;
+		if (sensor->busId == bus->id && (waiting || (sensor->connected && sensor->driver)))
+		{
+			xSemaphoreGive(this->sensorMutex);
+			ds18b20_del_device(newHandle);
+			return true;
+		}
+
+		ESP_LOGI(TAG, "DS18B20 %llu attached to bus %d", sensorId, bus->id);
 	}
 
-	this->stirRun = true;
+	// the handle belongs to a bus, so a sensor that moved or came back gets a new driver
+	// the resolution is set by the read loop once the driver is swapped in
+	sensor->busId = bus->id;
+	this->setSensorDriver(sensor, new DS18B20Driver(newHandle), true);
 
-	xTaskCreate(&this->stirLoop, "stirloop_task", 4096, this, 10, &this->stirLoopHandle);
+	xSemaphoreGive(this->sensorMutex);
 
-	this->stirStatusText = "Running";
+	return true;
 }
 
-void BrewEngine::stopStir()
+void BrewEngine::start(const string &scheduleName)
 {
-	if (!this->stir_PIN)
-	{
-		ESP_LOGW(TAG, "StirPin is not configured, ignoring stopStir!");
-		return;
-	}
+	xSemaphoreTake(this->programMutex, portMAX_DELAY);
 
-	this->stirRun = false;
+	this->selectedMashScheduleName = scheduleName;
 
-	// stop at once
-	gpio_set_level(this->stir_PIN, this->gpioLow);
+	// don't start if we are already running
+	if (!this->controlRun)
+	{
+		this->controlRun = true;
+		this->inOverTime = false;
+		this->boostStatus = Off;
+		this->overrideTargetTemperature = std::nullopt;
+		// clear old temp log, the read tasks append to it
+		xSemaphoreTake(this->sensorMutex, portMAX_DELAY);
+		this->tempLog.Clear();
+		xSemaphoreGive(this->sensorMutex);
 
-	this->stirStatusText = "Idle";
-}
+		// also clear old steps
+		for (auto const &step : this->executionSteps)
+		{
+			delete step.second;
+		}
+		this->executionSteps.clear();
 
-void BrewEngine::stirLoop(void *arg)
-{
-	BrewEngine *instance = (BrewEngine *)arg;
+		string sessionName = this->selectedMashScheduleName.empty() ? "Manual" : this->selectedMashScheduleName;
+		this->brewSessionId = this->brewLog.StartSession(time(0), sessionName);
 
-	while (instance->run && instance->stirRun)
-	{
-		if (instance->stirIntervalStart == 0 && instance->stirIntervalStop == instance->stirTimeSpan)
+		if (this->selectedMashScheduleName.empty() == false)
 		{
-			// always on, just set high and wait for end
-			gpio_set_level(instance->stir_PIN, instance->gpioHigh);
+			this->loadSchedule();
+			this->currentMashStep = 1; // 0 is current temp, so we can start at 1
+
+			// a program can be resumed after a power loss
+			this->saveRunPlan();
+			this->saveRunState(true);
 		}
 		else
 		{
-			system_clock::time_point now = std::chrono::system_clock::now();
-
-			auto startStirTime = instance->stirStartCycle + minutes(instance->stirIntervalStart);
-			auto stopStirTime = instance->stirStartCycle + minutes(instance->stirIntervalStop);
 
-			auto cycleEnd = instance->stirStartCycle + minutes(instance->stirTimeSpan);
-
-			if (now >= startStirTime && now <= stopStirTime)
+			// if no schedule is selected, we set the boil flag based on temperature
+			if ((this->temperatureScale == Celsius && this->targetTemperature >= 100) || (this->temperatureScale == Fahrenheit && this->targetTemperature >= 212))
 			{
-				gpio_set_level(instance->stir_PIN, instance->gpioHigh);
+				this->boilRun = true;
 			}
 			else
 			{
-				gpio_set_level(instance->stir_PIN, instance->gpioLow);
-			}
-
-			// string iso_string1 = instance->to_iso_8601(now);
-			// string iso_string2 = instance->to_iso_8601(startStirTime);
-			// string iso_string3 = instance->to_iso_8601(stopStirTime);
-			// string iso_string4 = instance->to_iso_8601(cycleEnd);
-
-			// ESP_LOGI(TAG, "Stir Cycle Now: %s Start:%s Stop:%s CycleEnd: %s", iso_string1.c_str(), iso_string2.c_str(), iso_string3.c_str(), iso_string4.c_str());
-
-			// start next cycle
-			if (now >= cycleEnd)
-			{
-				instance->stirStartCycle = cycleEnd;
+				this->boilRun = false;
 			}
 		}
 
-		vTaskDelay(pdMS_TO_TICKS(1000));
+		this->startLoops();
 	}
 
-	vTaskDelete(NULL);
+	xSemaphoreGive(this->programMutex);
 }
 
-void BrewEngine::readLoop(void *arg)
+void BrewEngine::startLoops()
 {
-	BrewEngine *instance = (BrewEngine *)arg;
+	if (this->selectedMashScheduleName.empty() == false)
+	{
+		this->createTask(&this->controlLoop, "controlloop_task", 4096, this, 5, &this->controlLoopHandle);
+	}
 
-	int it = 0;
+	this->createTask(&this->pidLoop, "pidloop_task", 8192, this, 5, &this->pidLoopHandle);
 
-	while (instance->run)
+	this->createTask(&this->outputLoop, "outputloop_task", 4096, this, 5, &this->outputLoopHandle);
+
+	this->statusText = "Running";
+}
+
+// the plan only changes on start and after overtime, so it has its own key
+void BrewEngine::saveRunPlan()
+{
+	json jSteps = json::array({});
+	for (auto const &[key, step] : this->executionSteps)
 	{
-		vTaskDelay(pdMS_TO_TICKS(1000));
+		jSteps.push_back(step->to_json());
+	}
 
-		// When we are changing temp settings we temporarily need to skip our temp loop
-		if (instance->skipTempLoop)
-		{
-			continue;
-		}
+	json jNotifications = json::array({});
+	for (auto const &notification : this->notifications)
+	{
+		jNotifications.push_back(notification->to_json());
+	}
 
-		int nrOfSensors = 0;
-		float sum = 0.0;
+	json jPlan;
+	jPlan["name"] = this->selectedMashScheduleName;
+	jPlan["boil"] = this->boilRun;
+	jPlan["steps"] = jSteps;
+	jPlan["notifications"] = jNotifications;
 
-		for (auto &[key, sensor] : instance->sensors)
-		{
-			float temperature;
-			ds18b20_device_handle_t handle = sensor->handle;
-			string stringId = std::to_string(key);
+	this->settingsManager->Write("runPlan", json::to_msgpack(jPlan));
+}
 
-			// not useForControl or connected, continue
-			if (!sensor->handle || !sensor->connected)
-			{
-				continue;
-			}
+// small, so writing it every minute doesn't take long, notifications are done in order so a count is enough
+void BrewEngine::saveRunState(bool force)
+{
+	uint8_t notified = std::count_if(this->notifications.begin(), this->notifications.end(), [](Notification *notification)
+									 { return notification->done; });
+
+	json jState;
+	jState["step"] = this->currentMashStep;
+	jState["overTime"] = this->inOverTime;
+	jState["boost"] = this->boostStatus;
+	jState["notified"] = notified;
+	jState["session"] = this->brewSessionId;
+	if (this->overrideTargetTemperature.has_value())
+	{
+		jState["override"] = this->overrideTargetTemperature.value();
+	}
+	else
+	{
+		jState["override"] = nullptr;
+	}
+	if (this->manualOverrideOutput.has_value())
+	{
+		jState["overrideOutput"] = this->manualOverrideOutput.value();
+	}
+	else
+	{
+		jState["overrideOutput"] = nullptr;
+	}
 
-			esp_err_t err = ds18b20_trigger_temperature_conversion(handle);
+	time_t now = time(0);
 
-			if (err != ESP_OK)
-			{
-				ESP_LOGW(TAG, "Error Reading from [%s], disabling sensor!", stringId.c_str());
-				sensor->connected = false;
-				sensor->lastTemp = 0;
-				instance->currentTemperatures.erase(key);
-				continue;
-			};
+	xSemaphoreTake(this->runStateMutex, portMAX_DELAY);
 
-			err = ds18b20_get_temperature(handle, &temperature);
+	// stop can clear the state while we were building it
+	if (this->controlRun && (force || jState != this->lastRunState || now - this->lastRunStateTime >= RUN_CHECKPOINT_INTERVAL))
+	{
+		this->lastRunState = jState;
+		this->lastRunStateTime = now;
 
-			if (err != ESP_OK)
-			{
-				ESP_LOGW(TAG, "Error Reading from [%s], disabling sensor!", stringId.c_str());
-				sensor->connected = false;
-				sensor->lastTemp = 0;
-				instance->currentTemperatures.erase(key);
-				continue;
-			};
+		// the time of the checkpoint tells us how long the power was gone
+		jState["time"] = now;
+		this->settingsManager->Write("runState", json::to_msgpack(jState));
+	}
 
-			// conversion needed
-			if (instance->temperatureScale == Fahrenheit)
-			{
-				temperature = (temperature * 1.8) + 32;
-			}
+	xSemaphoreGive(this->runStateMutex);
+}
 
-			ESP_LOGD(TAG, "temperature read from [%s]: %.2f°", stringId.c_str(), temperature);
+void BrewEngine::clearRunState()
+{
+	xSemaphoreTake(this->runStateMutex, portMAX_DELAY);
+	this->lastRunState = nullptr;
+	this->settingsManager->Write("runState", json::to_msgpack(json::object()));
+	xSemaphoreGive(this->runStateMutex);
+}
 
-			// apply compensation
-			if (sensor->compensateAbsolute != 0)
-			{
-				temperature = temperature + sensor->compensateAbsolute;
-			}
-			if (sensor->compensateRelative != 0 && sensor->compensateRelative != 1)
-			{
-				temperature = temperature * sensor->compensateRelative;
-			}
+// continues a program that was running when we lost power, the rest of the plan is shifted by the downtime
+void BrewEngine::resumeRun()
+{
+	vector<uint8_t> empty = json::to_msgpack(json::object());
+	json jState = json::from_msgpack(this->settingsManager->Read("runState", empty), true, false);
+	if (!jState.is_object() || !jState.contains("time") || !jState.contains("step"))
+	{
+		return;
+	}
 
-			if (sensor->useForControl)
-			{
-				sum += temperature;
-				nrOfSensors++;
-			}
+	json jPlan = json::from_msgpack(this->settingsManager->Read("runPlan", empty), true, false);
+	if (!jPlan.is_object() || !jPlan.contains("steps") || !jPlan.contains("notifications"))
+	{
+		this->clearRunState();
+		return;
+	}
+
+	// without ntp the clock starts in 1970 and the downtime would move the plan decades into the past, so we wait for it
+	time_t now = time(0);
+	for (int wait = 0; now < RUN_RESUME_VALID_TIME && wait < RUN_RESUME_CLOCK_WAIT; wait++)
+	{
+		vTaskDelay(pdMS_TO_TICKS(1000));
+		now = time(0);
+	}
 
-			sensor->lastTemp = temperature;
+	// a start or stop in the meantime waits until the plan is rebuilt, or we see the program it started
+	xSemaphoreTake(this->programMutex, portMAX_DELAY);
 
-			// we also add our temps to a map individualy, might be nice to see bottom and top temp in gui
-			if (sensor->show)
-			{
-				instance->currentTemperatures.insert_or_assign(key, sensor->lastTemp);
-			}
-		}
+	// a program was started while we waited, it has its own state
+	if (this->controlRun)
+	{
+		xSemaphoreGive(this->programMutex);
+		return;
+	}
 
-		float avg = sum / nrOfSensors;
+	if (now < RUN_RESUME_VALID_TIME)
+	{
+		ESP_LOGW(TAG, "Program not resumed, the clock was not set");
+		this->clearRunState();
+		xSemaphoreGive(this->programMutex);
+		return;
+	}
 
-		ESP_LOGD(TAG, "Avg Temperature: %.2f°", avg);
+	int64_t downTime = std::max((int64_t)0, (int64_t)(now - jState["time"].get<time_t>()));
+	if (downTime > RUN_RESUME_MAX_DOWNTIME)
+	{
+		ESP_LOGW(TAG, "Program not resumed, power was lost for %lld seconds", downTime);
+		this->clearRunState();
+		xSemaphoreGive(this->programMutex);
+		return;
+	}
 
-		instance->temperature = avg;
+	ESP_LOGI(TAG, "Resuming program after %lld seconds", downTime);
 
-		// when controlrun is true we need to keep out data
-		if (instance->controlRun)
+	// like recalculateScheduleAfterOverTime, only what is still ahead of us moves
+	uint16_t currentStep = jState["step"].get<uint16_t>();
+	uint16_t stepIndex = 0;
+	for (auto const &jStep : jPlan["steps"])
+	{
+		auto step = new ExecutionStep();
+		step->from_json(jStep);
+		if (stepIndex >= currentStep)
 		{
-			// we don't have that much ram so we log only every 5 cycles
+			step->time += seconds(downTime);
+		}
+		this->executionSteps.insert(std::make_pair(stepIndex++, step));
+	}
 
-			it++;
-			if (it > 5)
-			{
-				it = 0;
-				int lastTemp = 0;
+	uint8_t notified = jState["notified"].get<uint8_t>();
+	for (auto const &jNotification : jPlan["notifications"])
+	{
+		auto notification = new Notification();
+		notification->from_json(jNotification);
+		notification->timePoint = system_clock::from_time_t(jNotification["timePoint"].get<time_t>());
+		notification->done = this->notifications.size() < notified;
+		if (!notification->done)
+		{
+			notification->timePoint += seconds(downTime);
+		}
+		this->notifications.push_back(notification);
+	}
 
-				if (!instance->tempLog.empty())
-				{
-					auto lastValue = instance->tempLog.rbegin();
-					lastTemp = lastValue->second;
-				}
+	this->selectedMashScheduleName = jPlan["name"].get<string>();
+	this->boilRun = jPlan["boil"].get<bool>();
+	this->currentMashStep = currentStep;
+	this->inOverTime = jState["overTime"].get<bool>();
+	this->boostStatus = (BoostStatus)jState["boost"].get<int>();
+	if (jState["override"].is_number())
+	{
+		this->overrideTargetTemperature = jState["override"].get<float>();
+	}
+	if (jState.contains("overrideOutput") && jState["overrideOutput"].is_number())
+	{
+		this->manualOverrideOutput = jState["overrideOutput"].get<int8_t>();
+	}
 
-				if (lastTemp != (int)avg)
-				{
-					// decided agains chrono just make it a hell lot more complex
-					// instance->tempLog.insert(std::make_pair(std::chrono::system_clock::now(), (int)avg));
-					time_t current_raw_time = time(0);
-					// System time: number of seconds since 00:00,
-					instance->tempLog.insert(std::make_pair(current_raw_time, (int)avg));
+	this->brewSessionId = jState["session"].get<uint32_t>();
+	if (!this->executionSteps.empty())
+	{
+		auto start = system_clock::to_time_t(this->executionSteps.begin()->second->time);
+		this->brewLog.ResumeSession(this->brewSessionId, start, this->selectedMashScheduleName);
+	}
+	this->logEvent("Resumed after " + to_string(downTime) + "s");
 
-					ESP_LOGI(TAG, "Logging: %d°", (int)avg);
-				}
-				else
-				{
-					ESP_LOGI(TAG, "Skip same");
-				}
-			}
+	this->controlRun = true;
+	this->runningVersion++;
 
-			if (instance->mqttEnabled)
-			{
-				string iso_datetime = to_iso_8601(std::chrono::system_clock::now());
-				json jPayload;
-				jPayload["time"] = iso_datetime;
-				jPayload["temp"] = instance->temperature;
-				jPayload["target"] = instance->targetTemperature;
-				jPayload["output"] = instance->pidOutput;
-				string payload = jPayload.dump();
-
-				esp_mqtt_client_publish(instance->mqttClient, instance->mqttTopic.c_str(), payload.c_str(), 0, 1, 1);
-			}
-		}
+	// the shifted plan is our new plan
+	this->saveRunPlan();
+	this->saveRunState(true);
+
+	this->startLoops();
+
+	xSemaphoreGive(this->programMutex);
+}
+
+// loop tasks are created and end through these, so their handles are never used after the task is gone
+void BrewEngine::createTask(TaskFunction_t function, const char *name, uint32_t stackSize, void *arg, UBaseType_t priority, TaskHandle_t *handle)
+{
+	xSemaphoreTake(this->taskMutex, portMAX_DELAY);
+	xTaskCreate(function, name, stackSize, arg, priority, handle);
+	xSemaphoreGive(this->taskMutex);
+}
+
+void BrewEngine::deleteTask(TaskHandle_t *handle)
+{
+	xSemaphoreTake(this->taskMutex, portMAX_DELAY);
+	// a program that was started again right after a stop can already have a new task in the handle
+	if (*handle == xTaskGetCurrentTaskHandle())
+	{
+		*handle = NULL;
 	}
+	xSemaphoreGive(this->taskMutex);
 
 	vTaskDelete(NULL);
 }
 
-void BrewEngine::pidLoop(void *arg)
+void BrewEngine::resumeLoop(void *arg)
 {
 	BrewEngine *instance = (BrewEngine *)arg;
 
-	double kP, kI, kD;
-	if (instance->boilRun)
+	instance->resumeRun();
+
+	vTaskDelete(NULL);
+}
+
+void BrewEngine::loadSchedule()
+{
+	auto pos = this->mashSchedules.find(this->selectedMashScheduleName);
+
+	if (pos == this->mashSchedules.end())
 	{
-		kP = instance->boilkP;
-		kI = instance->boilkI;
-		kD = instance->boilkD;
+		ESP_LOGE(TAG, "Program with name: %s not found!", this->selectedMashScheduleName.c_str());
+		return;
 	}
-	else
+	auto schedule = pos->second;
+
+	system_clock::time_point prevTime = std::chrono::system_clock::now();
+
+	for (auto const &step : this->executionSteps)
 	{
-		kP = instance->mashkP;
-		kI = instance->mashkI;
-		kD = instance->mashkD;
+		delete step.second;
 	}
+	this->executionSteps.clear();
 
-	PIDController pid(kP, kI, kD);
-	pid.setMin(0);
-	pid.setMax(100);
-	pid.debug = false;
+	this->currentExecutionStep = 0;
+	this->boilRun = schedule->boil;
+	int stepIndex = 0;
 
-	uint totalWattage = 0;
+	float prevTemp = this->temperature;
+	// insert the current as starting point
+	auto execStep0 = new ExecutionStep();
+	execStep0->time = prevTime;
+	execStep0->temperature = prevTemp;
+	execStep0->extendIfNeeded = false;
+	this->executionSteps.insert(std::make_pair(stepIndex, execStep0));
 
-	// we calculate the total wattage we have availible, depens on heaters and on mash or boil
-	for (auto &heater : instance->heaters)
-	{
+	string iso_string = this->to_iso_8601(prevTime);
+	ESP_LOGI(TAG, "Time:%s, Temp:%f Extend:%d", iso_string.c_str(), prevTemp, execStep0->extendIfNeeded);
 
-		if (instance->boilRun && heater->useForBoil)
-		{
-			totalWattage += heater->watt;
-			heater->enabled = true;
-		}
-		else if (!instance->boilRun && heater->useForMash)
-		{
-			totalWattage += heater->watt;
-			heater->enabled = true;
-		}
-		else
-		{
-			heater->enabled = false;
-		}
-	}
+	int extendNotifications = 0;
 
-	while (instance->run && instance->controlRun)
-	{
-		// Output is %
-		int outputPercent = (int)pid.getOutput((double)instance->temperature, (double)instance->targetTemperature);
-		instance->pidOutput = outputPercent;
-		ESP_LOGI(TAG, "Pid Output: %d Target: %f", instance->pidOutput, instance->targetTemperature);
+	stepIndex++;
 
-		// Manual override and boost
-		if (instance->manualOverrideOutput.has_value())
-		{
-			// Here we don't override the pidOutput display since we want the user to see the pid values even when overriding
-			outputPercent = instance->manualOverrideOutput.value();
-		}
-		else if (instance->boostStatus == Boost)
-		{
-			outputPercent = 100;
-			instance->pidOutput = 100;
-		}
-		else if (instance->heaterLimit < outputPercent)
-		{
-			outputPercent = instance->heaterLimit;
-			instance->pidOutput = instance->heaterLimit;
-		}
-		else if (instance->boostStatus == Rest)
-		{
-			outputPercent = 0;
-			instance->pidOutput = 0;
-		}
+	for (auto const &step : schedule->steps)
+	{
+		// a step can actualy be 2 different executions, 1 step time that needs substeps calcualted, and one fixed
 
-		// set all to 0
-		for (auto &heater : instance->heaters)
+		if (step->stepTime > 0 || step->extendStepTimeIfNeeded)
 		{
-			heater->burnTime = 0;
-		}
 
-		// calc the wattage we need
-		int outputWatt = (totalWattage / 100) * outputPercent;
+			int stepTime = step->stepTime;
 
-		// we need to calculate our burn time per output
-		for (auto &heater : instance->heaters)
-		{
-			if (!heater->enabled)
+			// when the users request step extended, we need a step so 0 isn't valid we default to 1 min
+			if (stepTime == 0)
 			{
-				continue;
+				stepTime = 1;
+				extendNotifications += 60;
 			}
 
-			if (outputWatt < 0)
+			auto stepEndTime = prevTime + minutes(stepTime);
+
+			int subStepsInStep;
+
+			// When boost mode is active we don't want substeps this only complicates things
+			if (step->allowBoost && this->boostModeUntil > 0)
 			{
-				break;
+				subStepsInStep = 1;
 			}
-
-			// we can complete it with this heater
-			if (heater->watt > outputWatt)
+			else
 			{
-				heater->burnTime = (int)(((double)outputWatt / (double)heater->watt) * 100);
-				
-				if (heater->burnTime <= instance->relayGuard/2)
-				{
-					heater->burnTime=0;
-				}
-				else if (heater->burnTime <= instance->relayGuard)
+				auto secondsInStep = chrono::duration_cast<chrono::seconds>(stepEndTime - prevTime).count();
+				subStepsInStep = (secondsInStep / this->stepInterval) - 1;
+
+				// we need atleast one step
+				if (subStepsInStep < 1)
 				{
-					heater->burnTime=instance->relayGuard;
+					subStepsInStep = 1;
 				}
+			}
 
-				if (heater->burnTime >= 100 - instance->relayGuard/2)
-				{
-					heater->burnTime=100;
-				}
-				else if (heater->burnTime >= 100 - instance->relayGuard)
-				{
-					heater->burnTime=100 - instance->relayGuard;
-				}
-				
-				ESP_LOGD(TAG, "Pid Calc Heater %s: OutputWatt: %d Burn: %d", heater->name.c_str(), outputWatt, heater->burnTime);
-				break;
-			}
-			else
-			{
-				// we can't complete it, take out part and continue
-				outputWatt -= heater->watt;
-				heater->burnTime = 100;
-				ESP_LOGD(TAG, "Pid Calc Heater %s: OutputWatt: %d Burn: 100", heater->name.c_str(), outputWatt);
-			}
-		}
+			float tempDiffPerStep = (step->temperature - prevTemp) / (float)subStepsInStep;
 
-		// Shorter heater cycles for even temperature and prevent hot spots
-		int heaterLoopTime = instance->pidLoopTime / instance->heaterCycles;
-		
-		// we keep going for the desired pidlooptime and set the burn by percent
-		for (int i = 0; i < instance->pidLoopTime / instance->heaterCycles; i++)
-		{
-			if (!instance->run || !instance->controlRun)
-			{
-				break;
-			}
+			float prevStepTemp = 0;
 
-			for (auto &heater : instance->heaters)
+			for (int j = 0; j < subStepsInStep; j++)
 			{
-				if (!heater->enabled)
-				{
-					continue;
-				}
+				system_clock::time_point executionStepTime = prevTime;
+				executionStepTime += seconds((j + 1) * stepInterval);
 
-				int burnUntil = 0;
+				float subStepTemp = prevTemp + (tempDiffPerStep * ((float)j + 1));
 
-				if (heater->burnTime > 0)
+				// insert the current as starting point
+				auto execStep = new ExecutionStep();
+				execStep->time = executionStepTime;
+				execStep->temperature = subStepTemp;
+				execStep->extendIfNeeded = false;
+
+				if (step->allowBoost && this->boostModeUntil > 0)
 				{
-					burnUntil = ((double)heater->burnTime / 100) * (double)instance->pidLoopTime / (double)instance->heaterCycles; // convert % back to seconds (per heater cycle)
+					execStep->allowBoost = true;
+				}
+				else
+				{
+					execStep->allowBoost = false;
 				}
 
-				if (burnUntil > i % heaterLoopTime) // on 
+				// set extend if needed on last step if configured
+				if (j == (subStepsInStep - 1) && step->extendStepTimeIfNeeded)
 				{
-					if (heater->burn != true) // only when not current, we don't want to spam the logs
-					{
-						heater->burn = true;
-						ESP_LOGD(TAG, "Heater %s: On", heater->name.c_str());
-					}
+					execStep->extendIfNeeded = true;
 				}
-				else // off
+
+				float diff = abs(subStepTemp - prevStepTemp);
+				// ESP_LOGI(TAG, "Diff:%f, subStepTemp:%f prevStepTemp:%f", diff, subStepTemp, prevStepTemp);
+
+				// only insert if difference or if last step more then 1 degree
+				if (diff > 1 || (j == subStepsInStep - 1))
 				{
-					if (heater->burn != false) // only when not current, we don't want to spam the logs
-					{
-						heater->burn = false;
-						ESP_LOGD(TAG, "Heater %s: Off", heater->name.c_str());
-					}
+					this->executionSteps.insert(std::make_pair(stepIndex, execStep));
+					prevStepTemp = execStep->temperature;
+					stepIndex++;
+
+					// Convert the time_point to an ISO 8601 string
+					string iso_string = this->to_iso_8601(executionStepTime);
+
+					ESP_LOGI(TAG, "Time:%s, Temp:%f Extend:%d", iso_string.c_str(), subStepTemp, execStep->extendIfNeeded);
 				}
 			}
 
-			// when our target changes we also update our pid target
-			if (instance->resetPitTime)
-			{
-				ESP_LOGI(TAG, "Reset Pid Timer");
-				instance->resetPitTime = false;
-				break;
-			}
+			prevTime = stepEndTime;
+			prevTemp = prevStepTemp;
+		}
+		else
+		{
+			// we start in 10 seconds
+			auto stepEndTime = prevTime + seconds(10);
 
-			vTaskDelay(pdMS_TO_TICKS(1000));
+			// go directly to temp
+			auto execStep = new ExecutionStep();
+			execStep->time = stepEndTime;
+			execStep->temperature = (float)step->temperature;
+			execStep->extendIfNeeded = step->extendStepTimeIfNeeded;
+
+			this->executionSteps.insert(std::make_pair(stepIndex, execStep));
+
+			stepIndex++;
+
+			// Convert the time_point to an ISO 8601 string
+			string iso_string = this->to_iso_8601(prevTime);
+
+			ESP_LOGI(TAG, "Time:%s, Temp:%f Extend:%d", iso_string.c_str(), (float)step->temperature, execStep->extendIfNeeded);
+
+			prevTime = stepEndTime;
+			prevTemp = (float)step->temperature;
 		}
+
+		// for the hold time we just need add one point
+		auto holdEndTime = prevTime + minutes(step->time);
+
+		auto holdStep = new ExecutionStep();
+		holdStep->time = holdEndTime;
+		holdStep->temperature = (float)step->temperature;
+		holdStep->extendIfNeeded = false;
+
+		this->executionSteps.insert(std::make_pair(stepIndex, holdStep));
+		stepIndex++;
+
+		prevTime = holdEndTime;
+		prevTemp = step->temperature; // is normaly the same but this could change in futrure
+
+		string iso_string2 = this->to_iso_8601(holdEndTime);
+		ESP_LOGI(TAG, "Hold Time:%s, Temp:%f ", iso_string2.c_str(), (float)step->temperature);
 	}
 
-	instance->pidOutput = 0;
+	// also add notifications
+	for (auto const &notification : this->notifications)
+	{
+		delete notification;
+	}
+	this->notifications.clear();
 
-	vTaskDelete(NULL);
+	for (auto const &notification : schedule->notifications)
+	{
+		auto notificationTime = execStep0->time + minutes(notification->timeFromStart) + seconds(extendNotifications);
+
+		// copy notification to new map
+		auto newNotification = new Notification();
+		newNotification->name = notification->name;
+		newNotification->message = notification->message;
+		newNotification->timeFromStart = notification->timeFromStart + (extendNotifications / 60); // in minutes
+		newNotification->timePoint = notificationTime;
+
+		this->notifications.push_back(newNotification);
+	}
+
+	// increate version so client can follow changes
+	this->runningVersion++;
+
+	this->saveRunPlan();
 }
 
-void BrewEngine::outputLoop(void *arg)
+void BrewEngine::recalculateScheduleAfterOverTime()
 {
-	BrewEngine *instance = (BrewEngine *)arg;
+	ESP_LOGI(TAG, "Recalculate Schedule after OverTime");
 
-	for (auto const &heater : instance->heaters)
+	int currentStepIndex = this->currentMashStep;
+
+	auto currentPos = this->executionSteps.find(currentStepIndex);
+
+	if (currentPos == this->executionSteps.end())
 	{
-		gpio_set_level(heater->pinNr, instance->gpioLow);
+		ESP_LOGE(TAG, "Steps not availible anymore");
+		this->stop();
+		return;
 	}
 
-	while (instance->run && instance->controlRun)
+	auto currentStep = currentPos->second;
+	system_clock::time_point plannedEnd = currentStep->time;
+
+	system_clock::time_point now = std::chrono::system_clock::now();
+	auto extraSeconds = chrono::duration_cast<chrono::seconds>(now - plannedEnd).count();
+
+	for (auto it = currentPos; it != this->executionSteps.end(); ++it)
 	{
-		vTaskDelay(pdMS_TO_TICKS(1000));
+		auto step = it->second;
+		auto newTime = step->time + seconds(extraSeconds);
 
-		for (auto const &heater : instance->heaters)
-		{
-			if (heater->burn)
-			{
-				ESP_LOGD(TAG, "Output %s: On", heater->name.c_str());
-				gpio_set_level(heater->pinNr, instance->gpioHigh);
-			}
-			else
-			{
-				ESP_LOGD(TAG, "Output %s: Off", heater->name.c_str());
-				gpio_set_level(heater->pinNr, instance->gpioLow);
-			}
-		}
+		string iso_string = this->to_iso_8601(step->time);
+		string iso_string2 = this->to_iso_8601(newTime);
+
+		ESP_LOGI(TAG, "Time Changend From: %s, To:%s ", iso_string.c_str(), iso_string2.c_str());
+
+		step->time = newTime;
+	}
+
+	// also increase notifications
+	for (auto &notification : this->notifications)
+	{
+		auto newTime = notification->timePoint + seconds(extraSeconds);
+
+		string iso_string = this->to_iso_8601(notification->timePoint);
+		string iso_string2 = this->to_iso_8601(newTime);
+
+		ESP_LOGI(TAG, "Notification Time Changend From: %s, To:%s ", iso_string.c_str(), iso_string2.c_str());
+
+		notification->timePoint = newTime;
+	}
+
+	// increate version so client can follow changes
+	this->runningVersion++;
+}
+
+void BrewEngine::stop()
+{
+	xSemaphoreTake(this->programMutex, portMAX_DELAY);
+
+	bool wasRunning = this->controlRun;
+	this->controlRun = false;
+
+	// control loop checkpoints until it sees controlRun, so we clear after
+	if (wasRunning)
+	{
+		this->brewLog.EndSession(time(0));
+		this->clearRunState();
+	}
+
+	this->boostStatus = Off;
+	this->inOverTime = false;
+	this->statusText = "Idle";
+
+	xSemaphoreGive(this->programMutex);
+}
+
+void BrewEngine::startStir(const json &stirConfig)
+{
+	if (!this->stir_PIN)
+	{
+		ESP_LOGW(TAG, "StirPin is not configured, ignoring startStir!");
+		return;
+	}
+
+	system_clock::time_point now = std::chrono::system_clock::now();
+	this->stirStartCycle = now;
+
+	if (stirConfig.contains("max") && stirConfig["max"].is_number())
+	{
+		this->stirTimeSpan = stirConfig["max"];
+	}
+
+	if (stirConfig.contains("intervalStart") && stirConfig["intervalStart"].is_number())
+	{
+		this->stirIntervalStart = stirConfig["intervalStart"];
+	}
+
+	if (stirConfig.contains("intervalStop") && stirConfig["intervalStop"].is_number())
+	{
+		this->stirIntervalStop = stirConfig["intervalStop"];
+	}
+
+	this->stirRun = true;
+
+	this->createTask(&this->stirLoop, "stirloop_task", 4096, this, 10, &this->stirLoopHandle);
+
+	this->stirStatusText = "Running";
+}
+
+void BrewEngine::stopStir()
+{
+	if (!this->stir_PIN)
+	{
+		ESP_LOGW(TAG, "StirPin is not configured, ignoring stopStir!");
+		return;
+	}
+
+	this->stirRun = false;
+
+	// stop at once
+	gpio_set_level(this->stir_PIN, this->gpioLow);
+
+	this->stirStatusText = "Idle";
+}
+
+void BrewEngine::stirLoop(void *arg)
+{
+	BrewEngine *instance = (BrewEngine *)arg;
+
+	while (instance->run && instance->stirRun)
+	{
+		if (instance->stirIntervalStart == 0 && instance->stirIntervalStop == instance->stirTimeSpan)
+		{
+			// always on, just set high and wait for end
+			gpio_set_level(instance->stir_PIN, instance->gpioHigh);
+		}
+		else
+		{
+			system_clock::time_point now = std::chrono::system_clock::now();
+
+			auto startStirTime = instance->stirStartCycle + minutes(instance->stirIntervalStart);
+			auto stopStirTime = instance->stirStartCycle + minutes(instance->stirIntervalStop);
+
+			auto cycleEnd = instance->stirStartCycle + minutes(instance->stirTimeSpan);
+
+			if (now >= startStirTime && now <= stopStirTime)
+			{
+				gpio_set_level(instance->stir_PIN, instance->gpioHigh);
+			}
+			else
+			{
+				gpio_set_level(instance->stir_PIN, instance->gpioLow);
+			}
+
+			// string iso_string1 = instance->to_iso_8601(now);
+			// string iso_string2 = instance->to_iso_8601(startStirTime);
+			// string iso_string3 = instance->to_iso_8601(stopStirTime);
+			// string iso_string4 = instance->to_iso_8601(cycleEnd);
+
+			// ESP_LOGI(TAG, "Stir Cycle Now: %s Start:%s Stop:%s CycleEnd: %s", iso_string1.c_str(), iso_string2.c_str(), iso_string3.c_str(), iso_string4.c_str());
+
+			// start next cycle
+			if (now >= cycleEnd)
+			{
+				instance->stirStartCycle = cycleEnd;
+			}
+		}
+
+		vTaskDelay(pdMS_TO_TICKS(1000));
+	}
+
+	instance->deleteTask(&instance->stirLoopHandle);
+}
+
+void BrewEngine::readTimerCallback(void *arg)
+{
+	TemperatureBus *bus = (TemperatureBus *)arg;
+
+	// we only wake up the read loop, bus access doesn't belong in the timer task
+	xTaskNotifyGive(bus->readLoopHandle);
+}
+
+void BrewEngine::readLoop(void *arg)
+{
+	// tasks only get one argument, the engine is our main instance
+	TemperatureBus *bus = (TemperatureBus *)arg;
+	BrewEngine *instance = mainInstance;
+
+	esp_timer_create_args_t timerArgs = {};
+	timerArgs.callback = &readTimerCallback;
+	timerArgs.arg = bus;
+	timerArgs.name = "read_timer";
+	ESP_ERROR_CHECK(esp_timer_create(&timerArgs, &bus->readTimer));
+
+	AcquisitionState state = Idle;
+	int64_t periodStart = esp_timer_get_time();
+	system_clock::time_point sampleTime;
+
+	while (instance->run)
+	{
+		int64_t deadline;
+
+		// a bus can run faster then the rest, so fast spi probes aren't held back by slow 1-Wire sensors
+		int64_t interval = (bus->interval > 0 ? bus->interval : instance->tempReadInterval) * 1000;
+
+		if (state == Idle)
+		{
+			sampleTime = system_clock::now();
+
+			uint16_t conversionTime = 0;
+
+			// When we are changing temp settings we temporarily need to skip our temp loop
+			if (!instance->skipTempLoop && instance->startConversion(bus, conversionTime) == ESP_OK)
+			{
+				// the bus is converting now, we get woken up when the slowest sensor should be done
+				state = Converting;
+				deadline = esp_timer_get_time() + (conversionTime * 1000);
+			}
+			else
+			{
+				periodStart += interval;
+				deadline = periodStart;
+			}
+		}
+		else
+		{
+			instance->readTemperatures(bus, sampleTime);
+			bus->lastSweepTime = (uint32_t)((esp_timer_get_time() - periodStart) / 1000);
+			ESP_LOGD(TAG, "Bus %d Sweep Time: %lums", bus->id, bus->lastSweepTime);
+
+			// when controlrun is true we need to keep out data
+			if (instance->controlRun)
+			{
+				instance->logTemperature(sampleTime);
+			}
+
+			instance->publishSensorHealth();
+
+			state = Idle;
+			periodStart += interval;
+			deadline = periodStart;
+		}
+
+		int64_t now = esp_timer_get_time();
+
+		// when we overrun a period we don't try to catch up, that would only give a burst of samples
+		if (state == Idle && periodStart < now)
+		{
+			periodStart = now;
+			deadline = now;
+		}
+
+		// look for sensors that were plugged in or came back, only in the gap before the next sample
+		if (state == Idle)
+		{
+			instance->discoverStep(bus, deadline);
+			now = esp_timer_get_time();
+		}
+
+		if (deadline > now)
+		{
+			esp_timer_start_once(bus->readTimer, deadline - now);
+			ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+		}
+	}
+
+	esp_timer_delete(bus->readTimer);
+	bus->readTimer = NULL;
+
+	instance->deleteTask(&bus->readLoopHandle);
+}
+
+void BrewEngine::readTemperatures(TemperatureBus *bus, system_clock::time_point sampleTime)
+{
+	// what a sensor gave this sample, the sensor itself is only changed under the lock
+	struct SensorReading
+	{
+		TemperatureSensor *sensor;
+		bool ready;
+		esp_err_t err;
+		float temperature;
+		int64_t readTime;
+	};
+
+	// first read the whole bus, other buses are read at the same time so we only lock to publish
+	std::vector<SensorReading> readings;
+
+	for (auto &sensor : this->busSensors(bus))
+	{
+		SensorReading reading = {sensor, sensor->driver->Poll(), ESP_OK, 0, 0};
+
+		if (reading.ready)
+		{
+			reading.err = sensor->driver->Read(reading.temperature);
+			reading.readTime = esp_timer_get_time();
+		}
+
+		readings.push_back(reading);
+	}
+
+	xSemaphoreTake(this->sensorMutex, portMAX_DELAY);
+
+	int64_t fusionTime = esp_timer_get_time();
+
+	for (auto &reading : readings)
+	{
+		TemperatureSensor *sensor = reading.sensor;
+		float temperature = reading.temperature;
+		string stringId = std::to_string(sensor->id);
+
+		// not done yet, we keep the last value and try again next sample
+		if (!reading.ready)
+		{
+			ESP_LOGD(TAG, "Sensor [%s] not ready", stringId.c_str());
+			sensor->stats.AddError(ESP_ERR_TIMEOUT);
+			continue;
+		}
+
+		if (reading.err != ESP_OK)
+		{
+			sensor->stats.AddError(reading.err);
+			sensor->consecutiveErrors++;
+
+			// one bad read can be noise on the bus, we only give up after a few
+			if (sensor->consecutiveErrors >= SENSOR_MAX_ERRORS)
+			{
+				ESP_LOGW(TAG, "Error Reading from [%s], disabling sensor until it's found again!", stringId.c_str());
+				sensor->connected = false;
+				sensor->lastTemp = 0;
+
+				// search soon, so it's back as fast as possible
+				bus->nextSearch = 0;
+			}
+			else
+			{
+				ESP_LOGW(TAG, "Error Reading from [%s]: %s", stringId.c_str(), esp_err_to_name(reading.err));
+			}
+			continue;
+		};
+
+		sensor->consecutiveErrors = 0;
+
+		// conversion needed
+		if (this->temperatureScale == Fahrenheit)
+		{
+			temperature = (temperature * 1.8) + 32;
+		}
+
+		ESP_LOGD(TAG, "temperature read from [%s]: %.2f°", stringId.c_str(), temperature);
+
+		// apply compensation
+		if (sensor->compensateAbsolute != 0)
+		{
+			temperature = temperature + sensor->compensateAbsolute;
+		}
+		if (sensor->compensateRelative != 0 && sensor->compensateRelative != 1)
+		{
+			temperature = temperature * sensor->compensateRelative;
+		}
+
+		if (sensor->lastReadTime > 0)
+		{
+			sensor->sampleRate = 1000000.0 / (float)(reading.readTime - sensor->lastReadTime);
+		}
+		sensor->lastReadTime = reading.readTime;
+		sensor->stats.AddRead(temperature, (uint32_t)(reading.readTime - bus->conversionStart));
+
+		// median filtered, so a single bad read doesn't show up or reach the pid
+		std::optional<float> median = this->fusion.AddSample(sensor->id, temperature, fusionTime, sensor->useForControl);
+		if (!median.has_value())
+		{
+			// the median window is still filling, a power-on value could be in it
+			continue;
+		}
+		sensor->lastTemp = median.value();
+
+		// we also add our temps to a map individualy, might be nice to see bottom and top temp in gui
+		if (sensor->show)
+		{
+			this->currentTemperatures.insert_or_assign(sensor->id, sensor->lastTemp);
+		}
+	}
+
+	for (auto &[key, sensor] : this->sensors)
+	{
+		if (!sensor->connected)
+		{
+			this->currentTemperatures.erase(key);
+			this->fusion.Remove(key);
+		}
+	}
+
+	// all control sensors are fused together once per read period, by the first bus that finishes a sweep in it
+	// fusing after every bus sweep would see the offset between the sensors of different buses as a rate
+	// the margin keeps jitter from handing the fusion to another bus every other period
+	int64_t period = (int64_t)this->tempReadInterval * 1000;
+	if (fusionTime - this->lastFusionTime >= period - period / 10 && this->fusion.Update(fusionTime))
+	{
+		this->lastFusionTime = fusionTime;
+		this->temperature = this->fusion.Temperature();
+		this->temperatureRate = this->fusion.Rate();
+		this->lastSampleTime = sampleTime;
+
+		ESP_LOGD(TAG, "Fused Temperature: %.2f° Rate: %.3f°/s", this->temperature, this->temperatureRate);
+	}
+
+	xSemaphoreGive(this->sensorMutex);
+}
+
+void BrewEngine::logTemperature(system_clock::time_point sampleTime)
+{
+	xSemaphoreTake(this->sensorMutex, portMAX_DELAY);
+
+	// every bus calls us after its sweep, we only need one point per interval
+	if (sampleTime - this->lastLogTime < milliseconds(this->tempReadInterval))
+	{
+		xSemaphoreGive(this->sensorMutex);
+		return;
+	}
+	this->lastLogTime = sampleTime;
+
+	// the history has a fixed size, so we don't need every sample
+	if (sampleTime - this->lastHistoryTime >= milliseconds(TEMP_LOG_PERIOD))
+	{
+		this->lastHistoryTime = sampleTime;
+
+		// one column per channel, temperatures in 0.1°, output in %
+		std::map<string, int16_t> row;
+		row["temp"] = (int16_t)std::round(this->temperature * 10);
+		row["target"] = (int16_t)std::round(this->targetTemperature * 10);
+		row["output"] = (int16_t)this->pidOutput;
+
+		for (auto const &[key, val] : this->currentTemperatures)
+		{
+			row["s" + to_string(key)] = (int16_t)std::round(val * 10);
+		}
+
+		// burn state per heater and the step we are in, so an export shows what the controller did
+		for (auto const &heater : this->heaters)
+		{
+			row["h" + to_string(heater->id)] = heater->burn ? 1 : 0;
+		}
+		if (this->controlRun && !this->selectedMashScheduleName.empty())
+		{
+			row["mashStep"] = (int16_t)this->currentMashStep;
+		}
+
+		// the chart draws a line to the next point, so the same values don't need to be logged
+		if (!this->tempLog.SameAsLast(row))
+		{
+			// System time: number of seconds since 00:00, we use the time the sample was taken, not the time it was read
+			time_t sampleRawTime = system_clock::to_time_t(sampleTime);
+			this->tempLog.Append(sampleRawTime, row);
+
+			// only kept when a session is running
+			this->brewLog.AddSample(sampleRawTime, row["temp"], row["target"], this->pidOutput);
+
+			ESP_LOGD(TAG, "Logging: %.1f°", this->temperature);
+		}
+	}
+
+	xSemaphoreGive(this->sensorMutex);
+
+	// live clients get the new sample
+	if (this->pushLoopHandle != NULL)
+	{
+		xTaskNotifyGive(this->pushLoopHandle);
+	}
+
+	if (this->mqttEnabled)
+	{
+		string iso_datetime = to_iso_8601(sampleTime);
+		json jPayload;
+		jPayload["time"] = iso_datetime;
+		jPayload["temp"] = this->temperature;
+		jPayload["target"] = this->targetTemperature;
+		jPayload["output"] = this->pidOutput;
+		string payload = jPayload.dump();
+
+		esp_mqtt_client_publish(this->mqttClient, this->mqttTopic.c_str(), payload.c_str(), 0, 1, 1);
+	}
+}
+
+// the part of the Data command that is also pushed to live clients, values are rounded so small changes don't cause a push
+void BrewEngine::liveGroup(JsonWriter &writer, LiveGroup group)
+{
+	switch (group)
+	{
+	case LiveTemperature:
+	{
+		writer.Key("temp");
+		writer.Tenths((int)(this->temperature * 10)); // round float to 1 digit for display
+
+		// the read tasks change the map, we copy it so we don't hold the lock while the writer flushes to a socket
+		xSemaphoreTake(this->sensorMutex, portMAX_DELAY);
+		std::vector<std::pair<uint64_t, float>> temperatures(this->currentTemperatures.begin(), this->currentTemperatures.end());
+		xSemaphoreGive(this->sensorMutex);
+
+		// currenttemps is an array of current temps, they are not necessarily all used for control
+		writer.Key("temps");
+		writer.BeginArray();
+		for (auto const &[key, val] : temperatures)
+		{
+			char sensor[24];
+			auto result = std::to_chars(sensor, sensor + sizeof(sensor), key);
+
+			writer.BeginObject();
+			writer.Key("sensor");
+			writer.String(string_view(sensor, result.ptr - sensor)); // js doesn't support unint64
+			writer.Key("temp");
+			writer.Tenths((int)(val * 10));
+			writer.EndObject();
+		}
+		writer.EndArray();
+
+		writer.Key("tempRate");
+		writer.Tenths((int)(this->temperatureRate * 600)); // in ° per minute
+		break;
+	}
+	case LiveOutput:
+		writer.Key("output");
+		writer.Int(this->pidOutput);
+
+		writer.Key("manualOverrideOutput");
+		if (this->manualOverrideOutput.has_value())
+		{
+			writer.Int(this->manualOverrideOutput.value());
+		}
+		else
+		{
+			writer.Null();
+		}
+		break;
+	case LiveStatus:
+		writer.Key("status");
+		writer.String(this->statusText);
+		writer.Key("stirStatus");
+		writer.String(this->stirStatusText);
+		writer.Key("inOverTime");
+		writer.Bool(this->inOverTime);
+		writer.Key("boostStatus");
+		writer.Int(this->boostStatus);
+		break;
+	case LiveStep:
+		writer.Key("mashStep");
+		writer.Int(this->currentMashStep);
+		writer.Key("targetTemp");
+		writer.Tenths((int)(this->targetTemperature * 10));
+
+		writer.Key("manualOverrideTargetTemp");
+		if (this->overrideTargetTemperature.has_value())
+		{
+			writer.Float(this->overrideTargetTemperature.value());
+		}
+		else
+		{
+			writer.Null();
+		}
+
+		writer.Key("runningVersion");
+		writer.Int(this->runningVersion);
+		break;
+	default:
+		break;
+	}
+}
+
+void BrewEngine::liveFields(JsonWriter &writer)
+{
+	for (uint8_t group = 0; group < LiveGroupCount; group++)
+	{
+		this->liveGroup(writer, (LiveGroup)group);
+	}
+}
+
+// renders every group, changed tells which ones differ from the last update, true when any does
+bool BrewEngine::updateLive(LiveGroups &live, bool *changed)
+{
+	bool any = false;
+	for (uint8_t group = 0; group < LiveGroupCount; group++)
+	{
+		changed[group] = live.Update(group, [this, group](JsonWriter &writer)
+									 { this->liveGroup(writer, (LiveGroup)group); });
+		any = any || changed[group];
+	}
+	return any;
+}
+
+// rows of the history the request asks for, sensorMutex is only taken to copy a batch so the callback can write to a client
+// returns the cursor for the next request, rows logged while we read are left for that one
+uint32_t BrewEngine::readHistory(const json &data, const vector<string> &channels, const std::function<void(uint32_t seq, time_t time, const int16_t *values)> &callback)
+{
+	// clients keep the cursor we give them, so they only get new samples
+	uint32_t cursor = 0;
+	if (data.contains("cursor") && data["cursor"].is_number())
+	{
+		cursor = data["cursor"].get<uint32_t>();
+	}
+
+	// time range in seconds since epoch, older clients send the time of their last sample
+	time_t from = 0;
+	time_t to = std::numeric_limits<time_t>::max();
+	if (data.contains("from") && data["from"].is_number())
+	{
+		from = data["from"].get<time_t>();
+	}
+	if (data.contains("to") && data["to"].is_number())
+	{
+		to = data["to"].get<time_t>();
+	}
+	if (data.contains("lastDate") && data["lastDate"].is_number())
+	{
+		from = std::max(from, data["lastDate"].get<time_t>() + 1);
+	}
+
+	// the first channel decides which rows are kept, so it needs a value
+	uint32_t maxPoints = 0;
+	if (data.contains("maxPoints") && data["maxPoints"].is_number() && !channels.empty())
+	{
+		maxPoints = std::clamp<uint32_t>(data["maxPoints"].get<uint32_t>(), 3, HISTORY_MAX_POINTS);
+	}
+
+	auto inRange = [from, to, maxPoints](time_t time, const int16_t *values)
+	{
+		return time >= from && time <= to && (maxPoints == 0 || values[0] != TIMESERIES_MISSING);
+	};
+
+	xSemaphoreTake(this->sensorMutex, portMAX_DELAY);
+
+	uint32_t end = this->tempLog.NextSeq();
+
+	// downsampling needs to know how many rows there are, counting doesn't wait on a client so it's done in one go
+	uint32_t total = 0;
+	if (maxPoints > 0)
+	{
+		this->tempLog.Read(cursor, {channels[0]}, [&total, &inRange](time_t time, const int16_t *values)
+						   {
+							   if (inRange(time, values))
+							   {
+								   total++;
+							   } });
+	}
+
+	xSemaphoreGive(this->sensorMutex);
+
+	// without downsampling rows go straight to the callback
+	if (maxPoints == 0)
+	{
+		this->readLog(cursor, end, channels, [&inRange, &callback](uint32_t seq, time_t time, const int16_t *values)
+					  {
+						  if (inRange(time, values))
+						  {
+							  callback(seq, time, values);
+						  } });
+		return end;
+	}
+
+	Downsampler downsampler(total, maxPoints, channels.size(), callback);
+
+	this->readLog(cursor, end, channels, [&downsampler, &inRange](uint32_t seq, time_t time, const int16_t *values)
+				  {
+					  if (inRange(time, values))
+					  {
+						  downsampler.Add(seq, time, values);
+					  } });
+	return end;
+}
+
+// rows from cursor up to end, like exportHistory a batch is copied under sensorMutex and handed to the callback without it
+// rows of a batch follow each other, so the last one is just before the cursor the read returns
+void BrewEngine::readLog(uint32_t cursor, uint32_t end, const vector<string> &channels, const std::function<void(uint32_t seq, time_t time, const int16_t *values)> &callback)
+{
+	vector<int16_t> values(channels.size() * EXPORT_BATCH_ROWS);
+	time_t times[EXPORT_BATCH_ROWS];
+
+	while (cursor < end)
+	{
+		uint32_t rows = 0;
+
+		xSemaphoreTake(this->sensorMutex, portMAX_DELAY);
+		uint32_t next = this->tempLog.Read(cursor, channels, [&](time_t time, const int16_t *rowValues)
+										   {
+											   times[rows] = time;
+											   std::copy(rowValues, rowValues + channels.size(), values.begin() + rows * channels.size());
+											   rows++; }, std::min<uint32_t>(EXPORT_BATCH_ROWS, end - cursor));
+		xSemaphoreGive(this->sensorMutex);
+
+		// when old rows were evicted in between the batch starts later and can go past end
+		for (uint32_t row = 0; row < rows && next - rows + row < end; row++)
+		{
+			callback(next - rows + row, times[row], values.data() + row * channels.size());
+		}
+
+		cursor = next;
+	}
+}
+
+// columnar, time and one array per requested channel, missing values are null
+// every column is a read of its own so no rows are kept, the time column picks the rows and the others are read for the same rows
+// the log is read in batches without holding sensorMutex while we write, rows evicted between two columns are null
+uint32_t BrewEngine::writeHistoryColumns(const json &data, const vector<string> &channels, JsonWriter &writer)
+{
+	vector<string> readChannels(channels.begin(), channels.begin() + std::min<size_t>(channels.size(), 1));
+
+	// the rows we sent, by sequence nr from the first one
+	uint32_t first = 0;
+	vector<bool> picked;
+
+	writer.BeginObject();
+
+	writer.Key("time");
+	writer.BeginArray();
+	uint32_t logCursor = this->readHistory(data, readChannels, [&writer, &first, &picked](uint32_t seq, time_t time, const int16_t *values)
+										   {
+											   if (picked.empty())
+											   {
+												   first = seq;
+											   }
+											   picked.resize(seq - first + 1);
+											   picked[seq - first] = true;
+											   writer.Int(time); });
+	writer.EndArray();
+
+	uint32_t end = first + picked.size();
+
+	for (size_t i = 0; i < channels.size(); i++)
+	{
+		bool temperature = this->temperatureChannel(channels[i]);
+
+		// picked rows we didn't read are gone from the log
+		uint32_t next = first;
+		auto skipTo = [&writer, &picked, &next, first](uint32_t seq)
+		{
+			for (; next < seq; next++)
+			{
+				if (picked[next - first])
+				{
+					writer.Null();
+				}
+			}
+		};
+
+		writer.Key(channels[i]);
+		writer.BeginArray();
+		this->readLog(first, end, {channels[i]}, [&writer, &picked, &next, &skipTo, first, temperature](uint32_t seq, time_t time, const int16_t *values)
+					  {
+						  skipTo(seq);
+						  next = seq + 1;
+
+						  if (!picked[seq - first])
+						  {
+							  return;
+						  }
+
+						  if (values[0] == TIMESERIES_MISSING)
+						  {
+							  writer.Null();
+						  }
+						  else if (temperature)
+						  {
+							  writer.Tenths(values[0]);
+						  }
+						  else
+						  {
+							  writer.Int(values[0]);
+						  } });
+		skipTo(end);
+		writer.EndArray();
+	}
+
+	writer.EndObject();
+
+	return logCursor;
+}
+
+// temperatures are logged in 0.1°, other channels as they are
+bool BrewEngine::temperatureChannel(const string &channel)
+{
+	return channel == "temp" || channel == "target" || (channel.size() > 1 && channel[0] == 's' && isdigit(channel[1]));
+}
+
+vector<string> BrewEngine::historyChannels(const json &jChannels)
+{
+	// names can end with * to get all channels that start with it, like s* for all sensors
+	vector<string> channels;
+	vector<string> known = this->tempLog.Channels();
+
+	for (auto const &jChannel : jChannels)
+	{
+		if (!jChannel.is_string())
+		{
+			continue;
+		}
+
+		string pattern = jChannel.get<string>();
+
+		if (!pattern.empty() && pattern.back() == '*')
+		{
+			string prefix = pattern.substr(0, pattern.size() - 1);
+			for (auto const &name : known)
+			{
+				if (name.starts_with(prefix) && std::find(channels.begin(), channels.end(), name) == channels.end())
+				{
+					channels.push_back(name);
+				}
+			}
+		}
+		else if (std::find(channels.begin(), channels.end(), pattern) == channels.end())
+		{
+			channels.push_back(pattern);
+		}
+	}
+
+	return channels;
+}
+
+json BrewEngine::sensorHealth()
+{
+	json jSensors = json::array({});
+	int64_t now = esp_timer_get_time();
+
+	xSemaphoreTake(this->sensorMutex, portMAX_DELAY);
+
+	for (auto const &[key, sensor] : this->sensors)
+	{
+		json jSensor = sensor->stats.to_json();
+		jSensor["id"] = to_string(key); // js doesn't support uint64_t, so we convert to string
+		jSensor["name"] = sensor->name;
+		jSensor["busId"] = sensor->busId;
+		jSensor["connected"] = sensor->connected;
+
+		// age of the last good sample in ms, null when we never got one
+		if (sensor->lastReadTime > 0)
+		{
+			jSensor["age"] = (now - sensor->lastReadTime) / 1000;
+		}
+		else
+		{
+			jSensor["age"] = nullptr;
+		}
+
+		SensorFilter *filter = this->fusion.Filter(key);
+		jSensor["outliers"] = filter ? filter->outliers : 0;
+
+		jSensors.push_back(jSensor);
+	}
+
+	xSemaphoreGive(this->sensorMutex);
+
+	return jSensors;
+}
+
+// samples and events of a logged session in the same columns as the history, null when the session is gone
+json BrewEngine::brewSession(uint32_t id, uint32_t maxPoints)
+{
+	// the downsampler needs the nr of samples up front
+	uint32_t total = 0;
+	for (auto const &session : this->brewLog.Sessions())
+	{
+		if (session.id == id)
+		{
+			total = session.samples;
+		}
+	}
+
+	json jTimes = json::array({});
+	json jTemps = json::array({});
+	json jTargets = json::array({});
+	json jOutputs = json::array({});
+	json jEvents = json::array({});
+
+	Downsampler downsampler(total, maxPoints, 3, [&](uint32_t seq, time_t time, const int16_t *values)
+							{
+								jTimes.push_back(time);
+								jTemps.push_back((double)values[0] / 10);
+								jTargets.push_back((double)values[1] / 10);
+								jOutputs.push_back(values[2]); });
+
+	// a running session can get samples while we read, the downsampler only expects the ones we counted
+	uint32_t count = 0;
+	bool found = this->brewLog.ReadSession(id, [&downsampler, &count, total](const BrewLog::Sample &sample)
+										   {
+											   if (count < total)
+											   {
+												   int16_t values[3] = {sample.temp, sample.target, sample.output};
+												   downsampler.Add(count++, sample.time, values);
+											   } },
+										   [&jEvents](const BrewLog::Event &event)
+										   { jEvents.push_back({{"time", event.time}, {"message", event.message}}); });
+
+	if (!found)
+	{
+		return nullptr;
+	}
+
+	json jSession;
+	jSession["id"] = id;
+	jSession["history"] = {{"time", jTimes}, {"temp", jTemps}, {"target", jTargets}, {"output", jOutputs}};
+	jSession["events"] = jEvents;
+	return jSession;
+}
+
+void BrewEngine::publishSensorHealth()
+{
+	if (!this->mqttEnabled)
+	{
+		return;
+	}
+
+	// all buses call us, we only need it once in a while
+	int64_t now = esp_timer_get_time();
+	xSemaphoreTake(this->sensorMutex, portMAX_DELAY);
+	if (now - this->lastHealthPublish < SENSOR_HEALTH_INTERVAL)
+	{
+		xSemaphoreGive(this->sensorMutex);
+		return;
+	}
+	this->lastHealthPublish = now;
+	xSemaphoreGive(this->sensorMutex);
+
+	json jPayload;
+	jPayload["time"] = to_iso_8601(system_clock::now());
+	jPayload["sensors"] = this->sensorHealth();
+
+	json jBuses = json::array({});
+	for (auto const &bus : this->temperatureBuses)
+	{
+		jBuses.push_back({{"id", bus->id}, {"sweepTime", bus->lastSweepTime}});
+	}
+	jPayload["buses"] = jBuses;
+
+	string payload = jPayload.dump();
+
+	esp_mqtt_client_publish(this->mqttClient, this->mqttTopicHealth.c_str(), payload.c_str(), 0, 1, 0);
+}
+
+void BrewEngine::pidLoop(void *arg)
+{
+	BrewEngine *instance = (BrewEngine *)arg;
+
+	double kP, kI, kD;
+	if (instance->boilRun)
+	{
+		kP = instance->boilkP;
+		kI = instance->boilkI;
+		kD = instance->boilkD;
+	}
+	else
+	{
+		kP = instance->mashkP;
+		kI = instance->mashkI;
+		kD = instance->mashkD;
+	}
+
+	PIDController pid(kP, kI, kD);
+	pid.setMin(0);
+	pid.setMax(100);
+	pid.debug = false;
+
+	uint totalWattage = 0;
+
+	// we calculate the total wattage we have availible, depens on heaters and on mash or boil
+	for (auto &heater : instance->heaters)
+	{
+
+		if (instance->boilRun && heater->useForBoil)
+		{
+			totalWattage += heater->watt;
+			heater->enabled = true;
+		}
+		else if (!instance->boilRun && heater->useForMash)
+		{
+			totalWattage += heater->watt;
+			heater->enabled = true;
+		}
+		else
+		{
+			heater->enabled = false;
+		}
+	}
+
+	while (instance->run && instance->controlRun)
+	{
+		// Output is %
+		int outputPercent = (int)pid.getOutput((double)instance->temperature, (double)instance->targetTemperature);
+		instance->pidOutput = outputPercent;
+		ESP_LOGI(TAG, "Pid Output: %d Target: %f", instance->pidOutput, instance->targetTemperature);
+
+		// Manual override and boost
+		if (instance->manualOverrideOutput.has_value())
+		{
+			// Here we don't override the pidOutput display since we want the user to see the pid values even when overriding
+			outputPercent = instance->manualOverrideOutput.value();
+		}
+		else if (instance->boostStatus == Boost)
+		{
+			outputPercent = 100;
+			instance->pidOutput = 100;
+		}
+		else if (instance->heaterLimit < outputPercent)
+		{
+			outputPercent = instance->heaterLimit;
+			instance->pidOutput = instance->heaterLimit;
+		}
+		else if (instance->boostStatus == Rest)
+		{
+			outputPercent = 0;
+			instance->pidOutput = 0;
+		}
+
+		// set all to 0
+		for (auto &heater : instance->heaters)
+		{
+			heater->burnTime = 0;
+		}
+
+		// calc the wattage we need
+		int outputWatt = (totalWattage / 100) * outputPercent;
+
+		// we need to calculate our burn time per output
+		for (auto &heater : instance->heaters)
+		{
+			if (!heater->enabled)
+			{
+				continue;
+			}
+
+			if (outputWatt < 0)
+			{
+				break;
+			}
+
+			// we can complete it with this heater
+			if (heater->watt > outputWatt)
+			{
+				heater->burnTime = (int)(((double)outputWatt / (double)heater->watt) * 100);
+				
+				if (heater->burnTime <= instance->relayGuard/2)
+				{
+					heater->burnTime=0;
+				}
+				else if (heater->burnTime <= instance->relayGuard)
+				{
+					heater->burnTime=instance->relayGuard;
+				}
+
+				if (heater->burnTime >= 100 - instance->relayGuard/2)
+				{
+					heater->burnTime=100;
+				}
+				else if (heater->burnTime >= 100 - instance->relayGuard)
+				{
+					heater->burnTime=100 - instance->relayGuard;
+				}
+				
+				ESP_LOGD(TAG, "Pid Calc Heater %s: OutputWatt: %d Burn: %d", heater->name.c_str(), outputWatt, heater->burnTime);
+				break;
+			}
+			else
+			{
+				// we can't complete it, take out part and continue
+				outputWatt -= heater->watt;
+				heater->burnTime = 100;
+				ESP_LOGD(TAG, "Pid Calc Heater %s: OutputWatt: %d Burn: 100", heater->name.c_str(), outputWatt);
+			}
+		}
+
+		// Shorter heater cycles for even temperature and prevent hot spots
+		int heaterLoopTime = instance->pidLoopTime / instance->heaterCycles;
+		
+		// we keep going for the desired pidlooptime and set the burn by percent
+		for (int i = 0; i < instance->pidLoopTime / instance->heaterCycles; i++)
+		{
+			if (!instance->run || !instance->controlRun)
+			{
+				break;
+			}
+
+			for (auto &heater : instance->heaters)
+			{
+				if (!heater->enabled)
+				{
+					continue;
+				}
+
+				int burnUntil = 0;
+
+				if (heater->burnTime > 0)
+				{
+					burnUntil = ((double)heater->burnTime / 100) * (double)instance->pidLoopTime / (double)instance->heaterCycles; // convert % back to seconds (per heater cycle)
+				}
+
+				if (burnUntil > i % heaterLoopTime) // on 
+				{
+					if (heater->burn != true) // only when not current, we don't want to spam the logs
+					{
+						heater->burn = true;
+						ESP_LOGD(TAG, "Heater %s: On", heater->name.c_str());
+					}
+				}
+				else // off
+				{
+					if (heater->burn != false) // only when not current, we don't want to spam the logs
+					{
+						heater->burn = false;
+						ESP_LOGD(TAG, "Heater %s: Off", heater->name.c_str());
+					}
+				}
+			}
+
+			// when our target changes we also update our pid target
+			if (instance->resetPitTime)
+			{
+				ESP_LOGI(TAG, "Reset Pid Timer");
+				instance->resetPitTime = false;
+				break;
+			}
+
+			vTaskDelay(pdMS_TO_TICKS(1000));
+		}
+	}
+
+	instance->pidOutput = 0;
+
+	instance->deleteTask(&instance->pidLoopHandle);
+}
+
+void BrewEngine::outputLoop(void *arg)
+{
+	BrewEngine *instance = (BrewEngine *)arg;
+
+	for (auto const &heater : instance->heaters)
+	{
+		gpio_set_level(heater->pinNr, instance->gpioLow);
+		heater->on = false;
+	}
+
+	int64_t lastTime = esp_timer_get_time();
+
+	while (instance->run && instance->controlRun)
+	{
+		vTaskDelay(pdMS_TO_TICKS(1000));
+
+		// what we set last round was on until now
+		int64_t now = esp_timer_get_time();
+		uint32_t elapsed = (now - lastTime) / 1000;
+		lastTime = now;
+
+		for (auto const &heater : instance->heaters)
+		{
+			if (heater->on)
+			{
+				heater->onTime += elapsed;
+			}
+			heater->on = heater->burn;
+
+			if (heater->burn)
+			{
+				ESP_LOGD(TAG, "Output %s: On", heater->name.c_str());
+				gpio_set_level(heater->pinNr, instance->gpioHigh);
+			}
+			else
+			{
+				ESP_LOGD(TAG, "Output %s: Off", heater->name.c_str());
+				gpio_set_level(heater->pinNr, instance->gpioLow);
+			}
+		}
+	}
+
+	// set outputs off and quit thread
+	for (auto const &heater : instance->heaters)
+	{
+		if (heater->on)
+		{
+			heater->onTime += (esp_timer_get_time() - lastTime) / 1000;
+		}
+		gpio_set_level(heater->pinNr, instance->gpioLow);
+		heater->on = false;
+	}
+
+	instance->deleteTask(&instance->outputLoopHandle);
+}
+
+void BrewEngine::controlLoop(void *arg)
+{
+	BrewEngine *instance = (BrewEngine *)arg;
+
+	// the pid needs to reset one step later so the next temp is set, oherwise it has a delay
+	bool resetPIDNextStep = false;
+
+	uint boostUntil = 0;
+
+	while (instance->run && instance->controlRun)
+	{
+
+		system_clock::time_point now = std::chrono::system_clock::now();
+
+		if (instance->executionSteps.size() >= instance->currentMashStep)
+		{ // there are more steps
+			int nextStepIndex = instance->currentMashStep;
+
+			auto nextStep = instance->executionSteps.at(nextStepIndex);
+
+			system_clock::time_point nextAction = nextStep->time;
+
+			bool gotoNextStep = false;
+
+			// set target when not overriden
+			if (instance->overrideTargetTemperature.has_value())
+			{
+				instance->targetTemperature = instance->overrideTargetTemperature.value();
+			}
+			else
+			{
+				instance->targetTemperature = nextStep->temperature;
+			}
+
+			uint secondsToGo = 0;
+			// if its smaller 0 is ok!
+			if (nextAction > now)
+			{
+				secondsToGo = chrono::duration_cast<chrono::seconds>(nextAction - now).count();
+			}
+
+			// Boost mode logic
+			if (nextStep->allowBoost)
+			{
+				if (boostUntil == 0)
+				{
+					boostUntil = (uint)((nextStep->temperature / 100) * (float)instance->boostModeUntil);
+				}
+
+				if (instance->boostStatus == Off && instance->temperature < boostUntil)
+				{
+
+					ESP_LOGI(TAG, "Boost Start Until: %d", boostUntil);
+					instance->logEvent("Boost Start");
+					instance->boostStatus = Boost;
+				}
+				else if (instance->boostStatus == Boost && instance->temperature >= boostUntil)
+				{
+					// When in boost mode we wait unit boost temp is reched, pid is locked to 100% in boost mode
+					ESP_LOGI(TAG, "Boost Rest Start");
+					instance->logEvent("Boost Rest Start");
+					instance->boostStatus = Rest;
+				}
+				else if (instance->boostStatus == Rest && instance->temperatureRate < 0)
+				{
+					// When in boost rest mode, we wait until temperature drops pid is locked to 0%
+					ESP_LOGI(TAG, "Boost Rest End");
+					instance->logEvent("Boost Rest End");
+					instance->boostStatus = Off;
+
+					// Reset pid
+					instance->resetPitTime = true;
+				}
+			}
+
+			if (secondsToGo < 1)
+			{ // change temp and increment Currentstep
+
+				// string iso_string = instance->to_iso_8601(nextStep->time);
+				// ESP_LOGI(TAG, "Control Time:%s, TempCur:%f, TempTarget:%d, Extend:%d, Overtime: %d", iso_string.c_str(), instance->temperature, nextStep->temperature, nextStep->extendIfNeeded, instance->inOverTime);
+
+				if (nextStep->extendIfNeeded == true && instance->inOverTime == false && (nextStep->temperature - instance->temperature) >= instance->tempMargin)
+				{
+					// temp must be reached, we keep going but need to triger a recaluclation event when done
+					ESP_LOGI(TAG, "OverTime Start");
+					instance->logEvent("OverTime Start");
+					instance->inOverTime = true;
+				}
+				else if (instance->inOverTime == true && (nextStep->temperature - instance->temperature) <= instance->tempMargin)
+				{
+					// we reached out temp after overtime, we need to recalc the rest and start going again
+					ESP_LOGI(TAG, "OverTime Done");
+					instance->logEvent("OverTime Done");
+					instance->inOverTime = false;
+					instance->recalculateScheduleAfterOverTime();
+					gotoNextStep = true;
+				}
+				else if (instance->inOverTime == false)
+				{
+					ESP_LOGI(TAG, "Going to next Step");
+					instance->logEvent("Step " + to_string(instance->currentMashStep));
+					gotoNextStep = true;
+					// also reset override on step change
+					instance->overrideTargetTemperature = std::nullopt;
+				}
+
+				// else when in overtime just keep going until we reach temp
+			}
+
+			// the pid needs to reset one step later so the next temp is set, oherwise it has a delay
+			if (resetPIDNextStep)
+			{
+				resetPIDNextStep = false;
+				instance->resetPitTime = true;
+			}
+
+			if (gotoNextStep)
+			{
+				instance->currentMashStep++;
+
+				// Also reset boost
+				instance->boostStatus = Off;
+
+				resetPIDNextStep = true;
+			}
+
+			// notifications, but only when not in overtime
+			if (!instance->inOverTime && !instance->notifications.empty())
+			{
+				// filter out items that are not done
+				auto isNotDone = [](Notification *notification)
+				{ return notification->done == false; };
+
+				auto notDone = instance->notifications | views::filter(isNotDone);
+
+				if (!notDone.empty())
+				{
+					// they are sorted so we just have to check the first one
+					auto first = notDone.front();
+
+					if (now > first->timePoint)
+					{
+						ESP_LOGI(TAG, "Notify %s", first->name.c_str());
+						instance->logEvent("Notify " + first->name);
+
+						string buzzerName = "buzzer" + first->name;
+						xTaskCreate(&instance->buzzer, buzzerName.c_str(), 1024, instance, 10, NULL);
+
+						first->done = true;
+					}
+				}
+			}
+		}
+		else
+		{
+			// last step need to stop
+			ESP_LOGI(TAG, "Program Finished");
+			instance->logEvent("Program Finished");
+			instance->stop();
+		}
+
+		// checkpoint on every change and once a minute, so a resume knows the downtime
+		if (instance->controlRun)
+		{
+			instance->saveRunState(false);
+		}
+
+		vTaskDelay(pdMS_TO_TICKS(1000));
+	}
+
+	instance->deleteTask(&instance->controlLoopHandle);
+}
+
+// sends what changed to the websocket clients, one serialization for all of them
+// groups are compared as text and the payload is written straight into a string we keep, so a push allocates nothing
+void BrewEngine::pushLoop(void *arg)
+{
+	BrewEngine *instance = (BrewEngine *)arg;
+
+	LiveGroups live(LiveGroupCount);
+	bool changed[LiveGroupCount];
+	json jHistoryRequest = {{"cursor", 0}};
+	uint32_t pushCursor = 0;
+	string payload;
+	char buffer[256];
+
+	while (instance->run)
+	{
+		// woken after every sample, other changes are picked up by the timeout
+		ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(LIVE_PUSH_INTERVAL));
+
+		vector<int> clients = instance->liveClients();
+
+		xSemaphoreTake(instance->liveMutex, portMAX_DELAY);
+		bool streams = !instance->eventClients.empty();
+		// without clients nothing is waiting for the frame anymore, also not when the server was stopped with it queued
+		if (clients.empty())
+		{
+			instance->liveQueued = false;
+		}
+		bool queued = instance->liveQueued;
+		xSemaphoreGive(instance->liveMutex);
+
+		// the last frame is not sent yet, what changed since then goes with the next push so no group is lost
+		if (queued)
+		{
+			continue;
+		}
+
+		if (clients.empty() && !streams)
+		{
+			// the next client gets everything in its first frame, history it gets with the Data command
+			live.Reset();
+			xSemaphoreTake(instance->sensorMutex, portMAX_DELAY);
+			pushCursor = instance->tempLog.NextSeq();
+			xSemaphoreGive(instance->sensorMutex);
+			continue;
+		}
+
+		bool anyChanged = instance->updateLive(live, changed);
+
+		instance->sendEvents(live, changed);
+
+		if (clients.empty())
+		{
+			xSemaphoreTake(instance->sensorMutex, portMAX_DELAY);
+			pushCursor = instance->tempLog.NextSeq();
+			xSemaphoreGive(instance->sensorMutex);
+			continue;
+		}
+
+		payload.clear();
+		JsonWriter writer(buffer, sizeof(buffer), [&payload](const char *data, size_t length)
+						  {
+							  payload.append(data, length);
+							  return ESP_OK; });
+		writer.BeginObject();
+
+		for (uint8_t group = 0; group < LiveGroupCount; group++)
+		{
+			if (changed[group])
+			{
+				instance->liveGroup(writer, (LiveGroup)group);
+			}
+		}
+
+		// new rows in the same columns the web asks for, fromCursor lets a client see if it missed rows
+		vector<string> channels;
+		time_t lastLogTime = 0;
+
+		xSemaphoreTake(instance->sensorMutex, portMAX_DELAY);
+		bool history = instance->tempLog.NextSeq() > pushCursor;
+		if (history)
+		{
+			channels = instance->historyChannels({"temp", "s*"});
+			lastLogTime = instance->tempLog.LastTime();
+		}
+		xSemaphoreGive(instance->sensorMutex);
+
+		if (history)
+		{
+			writer.Key("fromCursor");
+			writer.Int(pushCursor);
+			writer.Key("history");
+			jHistoryRequest["cursor"] = pushCursor;
+			pushCursor = instance->writeHistoryColumns(jHistoryRequest, channels, writer);
+			writer.Key("logCursor");
+			writer.Int(pushCursor);
+			writer.Key("lastLogDateTime");
+			writer.Int(lastLogTime);
+		}
+
+		writer.EndObject();
+		writer.Finish();
+
+		if (!anyChanged && !history)
+		{
+			continue;
+		}
+
+		// the server task sends it, so a client that closes can't be torn down while we write to it
+		// swapped, both strings keep their capacity
+		xSemaphoreTake(instance->liveMutex, portMAX_DELAY);
+		instance->livePayload.swap(payload);
+		instance->liveQueued = httpd_queue_work(instance->server, &instance->sendLive, instance) == ESP_OK;
+		xSemaphoreGive(instance->liveMutex);
+	}
+
+	instance->deleteTask(&instance->pushLoopHandle);
+}
+
+// runs in the http server task, sends the queued frame to the websocket clients that are connected now
+void BrewEngine::sendLive(void *arg)
+{
+	BrewEngine *instance = (BrewEngine *)arg;
+
+	xSemaphoreTake(instance->liveMutex, portMAX_DELAY);
+
+	if (instance->liveQueued)
+	{
+		httpd_ws_frame_t frame = {};
+		frame.type = HTTPD_WS_TYPE_TEXT;
+		frame.payload = (uint8_t *)instance->livePayload.data();
+		frame.len = instance->livePayload.size();
+
+		for (int fd : instance->liveClients())
+		{
+			httpd_ws_send_frame_async(instance->server, fd, &frame);
+		}
+
+		instance->liveQueued = false;
+	}
+
+	xSemaphoreGive(instance->liveMutex);
+}
+
+// server sent events, one event per group that changed with the current values of that group
+void BrewEngine::formatEvents(string &events, LiveGroups &live, const bool *changed)
+{
+	static const char *names[LiveGroupCount] = {"temperature", "output", "status", "step"};
+
+	for (uint8_t group = 0; group < LiveGroupCount; group++)
+	{
+		if (changed[group])
+		{
+			events += "event: ";
+			events += names[group];
+			events += "\ndata: ";
+			events += live.Text(group);
+			events += "\n\n";
+		}
+	}
+}
+
+// the events are formatted once and sent to every client, clients that fail are closed
+void BrewEngine::sendEvents(LiveGroups &live, const bool *changed)
+{
+	xSemaphoreTake(this->liveMutex, portMAX_DELAY);
+
+	if (this->eventClients.empty())
+	{
+		xSemaphoreGive(this->liveMutex);
+		return;
+	}
+
+	// kept, so it doesn't need to grow again every push
+	this->events.clear();
+	formatEvents(this->events, live, changed);
+
+	// a comment keeps proxies from closing the stream and lets us notice clients that are gone
+	int64_t now = esp_timer_get_time();
+	if (this->events.empty() && now - this->lastEventTime >= EVENTS_KEEPALIVE_INTERVAL)
+	{
+		this->events = ": keepalive\n\n";
+	}
+
+	if (!this->events.empty())
+	{
+		this->lastEventTime = now;
+
+		for (auto it = this->eventClients.begin(); it != this->eventClients.end();)
+		{
+			if (httpd_resp_send_chunk(*it, this->events.data(), this->events.size()) != ESP_OK)
+			{
+				httpd_req_async_handler_complete(*it);
+				it = this->eventClients.erase(it);
+			}
+			else
+			{
+				++it;
+			}
+		}
+	}
+
+	xSemaphoreGive(this->liveMutex);
+}
+
+// sockets of the connected websocket clients
+vector<int> BrewEngine::liveClients()
+{
+	vector<int> clients;
+	if (this->server == NULL)
+	{
+		return clients;
+	}
+
+	size_t count = LIVE_MAX_CLIENTS;
+	int fds[LIVE_MAX_CLIENTS];
+	if (httpd_get_client_list(this->server, &count, fds) != ESP_OK)
+	{
+		return clients;
+	}
+
+	for (size_t i = 0; i < count; i++)
+	{
+		if (httpd_ws_get_fd_info(this->server, fds[i]) == HTTPD_WS_CLIENT_WEBSOCKET)
+		{
+			clients.push_back(fds[i]);
+		}
+	}
+
+	return clients;
+}
+
+string BrewEngine::bootIntoRecovery()
+{
+	// recovery is our factory
+	esp_partition_subtype_t t = ESP_PARTITION_SUBTYPE_APP_FACTORY;
+	const esp_partition_t *factory_partition = esp_partition_find_first(ESP_PARTITION_TYPE_APP, t, NULL);
+
+	if (factory_partition == NULL)
+	{
+		ESP_LOGE(TAG, "Factory Partition not found!");
+		return "Error: Factory Partition not found!";
+	}
+
+	if (esp_ota_set_boot_partition(factory_partition) == ESP_OK)
+	{
+		return "Device is booting into recovery hold on!";
+	}
+
+	return "Error: Unable to chage boot Partition!";
+}
+
+void BrewEngine::reboot(void *arg)
+{
+	vTaskDelay(2000 / portTICK_PERIOD_MS);
+	esp_restart();
+}
+
+void BrewEngine::buzzer(void *arg)
+{
+	BrewEngine *instance = (BrewEngine *)arg;
+
+	if (instance->buzzer_PIN > 0)
+	{
+		auto buzzerMs = instance->buzzerTime * 1000;
+		gpio_set_level(instance->buzzer_PIN, instance->gpioHigh);
+		vTaskDelay(buzzerMs / portTICK_PERIOD_MS);
+		gpio_set_level(instance->buzzer_PIN, instance->gpioLow);
+	}
+
+	vTaskDelete(NULL);
+}
+
+// the most frequent command, so it is written straight to the response without building json
+void BrewEngine::streamData(json &data, JsonWriter &writer)
+{
+	// buses are read in parallel, the slowest one is our sweep time
+	uint32_t sweepTime = 0;
+	for (auto const &bus : this->temperatureBuses)
+	{
+		sweepTime = std::max(sweepTime, bus->lastSweepTime);
+	}
+
+	writer.BeginObject();
+
+	this->liveFields(writer);
+
+	writer.Key("sweepTime");
+	writer.Int(sweepTime);
+	writer.Key("tempTime");
+	writer.Int(duration_cast<milliseconds>(this->lastSampleTime.time_since_epoch()).count());
+
+	// what we need of the log is copied, the history is read in batches, so a slow client doesn't hold up the sensors
+	bool columns = data.contains("channels") && data["channels"].is_array();
+	vector<string> channels;
+
+	xSemaphoreTake(this->sensorMutex, portMAX_DELAY);
+	time_t lastLogTime = this->tempLog.Empty() ? time(0) : this->tempLog.LastTime();
+	vector<string> logChannels = this->tempLog.Channels();
+	if (columns)
+	{
+		channels = this->historyChannels(data["channels"]);
+	}
+	xSemaphoreGive(this->sensorMutex);
+
+	writer.Key("lastLogDateTime");
+	writer.Int(lastLogTime);
+
+	uint32_t logCursor;
+
+	if (columns)
+	{
+		writer.Key("history");
+		logCursor = this->writeHistoryColumns(data, channels, writer);
+
+		writer.Key("tempLog");
+		writer.BeginArray();
+		writer.EndArray();
+	}
+	else
+	{
+		static const vector<string> tempChannels = {"temp"};
+
+		writer.Key("tempLog");
+		writer.BeginArray();
+		logCursor = this->readHistory(data, tempChannels, [&writer](uint32_t seq, time_t time, const int16_t *values)
+									  {
+										  if (values[0] != TIMESERIES_MISSING)
+										  {
+											  writer.BeginObject();
+											  writer.Key("time");
+											  writer.Int(time);
+											  writer.Key("temp");
+											  writer.Tenths(values[0]);
+											  writer.EndObject();
+										  } });
+		writer.EndArray();
+
+		writer.Key("history");
+		writer.Null();
+	}
+
+	writer.Key("logCursor");
+	writer.Int(logCursor);
+
+	writer.Key("historyChannels");
+	writer.BeginArray();
+	for (auto const &channel : logChannels)
+	{
+		writer.String(channel);
+	}
+	writer.EndArray();
+
+	writer.EndObject();
+}
+
+void BrewEngine::commandGetRunningSchedule(json &data, CommandResult &result)
+{
+	json jRunningSchedule;
+	jRunningSchedule["version"] = this->runningVersion;
+
+	json jExecutionSteps = json::array({});
+	for (auto const &[key, val] : this->executionSteps)
+	{
+		json jExecutionStep = val->to_json();
+		jExecutionSteps.push_back(jExecutionStep);
+	}
+	jRunningSchedule["steps"] = jExecutionSteps;
+
+	json jNotifications = json::array({});
+	for (auto &notification : this->notifications)
+	{
+		json jNotification = notification->to_json();
+		jNotifications.push_back(jNotification);
+	}
+	jRunningSchedule["notifications"] = jNotifications;
+
+	result.data = jRunningSchedule;
+}
+
+void BrewEngine::commandSetTemp(json &data, CommandResult &result)
+{
+	if (!checkData(JsonCheck(data), result))
+	{
+		return;
+	}
+
+	if (data["targetTemp"].is_null())
+	{
+		this->overrideTargetTemperature = std::nullopt;
+
+		// when not in a program also direclty set targtetemp
+		if (this->selectedMashScheduleName.empty() == true)
+		{
+			this->targetTemperature = 0;
+		}
+	}
+	else if (data["targetTemp"].is_number())
+	{
+
+		this->overrideTargetTemperature = (float)data["targetTemp"];
+
+		// when not in a program also direclty set targtetemp
+		if (this->selectedMashScheduleName.empty() == true)
+		{
+			this->targetTemperature = this->overrideTargetTemperature.value();
+		}
+	}
+	else
+	{
+		this->overrideTargetTemperature = std::nullopt;
+
+		result.message = "Incorrect data, integer or float expected!";
+		result.success = false;
+	}
+}
+
+void BrewEngine::commandSetOverrideOutput(json &data, CommandResult &result)
+{
+	if (!checkData(JsonCheck(data), result))
+	{
+		return;
+	}
+
+	if (data["output"].is_null() == false && data["output"].is_number())
+	{
+		this->manualOverrideOutput = (int)data["output"];
+	}
+	else
+	{
+		this->manualOverrideOutput = std::nullopt;
+	}
+
+	// reset so effect is immidiate
+	this->resetPitTime = true;
+}
+
+void BrewEngine::commandStart(json &data, CommandResult &result)
+{
+	if (!checkData(JsonCheck(data).String("selectedMashSchedule", false), result))
+	{
+		return;
+	}
+
+	string scheduleName;
+	if (!data["selectedMashSchedule"].is_null())
+	{
+		scheduleName = (string)data["selectedMashSchedule"];
+	}
+
+	this->start(scheduleName);
+}
+
+void BrewEngine::commandStartStir(json &data, CommandResult &result)
+{
+	if (!checkData(JsonCheck(data), result))
+	{
+		return;
+	}
+
+	this->startStir(data);
+}
+
+void BrewEngine::commandStop(json &data, CommandResult &result)
+{
+	this->stop();
+}
+
+void BrewEngine::commandStopStir(json &data, CommandResult &result)
+{
+	this->stopStir();
+}
+
+void BrewEngine::commandGetMashSchedules(json &data, CommandResult &result)
+{
+	json jSchedules = json::array({});
+
+	for (auto const &[key, val] : this->mashSchedules)
+	{
+		json jSchedule = val->to_json();
+		jSchedules.push_back(jSchedule);
+	}
+
+	result.data = jSchedules;
+}
+
+void BrewEngine::commandSaveMashSchedule(json &data, CommandResult &result)
+{
+	if (!checkData(MashSchedule::check_json(data), result))
+	{
+		return;
+	}
+
+	this->setMashSchedule(data);
+
+	this->saveMashSchedules();
+}
+
+// used by import function to set but not save
+void BrewEngine::commandSetMashSchedule(json &data, CommandResult &result)
+{
+	if (!checkData(MashSchedule::check_json(data), result))
+	{
+		return;
+	}
+
+	this->setMashSchedule(data);
+}
+
+void BrewEngine::commandDeleteMashSchedule(json &data, CommandResult &result)
+{
+	if (!checkData(JsonCheck(data).String("name"), result))
+	{
+		return;
+	}
+
+	string deleteName = (string)data["name"];
+
+	auto pos = this->mashSchedules.find(deleteName);
+
+	if (pos == this->mashSchedules.end())
+	{
+		result.message = "Schedule with name: " + deleteName + " not found";
+		result.success = false;
+	}
+	else
+	{
+		this->mashSchedules.erase(pos);
+		this->saveMashSchedules();
+	}
+}
+
+void BrewEngine::commandGetPIDSettings(json &data, CommandResult &result)
+{
+	result.data = {
+		{"kP", this->mashkP},
+		{"kI", this->mashkI},
+		{"kD", this->mashkD},
+		{"boilkP", this->boilkP},
+		{"boilkI", this->boilkI},
+		{"boilkD", this->boilkD},
+		{"pidLoopTime", this->pidLoopTime},
+		{"stepInterval", this->stepInterval},
+		{"boostModeUntil", this->boostModeUntil},
+		{"heaterLimit", this->heaterLimit},
+		{"heaterCycles", this->heaterCycles},
+		{"relayGuard", this->relayGuard},
+	};
+}
+
+void BrewEngine::commandSavePIDSettings(json &data, CommandResult &result)
+{
+	JsonCheck check = JsonCheck(data).Number("kP").Number("kI").Number("kD").Number("boilkP").Number("boilkI").Number("boilkD");
+	check.Number("pidLoopTime").Number("stepInterval").Number("boostModeUntil").Number("heaterLimit").Number("heaterCycles").Number("relayGuard");
+	if (!checkData(check, result))
+	{
+		return;
+	}
+
+	this->mashkP = data["kP"].get<double>();
+	this->mashkI = data["kI"].get<double>();
+	this->mashkD = data["kD"].get<double>();
+	this->boilkP = data["boilkP"].get<double>();
+	this->boilkI = data["boilkI"].get<double>();
+	this->boilkD = data["boilkD"].get<double>();
+	this->pidLoopTime = data["pidLoopTime"].get<uint16_t>();
+	this->stepInterval = data["stepInterval"].get<uint16_t>();
+	this->boostModeUntil = data["boostModeUntil"].get<uint8_t>();
+	this->heaterLimit = data["heaterLimit"].get<uint8_t>();
+	this->heaterCycles = data["heaterCycles"].get<uint8_t>();
+	this->relayGuard = data["relayGuard"].get<uint8_t>();
+	this->savePIDSettings();
+}
+
+void BrewEngine::commandGetTempSettings(json &data, CommandResult &result)
+{
+	// Convert sensors to json
+	json jSensors = json::array({});
+
+	for (auto const &[key, val] : this->sensors)
+	{
+		json jSensor = val->to_json();
+		jSensors.push_back(jSensor);
+	}
+
+	result.data = jSensors;
+}
+
+void BrewEngine::commandSaveTempSettings(json &data, CommandResult &result)
+{
+	if (!checkData(JsonCheck::Items(data, TemperatureSensor::check_json), result))
+	{
+		return;
+	}
+
+	this->saveTempSensorSettings(data);
+}
+
+void BrewEngine::commandDetectTempSensors(json &data, CommandResult &result)
+{
+	this->detectOnewireTemperatureSensors();
+}
+
+void BrewEngine::commandGetSensorHealth(json &data, CommandResult &result)
+{
+	result.data = this->sensorHealth();
+}
+
+void BrewEngine::commandGetApiStats(json &data, CommandResult &result)
+{
+	auto commands = BrewEngine::commands();
+
+	result.data = json::array({});
+	for (size_t i = 0; i < commands.size(); i++)
+	{
+		const CommandStats &stats = this->commandStats[i];
+		result.data.push_back({
+			{"command", string(commands[i].name)},
+			{"calls", stats.calls},
+			{"avgTime", stats.calls > 0 ? stats.totalTime / stats.calls : 0},
+			{"maxTime", stats.maxTime},
+			{"totalTime", stats.totalTime},
+			{"avgSize", stats.calls > 0 ? stats.totalSize / stats.calls : 0},
+			{"maxSize", stats.maxSize},
+		});
+	}
+}
+
+void BrewEngine::commandGetBrewSessions(json &data, CommandResult &result)
+{
+	json jSessions = json::array({});
+	for (auto const &session : this->brewLog.Sessions())
+	{
+		jSessions.push_back({
+			{"id", session.id},
+			{"name", session.name},
+			{"start", session.start},
+			{"end", session.end},
+			{"complete", session.complete},
+			{"samples", session.samples},
+			{"events", session.events},
+		});
+	}
+	result.data = jSessions;
+}
+
+void BrewEngine::commandGetBrewSession(json &data, CommandResult &result)
+{
+	if (!data.contains("id") || !data["id"].is_number())
+	{
+		result.message = "Session id is required";
+		result.success = false;
+	}
+	else
+	{
+		uint32_t maxPoints = 0;
+		if (data.contains("maxPoints") && data["maxPoints"].is_number())
+		{
+			maxPoints = std::clamp<uint32_t>(data["maxPoints"].get<uint32_t>(), 3, HISTORY_MAX_POINTS);
+		}
+
+		result.data = this->brewSession(data["id"].get<uint32_t>(), maxPoints);
+		if (result.data.is_null())
+		{
+			result.message = "Session not found";
+			result.success = false;
+		}
+	}
+}
+
+void BrewEngine::commandGetHeaterSettings(json &data, CommandResult &result)
+{
+	// Convert heaters to json
+	json jHeaters = json::array({});
+
+	for (auto const &heater : this->heaters)
+	{
+		json jHeater = heater->to_json();
+		jHeaters.push_back(jHeater);
+	}
+
+	result.data = jHeaters;
+}
+
+void BrewEngine::commandSaveHeaterSettings(json &data, CommandResult &result)
+{
+	if (this->controlRun)
+	{
+		result.message = "You cannot save heater settings while running!";
+		result.success = false;
+	}
+	else if (checkData(JsonCheck::Items(data, Heater::check_json), result))
+	{
+		this->saveHeaterSettings(data);
+	}
+}
+
+void BrewEngine::commandGetWifiSettings(json &data, CommandResult &result)
+{
+	// get data from wifi-connect
+	if (this->GetWifiSettingsJson)
+	{
+		result.data = this->GetWifiSettingsJson();
+	}
+}
+
+void BrewEngine::commandSaveWifiSettings(json &data, CommandResult &result)
+{
+	if (!checkData(JsonCheck(data), result))
+	{
+		return;
+	}
+
+	// save via wifi-connect
+	if (this->SaveWifiSettingsJson)
+	{
+		this->SaveWifiSettingsJson(data);
+	}
+	result.message = "Please restart device for changes to have effect!";
+}
+
+void BrewEngine::commandScanWifi(json &data, CommandResult &result)
+{
+	// scans for networks
+	if (this->ScanWifiJson)
+	{
+		result.data = this->ScanWifiJson();
+	}
+}
+
+void BrewEngine::commandGetSystemSettings(json &data, CommandResult &result)
+{
+	json jBuses = json::array({});
+	for (auto const &bus : this->temperatureBuses)
+	{
+		json jBus = bus->to_json();
+		jBus["sweepTime"] = bus->lastSweepTime;
+		jBuses.push_back(jBus);
+	}
+
+	result.data = {
+		{"onewireBuses", jBuses},
+		{"stirPin", this->stir_PIN},
+		{"buzzerPin", this->buzzer_PIN},
+		{"buzzerTime", this->buzzerTime},
+		{"tempReadInterval", this->tempReadInterval},
+		{"invertOutputs", this->invertOutputs},
+		{"mqttUri", this->mqttUri},
+		{"temperatureScale", this->temperatureScale},
+	};
+}
+
+void BrewEngine::commandSaveSystemSettings(json &data, CommandResult &result)
+{
+	if (!checkData(JsonCheck(data), result))
+	{
+		return;
+	}
+
+	this->saveSystemSettingsJson(data);
+	result.message = "Please restart device for changes to have effect!";
+}
+
+void BrewEngine::commandReboot(json &data, CommandResult &result)
+{
+	xTaskCreate(&this->reboot, "reboot_task", 1024, this, 5, NULL);
+}
+
+void BrewEngine::commandFactoryReset(json &data, CommandResult &result)
+{
+	this->settingsManager->FactoryReset();
+	result.message = "Device will restart shortly, reconnect to factory wifi settings to continue!";
+	xTaskCreate(&this->reboot, "reboot_task", 1024, this, 5, NULL);
+}
+
+void BrewEngine::commandBootIntoRecovery(json &data, CommandResult &result)
+{
+	result.message = this->bootIntoRecovery();
+
+	if (result.message.find("Error") != std::string::npos)
+	{
+		result.success = false;
+	}
+	else
+	{
+		xTaskCreate(&this->reboot, "reboot_task", 1024, this, 5, NULL);
+	}
+}
+
+// sorted by name, processCommand finds a command with a binary search
+std::span<const BrewEngine::Command> BrewEngine::commands()
+{
+	static constexpr std::array<Command, 31> commands = {{
+		{"BootIntoRecovery", &BrewEngine::commandBootIntoRecovery},
+		{"Data", NULL, &BrewEngine::streamData},
+		{"DeleteMashSchedule", &BrewEngine::commandDeleteMashSchedule},
+		{"DetectTempSensors", &BrewEngine::commandDetectTempSensors},
+		{"FactoryReset", &BrewEngine::commandFactoryReset},
+		{"GetApiStats", &BrewEngine::commandGetApiStats},
+		{"GetBrewSession", &BrewEngine::commandGetBrewSession},
+		{"GetBrewSessions", &BrewEngine::commandGetBrewSessions},
+		{"GetHeaterSettings", &BrewEngine::commandGetHeaterSettings},
+		{"GetMashSchedules", &BrewEngine::commandGetMashSchedules},
+		{"GetPIDSettings", &BrewEngine::commandGetPIDSettings},
+		{"GetRunningSchedule", &BrewEngine::commandGetRunningSchedule},
+		{"GetSensorHealth", &BrewEngine::commandGetSensorHealth},
+		{"GetSystemSettings", &BrewEngine::commandGetSystemSettings},
+		{"GetTempSettings", &BrewEngine::commandGetTempSettings},
+		{"GetWifiSettings", &BrewEngine::commandGetWifiSettings},
+		{"Reboot", &BrewEngine::commandReboot},
+		{"SaveHeaterSettings", &BrewEngine::commandSaveHeaterSettings},
+		{"SaveMashSchedule", &BrewEngine::commandSaveMashSchedule},
+		{"SavePIDSettings", &BrewEngine::commandSavePIDSettings},
+		{"SaveSystemSettings", &BrewEngine::commandSaveSystemSettings},
+		{"SaveTempSettings", &BrewEngine::commandSaveTempSettings},
+		{"SaveWifiSettings", &BrewEngine::commandSaveWifiSettings},
+		{"ScanWifi", &BrewEngine::commandScanWifi},
+		{"SetMashSchedule", &BrewEngine::commandSetMashSchedule},
+		{"SetOverrideOutput", &BrewEngine::commandSetOverrideOutput},
+		{"SetTemp", &BrewEngine::commandSetTemp},
+		{"Start", &BrewEngine::commandStart},
+		{"StartStir", &BrewEngine::commandStartStir},
+		{"Stop", &BrewEngine::commandStop},
+		{"StopStir", &BrewEngine::commandStopStir},
+	}};
+	static_assert(std::ranges::is_sorted(commands, {}, &Command::name), "commands must be sorted by name");
+
+	return commands;
+}
+
+// jCommand is an object with a command string, the api handler checked it with validCommand
+void BrewEngine::processCommand(json &jCommand, JsonWriter &writer)
+{
+	int64_t startTime = esp_timer_get_time();
+
+	string command = jCommand["command"].get<string>();
+	json &data = jCommand["data"];
+
+	// commands without data get an empty object, so they can be checked like the others
+	if (data.is_null())
+	{
+		data = json::object();
+	}
+
+	ESP_LOGD(TAG, "processCommand %s", command.c_str());
+	ESP_LOGD(TAG, "data %s", data.dump().c_str());
+
+	auto commands = BrewEngine::commands();
+	auto found = std::ranges::lower_bound(commands, std::string_view(command), {}, &Command::name);
+	bool known = found != commands.end() && found->name == command;
+
+	size_t startSize = writer.Size();
+
+	if (known && found->stream != NULL)
+	{
+		writer.BeginObject();
+		writer.Key("data");
+		(this->*found->stream)(data, writer);
+		writer.Key("success");
+		writer.Bool(true);
+		writer.EndObject();
+	}
+	else
+	{
+		CommandResult result;
+
+		if (known)
+		{
+			(this->*found->handler)(data, result);
+		}
+		else
+		{
+			result.message = "Unknown command: " + command;
+			result.success = false;
+		}
+
+		json jResultPayload;
+		jResultPayload["data"] = result.data;
+		jResultPayload["success"] = result.success;
+
+		if (result.message != "")
+		{
+			jResultPayload["message"] = result.message;
+		}
+
+		writeJson(jResultPayload, writer);
+	}
+
+	// time includes formatting and sending, that is what a client waits for
+	if (known)
+	{
+		CommandStats &stats = this->commandStats[found - commands.begin()];
+		uint32_t time = (uint32_t)(esp_timer_get_time() - startTime);
+		uint32_t size = writer.Size() - startSize;
+		stats.calls++;
+		stats.totalTime += time;
+		stats.maxTime = std::max(stats.maxTime, time);
+		stats.totalSize += size;
+		stats.maxSize = std::max(stats.maxSize, size);
+	}
+}
+
+httpd_handle_t BrewEngine::startWebserver(void)
+{
+
+	httpd_uri_t postUri = {};
+	postUri.uri = "/api";
+	postUri.method = HTTP_POST;
+	postUri.handler = this->apiPostHandler;
+
+	httpd_uri_t optionsUri = {};
+	optionsUri.uri = "/api";
+	optionsUri.method = HTTP_OPTIONS;
+	optionsUri.handler = this->apiOptionsHandler;
+
+	httpd_uri_t wsUri = {};
+	wsUri.uri = "/ws";
+	wsUri.method = HTTP_GET;
+	wsUri.handler = this->wsHandler;
+	wsUri.is_websocket = true;
+
+	httpd_uri_t eventsUri = {};
+	eventsUri.uri = "/api/events";
+	eventsUri.method = HTTP_GET;
+	eventsUri.handler = this->eventsGetHandler;
+
+	httpd_uri_t exportUri = {};
+	exportUri.uri = "/api/export";
+	exportUri.method = HTTP_GET;
+	exportUri.handler = this->exportGetHandler;
+
+	httpd_uri_t webUploadUri = {};
+	webUploadUri.uri = "/api/web/*";
+	webUploadUri.method = HTTP_POST;
+	webUploadUri.handler = this->webUploadHandler;
+
+	httpd_uri_t webUploadOptionsUri = {};
+	webUploadOptionsUri.uri = "/api/web/*";
+	webUploadOptionsUri.method = HTTP_OPTIONS;
+	webUploadOptionsUri.handler = this->apiOptionsHandler;
+
+	httpd_uri_t metricsUri = {};
+	metricsUri.uri = "/metrics";
+	metricsUri.method = HTTP_GET;
+	metricsUri.handler = this->metricsGetHandler;
+
+	httpd_uri_t webUri = {};
+	webUri.uri = "/*";
+	webUri.method = HTTP_GET;
+	webUri.handler = this->webGetHandler;
+
+	httpd_handle_t server = NULL;
+	httpd_config_t config = HTTPD_DEFAULT_CONFIG();
+	// whiout this the esp crashed whitout a proper warning
+	config.stack_size = 20480;
+	config.uri_match_fn = httpd_uri_match_wildcard;
+	config.max_uri_handlers = HTTPD_MAX_URI_HANDLERS; // default is 8, we have more
+
+	// Start the httpd server
+	ESP_LOGI(TAG, "Starting server on port: '%d'", config.server_port);
+	if (httpd_start(&server, &config) == ESP_OK)
+	{
+		// Set URI handlers
+		httpd_register_uri_handler(server, &wsUri);
+		httpd_register_uri_handler(server, &eventsUri);
+		httpd_register_uri_handler(server, &exportUri); // before the wildcard
+		httpd_register_uri_handler(server, &metricsUri);
+		httpd_register_uri_handler(server, &webUri);
+		httpd_register_uri_handler(server, &postUri);
+		httpd_register_uri_handler(server, &optionsUri);
+		httpd_register_uri_handler(server, &webUploadUri);
+		httpd_register_uri_handler(server, &webUploadOptionsUri);
+		return server;
+	}
+
+	ESP_LOGI(TAG, "Error starting server!");
+	return NULL;
+}
+
+void BrewEngine::logRemote(const string &message)
+{
+	if (this->mqttEnabled)
+	{
+		string iso_datetime = this->to_iso_8601(std::chrono::system_clock::now());
+		json jPayload;
+		jPayload["time"] = iso_datetime;
+		jPayload["level"] = "Debug";
+		jPayload["message"] = message;
+		string payload = jPayload.dump();
+
+		esp_mqtt_client_publish(this->mqttClient, this->mqttTopicLog.c_str(), payload.c_str(), 0, 1, 1);
+	}
+}
+
+// events go to mqtt and the session log on flash
+void BrewEngine::logEvent(const string &message)
+{
+	this->logRemote(message);
+	this->brewLog.AddEvent(time(0), message);
+}
+
+void BrewEngine::stopWebserver(httpd_handle_t server)
+{
+	// Stop the httpd server
+	httpd_stop(server);
+}
+
+// an empty partition (after a firmware update) is formatted, so it is ready for an upload
+void BrewEngine::mountWebFiles()
+{
+	esp_vfs_spiffs_conf_t conf = {};
+	conf.base_path = WEB_BASE_PATH;
+	conf.partition_label = WEB_PARTITION;
+	conf.max_files = WEB_MAX_FILES;
+	conf.format_if_mount_failed = true;
+
+	esp_err_t err = esp_vfs_spiffs_register(&conf);
+	if (err != ESP_OK)
+	{
+		ESP_LOGW(TAG, "Web files not available: %s", esp_err_to_name(err));
+		return;
+	}
+
+	this->webMounted = true;
+}
+
+// web files come from their own partition, a gzipped file is served as the file it contains
+esp_err_t BrewEngine::webGetHandler(httpd_req_t *req)
+{
+	// the query is not part of the file
+	string uri(req->uri, strcspn(req->uri, "?"));
+	if (uri == "/")
+	{
+		uri = "/index.html";
+	}
+
+	if (uri == "/upload")
+	{
+		return sendUploadPage(req);
 	}
 
-	// set outputs off and quit thread
-	for (auto const &heater : instance->heaters)
+	FILE *file = NULL;
+	bool gzip = false;
+	string path = WEB_BASE_PATH + uri;
+
+	// spiffs has no directories and we don't want anyone to leave ours
+	if (mainInstance->webMounted && uri.find("..") == string::npos && uri.size() <= WEB_MAX_NAME_LENGTH)
 	{
-		gpio_set_level(heater->pinNr, instance->gpioLow);
+		gzip = true;
+		file = fopen((path + ".gz").c_str(), "rb");
+		if (file == NULL)
+		{
+			gzip = false;
+			file = fopen(path.c_str(), "rb");
+		}
 	}
 
-	vTaskDelete(NULL);
-}
+	if (file == NULL)
+	{
+		// the partition is missing (older partition table after an ota update) or doesn't have the file
+		esp_err_t err = sendEmbeddedWebFile(req, uri);
+		if (err != ESP_ERR_NOT_FOUND)
+		{
+			return err;
+		}
 
-void BrewEngine::controlLoop(void *arg)
-{
-	BrewEngine *instance = (BrewEngine *)arg;
+		httpd_resp_set_status(req, "307 Temporary Redirect");
+		httpd_resp_set_hdr(req, "Location", "/");
+		httpd_resp_send(req, "<html><body>Wrong</body></html>", 0); // Response body can be empty
 
-	// the pid needs to reset one step later so the next temp is set, oherwise it has a delay
-	bool resetPIDNextStep = false;
+		return ESP_OK;
+	}
 
-	// For boost mode to see if temp starts to drop
-	float prevTemperature = instance->temperature;
-	uint boostUntil = 0;
+	string etag = mainInstance->webEtag(gzip ? path + ".gz" : path, file);
 
-	while (instance->run && instance->controlRun)
+	httpd_resp_set_type(req, contentType(uri));
+	if (gzip)
 	{
+		httpd_resp_set_hdr(req, "Content-Encoding", "gzip");
+	}
+	httpd_resp_set_hdr(req, "ETag", etag.c_str());
 
-		system_clock::time_point now = std::chrono::system_clock::now();
-
-		if (instance->executionSteps.size() >= instance->currentMashStep)
-		{ // there are more steps
-			int nextStepIndex = instance->currentMashStep;
-
-			auto nextStep = instance->executionSteps.at(nextStepIndex);
+	// index has a fixed url and changes with every upload, so browsers revalidate it and mostly get a 304
+	httpd_resp_set_hdr(req, "Cache-Control", uri == "/index.html" ? "no-cache" : WEB_CACHE_CONTROL);
 
-			system_clock::time_point nextAction = nextStep->time;
+	char ifNoneMatch[64];
+	size_t length = httpd_req_get_hdr_value_len(req, "If-None-Match");
+	if (length > 0 && length < sizeof(ifNoneMatch) && httpd_req_get_hdr_value_str(req, "If-None-Match", ifNoneMatch, sizeof(ifNoneMatch)) == ESP_OK &&
+		strstr(ifNoneMatch, etag.c_str()) != NULL)
+	{
+		fclose(file);
+		httpd_resp_set_status(req, "304 Not Modified");
+		return httpd_resp_send(req, NULL, 0);
+	}
 
-			bool gotoNextStep = false;
+	char buffer[WEB_CHUNK_SIZE];
+	size_t read;
+	while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0)
+	{
+		if (httpd_resp_send_chunk(req, buffer, read) != ESP_OK)
+		{
+			fclose(file);
+			return ESP_FAIL;
+		}
+	}
+	fclose(file);
 
-			// set target when not overriden
-			if (instance->overrideTargetTemperature.has_value())
-			{
-				instance->targetTemperature = instance->overrideTargetTemperature.value();
-			}
-			else
-			{
-				instance->targetTemperature = nextStep->temperature;
-			}
+	return httpd_resp_send_chunk(req, NULL, 0);
+}
 
-			uint secondsToGo = 0;
-			// if its smaller 0 is ok!
-			if (nextAction > now)
-			{
-				secondsToGo = chrono::duration_cast<chrono::seconds>(nextAction - now).count();
-			}
+// small page in the firmware, so a device without web files can still get them
+esp_err_t BrewEngine::sendUploadPage(httpd_req_t *req)
+{
+	extern const unsigned char upload_html_start[] asm("_binary_upload_html_start");
+	extern const unsigned char upload_html_end[] asm("_binary_upload_html_end");
+	httpd_resp_set_type(req, "text/html");
+	httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
 
-			// Boost mode logic
-			if (nextStep->allowBoost)
-			{
-				if (boostUntil == 0)
-				{
-					boostUntil = (uint)((nextStep->temperature / 100) * (float)instance->boostModeUntil);
-				}
+	return httpd_resp_send(req, (const char *)upload_html_start, upload_html_end - upload_html_start);
+}
 
-				if (instance->boostStatus == Off && instance->temperature < boostUntil)
-				{
+// the web interface the firmware was built with, ESP_ERR_NOT_FOUND when it has no file for the uri and nothing was sent
+esp_err_t BrewEngine::sendEmbeddedWebFile(httpd_req_t *req, const string &uri)
+{
+	extern const unsigned char index_html_start[] asm("_binary_index_html_gz_start");
+	extern const unsigned char index_html_end[] asm("_binary_index_html_gz_end");
+	extern const unsigned char logo_svg_start[] asm("_binary_logo_svg_gz_start");
+	extern const unsigned char logo_svg_end[] asm("_binary_logo_svg_gz_end");
+	extern const unsigned char manifest_json_start[] asm("_binary_manifest_json_start");
+	extern const unsigned char manifest_json_end[] asm("_binary_manifest_json_end");
 
-					ESP_LOGI(TAG, "Boost Start Until: %d", boostUntil);
-					instance->logRemote("Boost Start");
-					instance->boostStatus = Boost;
-				}
-				else if (instance->boostStatus == Boost && instance->temperature >= boostUntil)
-				{
-					// When in boost mode we wait unit boost temp is reched, pid is locked to 100% in boost mode
-					ESP_LOGI(TAG, "Boost Rest Start");
-					instance->logRemote("Boost Rest Start");
-					instance->boostStatus = Rest;
-				}
-				else if (instance->boostStatus == Rest && instance->temperature < prevTemperature)
-				{
-					// When in boost rest mode, we wait until temperature drops pid is locked to 0%
-					ESP_LOGI(TAG, "Boost Rest End");
-					instance->logRemote("Boost Rest End");
-					instance->boostStatus = Off;
+	struct EmbeddedFile
+	{
+		const char *uri;
+		const unsigned char *start;
+		const unsigned char *end;
+		const char *etag;
+		bool gzip;
+	};
+
+	static const EmbeddedFile files[] = {
+		{"/index.html", index_html_start, index_html_end, "\"" ETAG_INDEX_HTML_GZ "\"", true},
+		{"/logo.svg", logo_svg_start, logo_svg_end, "\"" ETAG_LOGO_SVG_GZ "\"", true},
+		{"/manifest.json", manifest_json_start, manifest_json_end, "\"" ETAG_MANIFEST_JSON "\"", false},
+	};
+
+	auto file = std::find_if(std::begin(files), std::end(files), [&uri](const EmbeddedFile &f)
+							 { return uri == f.uri; });
+	if (file == std::end(files))
+	{
+		return ESP_ERR_NOT_FOUND;
+	}
 
-					// Reset pid
-					instance->resetPitTime = true;
-				}
-			}
+	httpd_resp_set_type(req, contentType(uri));
+	if (file->gzip)
+	{
+		httpd_resp_set_hdr(req, "Content-Encoding", "gzip");
+	}
+	httpd_resp_set_hdr(req, "ETag", file->etag);
+	httpd_resp_set_hdr(req, "Cache-Control", uri == "/index.html" ? "no-cache" : WEB_CACHE_CONTROL);
 
-			if (secondsToGo < 1)
-			{ // change temp and increment Currentstep
+	char ifNoneMatch[64];
+	size_t length = httpd_req_get_hdr_value_len(req, "If-None-Match");
+	if (length > 0 && length < sizeof(ifNoneMatch) && httpd_req_get_hdr_value_str(req, "If-None-Match", ifNoneMatch, sizeof(ifNoneMatch)) == ESP_OK &&
+		strstr(ifNoneMatch, file->etag) != NULL)
+	{
+		httpd_resp_set_status(req, "304 Not Modified");
+		return httpd_resp_send(req, NULL, 0);
+	}
 
-				// string iso_string = instance->to_iso_8601(nextStep->time);
-				// ESP_LOGI(TAG, "Control Time:%s, TempCur:%f, TempTarget:%d, Extend:%d, Overtime: %d", iso_string.c_str(), instance->temperature, nextStep->temperature, nextStep->extendIfNeeded, instance->inOverTime);
+	for (const unsigned char *chunk = file->start; chunk < file->end; chunk += WEB_CHUNK_SIZE)
+	{
+		size_t size = std::min<size_t>(WEB_CHUNK_SIZE, file->end - chunk);
+		if (httpd_resp_send_chunk(req, (const char *)chunk, size) != ESP_OK)
+		{
+			return ESP_FAIL;
+		}
+	}
 
-				if (nextStep->extendIfNeeded == true && instance->inOverTime == false && (nextStep->temperature - instance->temperature) >= instance->tempMargin)
-				{
-					// temp must be reached, we keep going but need to triger a recaluclation event when done
-					ESP_LOGI(TAG, "OverTime Start");
-					instance->logRemote("OverTime Start");
-					instance->inOverTime = true;
-				}
-				else if (instance->inOverTime == true && (nextStep->temperature - instance->temperature) <= instance->tempMargin)
-				{
-					// we reached out temp after overtime, we need to recalc the rest and start going again
-					ESP_LOGI(TAG, "OverTime Done");
-					instance->logRemote("OverTime Done");
-					instance->inOverTime = false;
-					instance->recalculateScheduleAfterOverTime();
-					gotoNextStep = true;
-				}
-				else if (instance->inOverTime == false)
-				{
-					ESP_LOGI(TAG, "Going to next Step");
-					gotoNextStep = true;
-					// also reset override on step change
-					instance->overrideTargetTemperature = std::nullopt;
-				}
+	return httpd_resp_send_chunk(req, NULL, 0);
+}
 
-				// else when in overtime just keep going until we reach temp
-			}
+// replaces one web file, the body is the file as it is stored, so gzipped files keep their .gz
+esp_err_t BrewEngine::webUploadHandler(httpd_req_t *req)
+{
+	const char *name = req->uri + strlen("/api/web");
+	string uri(name, strcspn(name, "?"));
 
-			// the pid needs to reset one step later so the next temp is set, oherwise it has a delay
-			if (resetPIDNextStep)
-			{
-				resetPIDNextStep = false;
-				instance->resetPitTime = true;
-			}
+	if (!mainInstance->webMounted)
+	{
+		return apiError(req, "503 Service Unavailable", "Web partition not available, it comes with a serial flash of the full image");
+	}
 
-			if (gotoNextStep)
-			{
-				instance->currentMashStep++;
+	if (uri.size() < 2 || uri.find('/', 1) != string::npos || uri.find("..") != string::npos || uri.size() > WEB_MAX_NAME_LENGTH + 3)
+	{
+		return apiError(req, "400 Bad Request", "Invalid file name");
+	}
 
-				// Also reset boost
-				instance->boostStatus = Off;
+	string path = WEB_BASE_PATH + uri;
+	const char *temporary = WEB_BASE_PATH "/upload.tmp";
 
-				resetPIDNextStep = true;
-			}
+	size_t total = 0;
+	size_t used = 0;
+	esp_spiffs_info(WEB_PARTITION, &total, &used);
+	size_t available = used < total ? total - used : 0;
 
-			// notifications, but only when not in overtime
-			if (!instance->inOverTime && !instance->notifications.empty())
-			{
-				// filter out items that are not done
-				auto isNotDone = [](Notification *notification)
-				{ return notification->done == false; };
+	struct stat existing = {};
+	size_t existingSize = stat(path.c_str(), &existing) == 0 ? existing.st_size : 0;
 
-				auto notDone = instance->notifications | views::filter(isNotDone);
+	if (req->content_len > available + existingSize)
+	{
+		return apiError(req, "413 Payload Too Large", "Not enough space for this file");
+	}
 
-				if (!notDone.empty())
-				{
-					// they are sorted so we just have to check the first one
-					auto first = notDone.front();
+	// when old and new don't fit together the old one goes first, the upload page works without it
+	if (req->content_len > available)
+	{
+		unlink(path.c_str());
+	}
 
-					if (now > first->timePoint)
-					{
-						ESP_LOGI(TAG, "Notify %s", first->name.c_str());
+	FILE *file = fopen(temporary, "wb");
+	if (file == NULL)
+	{
+		return apiError(req, "500 Internal Server Error", "Unable to create file");
+	}
 
-						string buzzerName = "buzzer" + first->name;
-						xTaskCreate(&instance->buzzer, buzzerName.c_str(), 1024, instance, 10, NULL);
+	char buffer[WEB_CHUNK_SIZE];
+	size_t remaining = req->content_len;
 
-						first->done = true;
-					}
-				}
-			}
-		}
-		else
+	while (remaining > 0)
+	{
+		int received = httpd_req_recv(req, buffer, std::min(remaining, sizeof(buffer)));
+		if (received == HTTPD_SOCK_ERR_TIMEOUT)
 		{
-			// last step need to stop
-			ESP_LOGI(TAG, "Program Finished");
-			instance->stop();
+			// Timeout, just continue
+			continue;
 		}
 
-		// For boost mode to see if temp starts to drop
-		prevTemperature = instance->temperature;
+		if (received <= 0 || fwrite(buffer, 1, received, file) != (size_t)received)
+		{
+			fclose(file);
+			unlink(temporary);
+			return received <= 0 ? ESP_FAIL : apiError(req, "500 Internal Server Error", "Writing file failed");
+		}
 
-		vTaskDelay(pdMS_TO_TICKS(1000));
+		remaining -= received;
 	}
+	fclose(file);
 
-	vTaskDelete(NULL);
-}
-
-string BrewEngine::bootIntoRecovery()
-{
-	// recovery is our factory
-	esp_partition_subtype_t t = ESP_PARTITION_SUBTYPE_APP_FACTORY;
-	const esp_partition_t *factory_partition = esp_partition_find_first(ESP_PARTITION_TYPE_APP, t, NULL);
-
-	if (factory_partition == NULL)
+	// spiffs doesn't rename over an existing file
+	unlink(path.c_str());
+	if (rename(temporary, path.c_str()) != 0)
 	{
-		ESP_LOGE(TAG, "Factory Partition not found!");
-		return "Error: Factory Partition not found!";
+		unlink(temporary);
+		return apiError(req, "500 Internal Server Error", "Writing file failed");
 	}
 
-	if (esp_ota_set_boot_partition(factory_partition) == ESP_OK)
+	// an old plain or gzipped version would be served instead or hide it
+	if (path.ends_with(".gz"))
 	{
-		return "Device is booting into recovery hold on!";
+		unlink(path.substr(0, path.size() - 3).c_str());
+	}
+	else
+	{
+		unlink((path + ".gz").c_str());
 	}
 
-	return "Error: Unable to chage boot Partition!";
-}
+	mainInstance->webEtags.clear();
 
-void BrewEngine::reboot(void *arg)
-{
-	vTaskDelay(2000 / portTICK_PERIOD_MS);
-	esp_restart();
-}
+	ESP_LOGI(TAG, "Web file %s updated, %d bytes", uri.c_str(), (int)req->content_len);
 
-void BrewEngine::buzzer(void *arg)
-{
-	BrewEngine *instance = (BrewEngine *)arg;
+	json jResultPayload = {
+		{"data", json::object()},
+		{"success", true},
+	};
 
-	if (instance->buzzer_PIN > 0)
-	{
-		auto buzzerMs = instance->buzzerTime * 1000;
-		gpio_set_level(instance->buzzer_PIN, instance->gpioHigh);
-		vTaskDelay(buzzerMs / portTICK_PERIOD_MS);
-		gpio_set_level(instance->buzzer_PIN, instance->gpioLow);
-	}
+	httpd_resp_set_type(req, "text/plain");
+	httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+	httpd_resp_sendstr(req, jResultPayload.dump().c_str());
 
-	vTaskDelete(NULL);
+	return ESP_OK;
 }
 
-string BrewEngine::processCommand(const string &payLoad)
+// crc of the content, kept until a file is uploaded
+string BrewEngine::webEtag(const string &path, FILE *file)
 {
-	ESP_LOGD(TAG, "payLoad %s", payLoad.c_str());
+	auto found = this->webEtags.find(path);
+	if (found != this->webEtags.end())
+	{
+		return found->second;
+	}
 
-	json jCommand = json::parse(payLoad);
-	string command = jCommand["command"];
-	json data = jCommand["data"];
+	char buffer[WEB_CHUNK_SIZE];
+	uint32_t crc = 0;
+	size_t size = 0;
+	size_t read;
+	while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0)
+	{
+		crc = esp_rom_crc32_le(crc, (const uint8_t *)buffer, read);
+		size += read;
+	}
+	rewind(file);
 
-	ESP_LOGD(TAG, "processCommand %s", command.c_str());
-	ESP_LOGD(TAG, "data %s", data.dump().c_str());
+	char etag[32];
+	snprintf(etag, sizeof(etag), "\"%x-%08lx\"", (unsigned int)size, (unsigned long)crc);
+	this->webEtags[path] = etag;
 
-	json resultData = {};
-	string message = "";
-	bool success = true;
+	return etag;
+}
 
-	if (command == "Data")
+const char *BrewEngine::contentType(const string &uri)
+{
+	static const std::map<string, const char *> types = {
+		{".html", "text/html"},
+		{".js", "application/javascript"},
+		{".css", "text/css"},
+		{".json", "application/json"},
+		{".svg", "image/svg+xml"},
+		{".png", "image/png"},
+		{".ico", "image/x-icon"},
+		{".woff2", "font/woff2"},
+	};
+
+	size_t dot = uri.rfind('.');
+	if (dot != string::npos)
 	{
-		time_t lastLogDateTime = time(0);
-
-		json jTempLog = json::array({});
-		if (!this->tempLog.empty())
+		auto found = types.find(uri.substr(dot));
+		if (found != types.end())
 		{
-			auto lastLog = this->tempLog.rend();
-			lastLogDateTime = lastLog->first;
-
-			// If we have a last date we only need to send the log increment
-			if (!data["lastDate"].is_null() && data["lastDate"].is_number())
-			{
-				time_t lastClientDate = (time_t)data["lastDate"];
-				ESP_LOGD(TAG, "lastClientDate %s", ctime(&lastClientDate));
-
-				// most efficient seems to loop reverse and add until date is reached
-				for (auto iter = this->tempLog.rbegin(); iter != this->tempLog.rend(); ++iter)
-				{
-					if (iter->first > lastClientDate)
-					{
-						json jTempLogItem;
-						jTempLogItem["time"] = iter->first;
-						jTempLogItem["temp"] = iter->second;
-						jTempLog.push_back(jTempLogItem);
-					}
-					else
-					{
-						break;
-					}
-				}
-			}
-			else
-			{
-				for (auto iter = this->tempLog.rbegin(); iter != this->tempLog.rend(); ++iter)
-				{
-					json jTempLogItem;
-					jTempLogItem["time"] = iter->first;
-					jTempLogItem["temp"] = iter->second;
-					jTempLog.push_back(jTempLogItem);
-				}
-			}
+			return found->second;
 		}
+	}
 
-		// currenttemps is an array of current temps, they are not necessarily all used for control
-		json jCurrentTemps = json::array({});
-		for (auto const &[key, val] : this->currentTemperatures)
-		{
-			json jCurrentTemp;
-			jCurrentTemp["sensor"] = to_string(key);			   // js doesn't support unint64
-			jCurrentTemp["temp"] = (double)((int)(val * 10)) / 10; // round float to 1 digit for display
-			jCurrentTemps.push_back(jCurrentTemp);
-		}
-
-		resultData = {
-			{"temp", (double)((int)(this->temperature * 10)) / 10}, // round float to 1 digit for display
-			{"temps", jCurrentTemps},
-			{"targetTemp", (double)((int)(this->targetTemperature * 10)) / 10}, // round float to 1 digit for display,
-			{"manualOverrideTargetTemp", nullptr},
-			{"output", this->pidOutput},
-			{"manualOverrideOutput", nullptr},
-			{"status", this->statusText},
-			{"stirStatus", this->stirStatusText},
-			{"lastLogDateTime", lastLogDateTime},
-			{"tempLog", jTempLog},
-			{"runningVersion", this->runningVersion},
-			{"inOverTime", this->inOverTime},
-			{"boostStatus", this->boostStatus},
-		};
-
-		if (this->manualOverrideOutput.has_value())
-		{
-			resultData["manualOverrideOutput"] = this->manualOverrideOutput.value();
-		}
+	return "application/octet-stream";
+}
 
-		if (this->overrideTargetTemperature.has_value())
-		{
-			resultData["manualOverrideTargetTemp"] = this->overrideTargetTemperature.value();
-		}
+esp_err_t BrewEngine::apiPostHandler(httpd_req_t *req)
+{
+	if (req->content_len > CONFIG_API_MAX_BODY_SIZE)
+	{
+		ESP_LOGW(TAG, "Api request of %d bytes rejected", (int)req->content_len);
+		return apiError(req, "413 Payload Too Large", "Request is too large");
 	}
-	else if (command == "GetRunningSchedule")
+
+	// parsed while it is received, so the body is never in memory next to the parsed json
+	// bad input gives a discarded value instead of an exception
+	RequestReader reader(req);
+	json jCommand;
+
+	switch (apiEncoding(req, "Content-Type"))
 	{
-		json jRunningSchedule;
-		jRunningSchedule["version"] = this->runningVersion;
+	case CborEncoding:
+		jCommand = json::from_cbor(reader.begin(), reader.end(), true, false);
+		break;
+	case MsgpackEncoding:
+		jCommand = json::from_msgpack(reader.begin(), reader.end(), true, false);
+		break;
+	default:
+		jCommand = json::parse(reader.begin(), reader.end(), nullptr, false);
+		break;
+	}
 
-		json jExecutionSteps = json::array({});
-		for (auto const &[key, val] : this->executionSteps)
-		{
-			json jExecutionStep = val->to_json();
-			jExecutionSteps.push_back(jExecutionStep);
-		}
-		jRunningSchedule["steps"] = jExecutionSteps;
+	if (reader.Error() != ESP_OK)
+	{
+		return ESP_FAIL;
+	}
 
-		json jNotifications = json::array({});
-		for (auto &notification : this->notifications)
-		{
-			json jNotification = notification->to_json();
-			jNotifications.push_back(jNotification);
-		}
-		jRunningSchedule["notifications"] = jNotifications;
+	// an array of commands is a batch, so a page can get everything it needs in one request
+	bool batch = !jCommand.is_discarded() && jCommand.is_array();
 
-		resultData = jRunningSchedule;
+	if (jCommand.is_discarded() || (!batch && !validCommand(jCommand)))
+	{
+		return apiError(req, "400 Bad Request", "Invalid request, json with a command or an array of commands is expected");
 	}
-	else if (command == "SetTemp")
+
+	httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+	httpd_resp_set_hdr(req, "Vary", "Accept, Accept-Encoding");
+
+	// msgpack needs the length of every map and array up front, so it can't be streamed like cbor
+	// we read it but answer in json, a client that also takes cbor gets that
+	ApiEncoding encoding = apiEncoding(req, "Accept");
+	if (encoding == MsgpackEncoding)
 	{
+		encoding = JsonEncoding;
+	}
 
-		if (data["targetTemp"].is_null())
+	// a response that does not fit in one buffer is gzipped when the client takes it, smaller ones are not worth it
+	// we only know that at the first send, headers go out with the first chunk so it is not too late for them
+	bool gzip = acceptsGzip(req);
+	bool started = false;
+	bool finishing = false;
+	bool compressing = false;
+	auto send = [&](const char *data, size_t length) -> esp_err_t
+	{
+		if (!started)
 		{
-			this->overrideTargetTemperature = std::nullopt;
-
-			// when not in a program also direclty set targtetemp
-			if (this->selectedMashScheduleName.empty() == true)
+			started = true;
+			compressing = gzip && !finishing;
+			if (compressing)
 			{
-				this->targetTemperature = 0;
+				httpd_resp_set_hdr(req, "Content-Encoding", "gzip");
+				mainInstance->gzip.Begin([req](const char *data, size_t length)
+										 { return httpd_resp_send_chunk(req, data, length); });
 			}
 		}
-		else if (data["targetTemp"].is_number())
+
+		if (compressing)
 		{
+			return mainInstance->gzip.Write(data, length);
+		}
+		return httpd_resp_send_chunk(req, data, length);
+	};
 
-			this->overrideTargetTemperature = (float)data["targetTemp"];
+	httpd_resp_set_type(req, encoding == CborEncoding ? "application/cbor" : "text/plain");
 
-			// when not in a program also direclty set targtetemp
-			if (this->selectedMashScheduleName.empty() == true)
-			{
-				this->targetTemperature = this->overrideTargetTemperature.value();
-			}
-		}
-		else
-		{
-			this->overrideTargetTemperature = std::nullopt;
+	// the response goes out in chunks while it is written, the buffer is reused for every request
+	JsonWriter writer(mainInstance->apiBuffer, sizeof(mainInstance->apiBuffer), send, encoding == CborEncoding ? JsonWriter::Cbor : JsonWriter::Text);
 
-			message = "Incorrect data, integer or float expected!";
-			success = false;
-		}
+	mainInstance->runCommands(jCommand, writer);
+
+	finishing = true;
+	if (writer.Finish() != ESP_OK)
+	{
+		return ESP_FAIL;
 	}
-	else if (command == "SetOverrideOutput")
+
+	if (compressing && mainInstance->gzip.Finish() != ESP_OK)
 	{
+		return ESP_FAIL;
+	}
 
-		if (data["output"].is_null() == false && data["output"].is_number())
-		{
-			this->manualOverrideOutput = (int)data["output"];
-		}
-		else
-		{
-			this->manualOverrideOutput = std::nullopt;
-		}
+	return httpd_resp_send_chunk(req, NULL, 0);
+}
 
-		// reset so effect is immidiate
-		this->resetPitTime = true;
+// a single command or a batch, the api handler checked the single one with validCommand
+void BrewEngine::runCommands(json &jCommand, JsonWriter &writer)
+{
+	if (!jCommand.is_array())
+	{
+		this->processCommand(jCommand, writer);
+		return;
 	}
-	else if (command == "Start")
+
+	// commands run in order, every command gets a result at the same position
+	writer.BeginArray();
+	for (auto &jBatchCommand : jCommand)
 	{
-		if (data["selectedMashSchedule"].is_null())
+		if (validCommand(jBatchCommand))
 		{
-			this->selectedMashScheduleName.clear();
+			this->processCommand(jBatchCommand, writer);
 		}
 		else
 		{
-			this->selectedMashScheduleName = (string)data["selectedMashSchedule"];
+			writeJson({{"data", json::object()}, {"success", false}, {"message", "Invalid command"}}, writer);
 		}
-
-		this->start();
 	}
-	else if (command == "StartStir")
+	writer.EndArray();
+}
+
+// a value from the json library in the format of the writer
+void BrewEngine::writeJson(const json &value, JsonWriter &writer)
+{
+	if (writer.Encoding() == JsonWriter::Cbor)
 	{
-		this->startStir(data);
+		string encoded;
+		json::to_cbor(value, encoded);
+		writer.Raw(encoded);
 	}
-	else if (command == "Stop")
+	else
 	{
-		this->stop();
+		writer.Raw(value.dump());
 	}
-	else if (command == "StopStir")
+}
+
+// browsers always send gzip, curl only with --compressed
+bool BrewEngine::acceptsGzip(httpd_req_t *req)
+{
+	char value[64];
+	esp_err_t err = httpd_req_get_hdr_value_str(req, "Accept-Encoding", value, sizeof(value));
+	if (err != ESP_OK && err != ESP_ERR_HTTPD_RESULT_TRUNC)
 	{
-		this->stopStir();
+		return false;
 	}
-	else if (command == "GetMashSchedules")
-	{
-
-		json jSchedules = json::array({});
 
-		for (auto const &[key, val] : this->mashSchedules)
-		{
-			json jSchedule = val->to_json();
-			jSchedules.push_back(jSchedule);
-		}
+	return string_view(value).find("gzip") != string_view::npos;
+}
 
-		resultData = jSchedules;
-	}
-	else if (command == "SaveMashSchedule")
+// binary encodings are opt in, anything we don't know stays json
+ApiEncoding BrewEngine::apiEncoding(httpd_req_t *req, const char *header)
+{
+	// a long accept list is cut off, the start is where a client puts what it prefers
+	char value[64];
+	esp_err_t err = httpd_req_get_hdr_value_str(req, header, value, sizeof(value));
+	if (err != ESP_OK && err != ESP_ERR_HTTPD_RESULT_TRUNC)
 	{
-		this->setMashSchedule(data);
-
-		this->saveMashSchedules();
+		return JsonEncoding;
 	}
-	else if (command == "SetMashSchedule") // used by import function to set but not save
+
+	string_view type(value);
+	if (type.find("application/cbor") != string_view::npos)
 	{
-		this->setMashSchedule(data);
+		return CborEncoding;
 	}
-	else if (command == "DeleteMashSchedule")
+	if (type.find("application/msgpack") != string_view::npos || type.find("application/x-msgpack") != string_view::npos)
 	{
-		string deleteName = (string)data["name"];
+		return MsgpackEncoding;
+	}
 
-		auto pos = this->mashSchedules.find(deleteName);
+	return JsonEncoding;
+}
 
-		if (pos == this->mashSchedules.end())
-		{
-			message = "Schedule with name: " + deleteName + " not found";
-			success = false;
-		}
-		else
-		{
-			this->mashSchedules.erase(pos);
-			this->saveMashSchedules();
-		}
-	}
-	else if (command == "GetPIDSettings")
-	{
-		resultData = {
-			{"kP", this->mashkP},
-			{"kI", this->mashkI},
-			{"kD", this->mashkD},
-			{"boilkP", this->boilkP},
-			{"boilkI", this->boilkI},
-			{"boilkD", this->boilkD},
-			{"pidLoopTime", this->pidLoopTime},
-			{"stepInterval", this->stepInterval},
-			{"boostModeUntil", this->boostModeUntil},
-			{"heaterLimit", this->heaterLimit},
-			{"heaterCycles", this->heaterCycles},
-			{"relayGuard", this->relayGuard},
-		};
-	}
-	else if (command == "SavePIDSettings")
+bool BrewEngine::validCommand(const json &jCommand)
+{
+	return jCommand.is_object() && jCommand.contains("command") && jCommand["command"].is_string();
+}
+
+// handlers check the data of a client before they read it, bad input fails the command instead of throwing
+bool BrewEngine::checkData(const JsonCheck &check, CommandResult &result)
+{
+	if (check.Valid())
 	{
-		this->mashkP = data["kP"].get<double>();
-		this->mashkI = data["kI"].get<double>();
-		this->mashkD = data["kD"].get<double>();
-		this->boilkP = data["boilkP"].get<double>();
-		this->boilkI = data["boilkI"].get<double>();
-		this->boilkD = data["boilkD"].get<double>();
-		this->pidLoopTime = data["pidLoopTime"].get<uint16_t>();
-		this->stepInterval = data["stepInterval"].get<uint16_t>();
-		this->boostModeUntil = data["boostModeUntil"].get<uint8_t>();
-		this->heaterLimit = data["heaterLimit"].get<uint8_t>();
-		this->heaterCycles = data["heaterCycles"].get<uint8_t>();
-		this->relayGuard = data["relayGuard"].get<uint8_t>();
-		this->savePIDSettings();
+		return true;
 	}
-	else if (command == "GetTempSettings")
-	{
-		// Convert sensors to json
-		json jSensors = json::array({});
 
-		for (auto const &[key, val] : this->sensors)
-		{
-			json jSensor = val->to_json();
-			jSensors.push_back(jSensor);
-		}
+	result.message = "Incorrect data, " + check.Error();
+	result.success = false;
+	return false;
+}
 
-		resultData = jSensors;
-	}
-	else if (command == "SaveTempSettings")
-	{
-		this->saveTempSensorSettings(data);
-	}
-	else if (command == "DetectTempSensors")
+// same result as a failed command, so the web shows the message
+esp_err_t BrewEngine::apiError(httpd_req_t *req, const char *status, const string &message)
+{
+	json jResultPayload = {
+		{"data", json::object()},
+		{"success", false},
+		{"message", message},
+	};
+
+	httpd_resp_set_status(req, status);
+	httpd_resp_set_type(req, "text/plain");
+	httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+	httpd_resp_sendstr(req, jResultPayload.dump().c_str());
+
+	return ESP_OK;
+}
+
+// for prometheus scrapers, formatted into the api buffer and sent in chunks so a scrape allocates nothing
+esp_err_t BrewEngine::metricsGetHandler(httpd_req_t *req)
+{
+	httpd_resp_set_type(req, METRICS_CONTENT_TYPE);
+
+	MetricsWriter writer(mainInstance->apiBuffer, sizeof(mainInstance->apiBuffer), [req](const char *data, size_t length)
+						 { return httpd_resp_send_chunk(req, data, length); });
+
+	mainInstance->writeMetrics(writer);
+
+	if (writer.Finish() != ESP_OK)
 	{
-		this->detectOnewireTemperatureSensors();
+		return ESP_FAIL;
 	}
-	else if (command == "GetHeaterSettings")
+
+	return httpd_resp_send_chunk(req, NULL, 0);
+}
+
+void BrewEngine::writeMetrics(MetricsWriter &writer)
+{
+	// temperatures are rounded like we show them, so they are not printed with float noise
+	auto tenths = [](float value)
+	{ return std::round(value * 10) / 10.0; };
+
+	writer.Metric("brew_info", "gauge", "Temperature scale of all temperatures, always 1");
+	writer.Sample(1, {{"scale", this->temperatureScale == Celsius ? "celsius" : "fahrenheit"}});
+
+	writer.Metric("brew_temperature", "gauge", "Fused temperature of the control sensors");
+	writer.Sample(tenths(this->temperature));
+
+	writer.Metric("brew_target_temperature", "gauge", "Requested temperature");
+	writer.Sample(tenths(this->targetTemperature));
+
+	writer.Metric("brew_sensor_temperature", "gauge", "Last temperature of every sensor");
+
+	xSemaphoreTake(this->sensorMutex, portMAX_DELAY);
+
+	for (auto const &[key, val] : this->currentTemperatures)
 	{
-		// Convert heaters to json
-		json jHeaters = json::array({});
+		char id[24];
+		auto result = std::to_chars(id, id + sizeof(id), key);
 
-		for (auto const &heater : this->heaters)
-		{
-			json jHeater = heater->to_json();
-			jHeaters.push_back(jHeater);
-		}
+		auto sensor = this->sensors.find(key);
+		string_view name = sensor != this->sensors.end() ? string_view(sensor->second->name) : string_view();
 
-		resultData = jHeaters;
+		writer.Sample(tenths(val), {{"sensor", string_view(id, result.ptr - id)}, {"name", name}});
 	}
-	else if (command == "SaveHeaterSettings")
+
+	xSemaphoreGive(this->sensorMutex);
+
+	writer.Metric("brew_pid_output_percent", "gauge", "Output of the pid");
+	writer.Sample(this->pidOutput);
+
+	writer.Metric("brew_heater_burn_percent", "gauge", "Part of the output cycle a heater is on");
+	for (auto const &heater : this->heaters)
 	{
-		if (this->controlRun)
-		{
-			message = "You cannot save heater settings while running!";
-			success = false;
-		}
-		else
-		{
-			this->saveHeaterSettings(data);
-		}
+		char id[4];
+		auto result = std::to_chars(id, id + sizeof(id), heater->id);
+		writer.Sample(heater->burnTime, {{"heater", string_view(id, result.ptr - id)}, {"name", heater->name}});
 	}
-	else if (command == "GetWifiSettings")
+
+	writer.Metric("brew_heater_on_seconds_total", "counter", "Time a heater was on since it was loaded");
+	for (auto const &heater : this->heaters)
 	{
-		// get data from wifi-connect
-		if (this->GetWifiSettingsJson)
-		{
-			resultData = this->GetWifiSettingsJson();
-		}
+		char id[4];
+		auto result = std::to_chars(id, id + sizeof(id), heater->id);
+		writer.Sample(heater->onTime / 1000.0, {{"heater", string_view(id, result.ptr - id)}, {"name", heater->name}});
 	}
-	else if (command == "SaveWifiSettings")
+
+	writer.Metric("brew_running", "gauge", "1 when a program is running");
+	writer.Sample(this->controlRun);
+
+	writer.Metric("brew_mash_step", "gauge", "Index of the current step of the running program");
+	writer.Sample(this->currentMashStep);
+
+	writer.Metric("brew_boost_status", "gauge", "Boost mode, 0 off, 1 boost, 2 rest");
+	writer.Sample(this->boostStatus);
+
+	writer.Metric("brew_overtime", "gauge", "1 when the current step runs over its time");
+	writer.Sample(this->inOverTime);
+
+	// only with the brewlog partition
+	if (this->brewLog.Ready())
 	{
-		// save via wifi-connect
-		if (this->SaveWifiSettingsJson)
-		{
-			this->SaveWifiSettingsJson(data);
-		}
-		message = "Please restart device for changes to have effect!";
+		BrewLog::WriteStats logStats = this->brewLog.Stats();
+
+		writer.Metric("brew_log_errors_total", "counter", "Failed erases and writes of the brew log partition");
+		writer.Sample(logStats.eraseErrors, {{"operation", "erase"}});
+		writer.Sample(logStats.writeErrors, {{"operation", "write"}});
+
+		writer.Metric("brew_log_lost_records_total", "counter", "Brew log records that are not on flash because of an error");
+		writer.Sample(logStats.lostRecords);
 	}
-	else if (command == "ScanWifi")
+
+	writer.Metric("esp_heap_free_bytes", "gauge", "Free heap");
+	writer.Sample(heap_caps_get_free_size(MALLOC_CAP_8BIT));
+
+	writer.Metric("esp_heap_min_free_bytes", "gauge", "Lowest free heap since boot");
+	writer.Sample(heap_caps_get_minimum_free_size(MALLOC_CAP_8BIT));
+
+	writer.Metric("esp_heap_largest_free_block_bytes", "gauge", "Largest block that can be allocated");
+	writer.Sample(heap_caps_get_largest_free_block(MALLOC_CAP_8BIT));
+
+	// tasks that only run with a program are gone when it stops, we read them under taskMutex and write after
+	writer.Metric("esp_task_stack_high_water_bytes", "gauge", "Least free stack a task had since it started");
+	vector<std::pair<string, UBaseType_t>> stacks;
+	auto taskStack = [&stacks](TaskHandle_t handle)
 	{
-		// scans for networks
-		if (this->ScanWifiJson)
+		if (handle != NULL)
 		{
-			resultData = this->ScanWifiJson();
+			stacks.push_back({pcTaskGetName(handle), uxTaskGetStackHighWaterMark(handle)});
 		}
-	}
-	else if (command == "GetSystemSettings")
+	};
+
+	xSemaphoreTake(this->taskMutex, portMAX_DELAY);
+	taskStack(xTaskGetCurrentTaskHandle());
+	for (TaskHandle_t handle : {this->pushLoopHandle, this->controlLoopHandle, this->pidLoopHandle, this->outputLoopHandle, this->stirLoopHandle})
 	{
-		resultData = {
-			{"onewirePin", this->oneWire_PIN},
-			{"stirPin", this->stir_PIN},
-			{"buzzerPin", this->buzzer_PIN},
-			{"buzzerTime", this->buzzerTime},
-			{"invertOutputs", this->invertOutputs},
-			{"mqttUri", this->mqttUri},
-			{"temperatureScale", this->temperatureScale},
-		};
+		taskStack(handle);
 	}
-	else if (command == "SaveSystemSettings")
+	for (auto const &bus : this->temperatureBuses)
 	{
-		this->saveSystemSettingsJson(data);
-		message = "Please restart device for changes to have effect!";
+		taskStack(bus->readLoopHandle);
 	}
-	else if (command == "Reboot")
+	xSemaphoreGive(this->taskMutex);
+
+	for (auto const &[name, stack] : stacks)
 	{
-		xTaskCreate(&this->reboot, "reboot_task", 1024, this, 5, NULL);
+		writer.Sample(stack, {{"task", name}});
 	}
-	else if (command == "FactoryReset")
+
+	// only as a station, in ap mode there is no rssi
+	wifi_ap_record_t apInfo;
+	if (esp_wifi_sta_get_ap_info(&apInfo) == ESP_OK)
 	{
-		this->settingsManager->FactoryReset();
-		message = "Device will restart shortly, reconnect to factory wifi settings to continue!";
-		xTaskCreate(&this->reboot, "reboot_task", 1024, this, 5, NULL);
+		writer.Metric("esp_wifi_rssi_dbm", "gauge", "Signal strength of the access point");
+		writer.Sample(apInfo.rssi);
 	}
-	else if (command == "BootIntoRecovery")
-	{
-		message = this->bootIntoRecovery();
 
-		if (message.find("Error") != std::string::npos)
-		{
-			success = false;
-		}
-		else
+	writer.Metric("esp_uptime_seconds", "gauge", "Time since boot");
+	writer.Sample(esp_timer_get_time() / 1000000.0);
+}
+
+// live clients only listen, we read what they send so the connection stays healthy
+esp_err_t BrewEngine::wsHandler(httpd_req_t *req)
+{
+	if (req->method == HTTP_GET)
+	{
+		// handshake done, the push loop finds the client by itself
+		if (mainInstance->pushLoopHandle != NULL)
 		{
-			xTaskCreate(&this->reboot, "reboot_task", 1024, this, 5, NULL);
+			xTaskNotifyGive(mainInstance->pushLoopHandle);
 		}
+		return ESP_OK;
 	}
 
-	json jResultPayload;
-	jResultPayload["data"] = resultData;
-	jResultPayload["success"] = success;
+	httpd_ws_frame_t frame = {};
+	esp_err_t err = httpd_ws_recv_frame(req, &frame, 0);
+	if (err != ESP_OK)
+	{
+		return err;
+	}
 
-	if (message != "")
+	if (frame.len > LIVE_MAX_MESSAGE)
 	{
-		jResultPayload["message"] = message;
+		return ESP_FAIL;
 	}
 
-	string resultPayload = jResultPayload.dump();
+	if (frame.len > 0)
+	{
+		uint8_t buffer[LIVE_MAX_MESSAGE];
+		frame.payload = buffer;
+		return httpd_ws_recv_frame(req, &frame, frame.len);
+	}
 
-	return resultPayload;
+	return ESP_OK;
 }
 
-httpd_handle_t BrewEngine::startWebserver(void)
+// long lived text/event-stream, the request is handed over to the push loop so the server worker is free again
+esp_err_t BrewEngine::eventsGetHandler(httpd_req_t *req)
 {
+	xSemaphoreTake(mainInstance->liveMutex, portMAX_DELAY);
+	size_t clients = mainInstance->eventClients.size();
+	xSemaphoreGive(mainInstance->liveMutex);
 
-	httpd_uri_t indexUri;
-	indexUri.uri = "/";
-	indexUri.method = HTTP_GET;
-	indexUri.handler = this->indexGetHandler;
-
-	httpd_uri_t logoUri;
-	logoUri.uri = "/logo.svg";
-	logoUri.method = HTTP_GET;
-	logoUri.handler = this->logoGetHandler;
-
-	httpd_uri_t manifestUri;
-	manifestUri.uri = "/manifest.json";
-	manifestUri.method = HTTP_GET;
-	manifestUri.handler = this->manifestGetHandler;
-
-	httpd_uri_t postUri;
-	postUri.uri = "/api";
-	postUri.method = HTTP_POST;
-	postUri.handler = this->apiPostHandler;
-
-	httpd_uri_t optionsUri;
-	optionsUri.uri = "/api";
-	optionsUri.method = HTTP_OPTIONS;
-	optionsUri.handler = this->apiOptionsHandler;
-
-	httpd_uri_t otherUri;
-	otherUri.uri = "/*";
-	otherUri.method = HTTP_GET;
-	otherUri.handler = this->otherGetHandler;
+	// every stream keeps a socket, we need some left for the web
+	if (clients >= EVENTS_MAX_CLIENTS)
+	{
+		httpd_resp_set_status(req, "503 Service Unavailable");
+		httpd_resp_sendstr(req, "Too many event streams");
+		return ESP_OK;
+	}
 
-	httpd_handle_t server = NULL;
-	httpd_config_t config = HTTPD_DEFAULT_CONFIG();
-	// whiout this the esp crashed whitout a proper warning
-	config.stack_size = 20480;
-	config.uri_match_fn = httpd_uri_match_wildcard;
+	httpd_req_t *asyncReq;
+	esp_err_t err = httpd_req_async_handler_begin(req, &asyncReq);
+	if (err != ESP_OK)
+	{
+		return err;
+	}
 
-	// Start the httpd server
-	ESP_LOGI(TAG, "Starting server on port: '%d'", config.server_port);
-	if (httpd_start(&server, &config) == ESP_OK)
+	httpd_resp_set_type(asyncReq, "text/event-stream");
+	httpd_resp_set_hdr(asyncReq, "Cache-Control", "no-cache");
+	httpd_resp_set_hdr(asyncReq, "Access-Control-Allow-Origin", "*");
+
+	// a new client starts with the current values of every event
+	LiveGroups live(LiveGroupCount);
+	bool changed[LiveGroupCount];
+	mainInstance->updateLive(live, changed);
+	string events = "retry: 3000\n\n";
+	formatEvents(events, live, changed);
+	if (httpd_resp_send_chunk(asyncReq, events.data(), events.size()) != ESP_OK)
 	{
-		// Set URI handlers
-		httpd_register_uri_handler(server, &indexUri);
-		httpd_register_uri_handler(server, &logoUri);
-		httpd_register_uri_handler(server, &manifestUri);
-		httpd_register_uri_handler(server, &otherUri);
-		httpd_register_uri_handler(server, &postUri);
-		httpd_register_uri_handler(server, &optionsUri);
-		return server;
+		httpd_req_async_handler_complete(asyncReq);
+		return ESP_OK;
 	}
 
-	ESP_LOGI(TAG, "Error starting server!");
-	return NULL;
+	xSemaphoreTake(mainInstance->liveMutex, portMAX_DELAY);
+	mainInstance->eventClients.push_back(asyncReq);
+	xSemaphoreGive(mainInstance->liveMutex);
+
+	return ESP_OK;
 }
 
-void BrewEngine::logRemote(const string &message)
+// history as csv or ndjson (?format=ndjson), for analysis in other tools
+esp_err_t BrewEngine::exportGetHandler(httpd_req_t *req)
 {
-	if (this->mqttEnabled)
+	char query[64];
+	char format[16] = "csv";
+	if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK)
 	{
-		string iso_datetime = this->to_iso_8601(std::chrono::system_clock::now());
-		json jPayload;
-		jPayload["time"] = iso_datetime;
-		jPayload["level"] = "Debug";
-		jPayload["message"] = message;
-		string payload = jPayload.dump();
-
-		esp_mqtt_client_publish(this->mqttClient, this->mqttTopicLog.c_str(), payload.c_str(), 0, 1, 1);
+		httpd_query_key_value(query, "format", format, sizeof(format));
 	}
-}
 
-void BrewEngine::stopWebserver(httpd_handle_t server)
-{
-	// Stop the httpd server
-	httpd_stop(server);
+	return mainInstance->exportHistory(req, strcmp(format, "ndjson") == 0);
 }
 
-esp_err_t BrewEngine::indexGetHandler(httpd_req_t *req)
+// rows are read in small batches under the mutex and written from a fixed buffer, so memory doesn't grow with the history
+esp_err_t BrewEngine::exportHistory(httpd_req_t *req, bool ndjson)
 {
-	// ESP_LOGI(TAG, "index_get_handler");
-	extern const unsigned char index_html_start[] asm("_binary_index_html_gz_start");
-	extern const unsigned char index_html_end[] asm("_binary_index_html_gz_end");
-	const size_t index_html_size = (index_html_end - index_html_start);
-	httpd_resp_set_type(req, "text/html");
-	httpd_resp_set_hdr(req, "Content-Encoding", "gzip");
-	httpd_resp_send(req, (const char *)index_html_start, index_html_size);
+	xSemaphoreTake(this->sensorMutex, portMAX_DELAY);
 
-	return ESP_OK;
-}
+	// known channels first, sensors and heaters in the order they were first logged
+	vector<string> channels = {"mashStep", "temp", "target", "output"};
+	for (auto const &channel : this->tempLog.Channels())
+	{
+		if (std::find(channels.begin(), channels.end(), channel) == channels.end())
+		{
+			channels.push_back(channel);
+		}
+	}
+	uint32_t cursor = 0;
+	uint32_t end = this->tempLog.NextSeq(); // rows logged while we export are left out
 
-esp_err_t BrewEngine::logoGetHandler(httpd_req_t *req)
-{
-	extern const unsigned char logo_svg_file_start[] asm("_binary_logo_svg_gz_start");
-	extern const unsigned char logo_svg_file_end[] asm("_binary_logo_svg_gz_end");
-	const size_t logo_svg_file_size = (logo_svg_file_end - logo_svg_file_start);
-	httpd_resp_set_type(req, "image/svg+xml");
-	httpd_resp_set_hdr(req, "Content-Encoding", "gzip");
-	httpd_resp_send(req, (const char *)logo_svg_file_start, logo_svg_file_size);
+	xSemaphoreGive(this->sensorMutex);
 
-	return ESP_OK;
-}
+	httpd_resp_set_type(req, ndjson ? "application/x-ndjson" : "text/csv");
+	httpd_resp_set_hdr(req, "Content-Disposition", ndjson ? "attachment; filename=\"brew-log.ndjson\"" : "attachment; filename=\"brew-log.csv\"");
+	httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
 
-esp_err_t BrewEngine::manifestGetHandler(httpd_req_t *req)
-{
-	extern const unsigned char manifest_json_file_start[] asm("_binary_manifest_json_start");
-	extern const unsigned char manifest_json_file_end[] asm("_binary_manifest_json_end");
-	const size_t manifest_json_file_size = (manifest_json_file_end - manifest_json_file_start);
-	httpd_resp_set_type(req, "application/json");
-	httpd_resp_send(req, (const char *)manifest_json_file_start, manifest_json_file_size);
+	char buffer[EXPORT_BUFFER_SIZE];
+	size_t used = 0;
+	bool failed = false;
 
-	return ESP_OK;
-}
+	// appends a field to the buffer, the buffer is sent when the next field doesn't fit
+	auto append = [&](const char *text)
+	{
+		size_t length = strlen(text);
+		if (used + length > sizeof(buffer))
+		{
+			failed = failed || httpd_resp_send_chunk(req, buffer, used) != ESP_OK;
+			used = 0;
+		}
+		memcpy(buffer + used, text, length);
+		used += length;
+	};
 
-esp_err_t BrewEngine::otherGetHandler(httpd_req_t *req)
-{
-	httpd_resp_set_status(req, "307 Temporary Redirect");
-	httpd_resp_set_hdr(req, "Location", "/");
-	httpd_resp_send(req, "<html><body>Wrong</body></html>", 0); // Response body can be empty
+	char field[64];
 
-	return ESP_OK;
-}
+	if (!ndjson)
+	{
+		append("time");
+		for (auto const &channel : channels)
+		{
+			snprintf(field, sizeof(field), ",%s", channel.c_str());
+			append(field);
+		}
+		append("\n");
+	}
 
-esp_err_t BrewEngine::apiPostHandler(httpd_req_t *req)
-{
-	string stringBuffer;
-	char buf[256];
-	uint32_t ret;
-	uint32_t remaining = req->content_len;
+	vector<int16_t> values(channels.size() * EXPORT_BATCH_ROWS);
+	time_t times[EXPORT_BATCH_ROWS];
 
-	while (remaining > 0)
+	while (cursor < end && !failed)
 	{
-		// Read the data
-		int nBytes = (std::min<uint32_t>)(remaining, sizeof(buf));
+		uint32_t rows = 0;
+
+		xSemaphoreTake(this->sensorMutex, portMAX_DELAY);
+		cursor = this->tempLog.Read(cursor, channels, [&](time_t time, const int16_t *rowValues)
+									{
+										times[rows] = time;
+										std::copy(rowValues, rowValues + channels.size(), values.begin() + rows * channels.size());
+										rows++; }, EXPORT_BATCH_ROWS);
+		xSemaphoreGive(this->sensorMutex);
 
-		if ((ret = httpd_req_recv(req, buf, nBytes)) <= 0)
+		for (uint32_t row = 0; row < rows; row++)
 		{
-			if (ret == HTTPD_SOCK_ERR_TIMEOUT)
-			{
-				// Timeout, just continue
-				continue;
-			}
+			struct tm timeInfo;
+			gmtime_r(&times[row], &timeInfo);
+			char isoTime[24];
+			strftime(isoTime, sizeof(isoTime), "%FT%TZ", &timeInfo);
 
-			return ESP_FAIL;
-		}
+			snprintf(field, sizeof(field), ndjson ? "{\"time\":\"%s\"" : "%s", isoTime);
+			append(field);
+
+			for (size_t i = 0; i < channels.size(); i++)
+			{
+				int16_t value = values[row * channels.size() + i];
 
-		size_t bytes_read = ret;
+				if (value == TIMESERIES_MISSING)
+				{
+					// csv leaves the field empty, ndjson leaves the key out
+					if (!ndjson)
+					{
+						append(",");
+					}
+					continue;
+				}
 
-		remaining -= bytes_read;
+				const char *name = ndjson ? channels[i].c_str() : "";
+				if (this->temperatureChannel(channels[i]))
+				{
+					snprintf(field, sizeof(field), ndjson ? ",\"%s\":%.1f" : "%s,%.1f", name, (double)value / 10);
+				}
+				else
+				{
+					snprintf(field, sizeof(field), ndjson ? ",\"%s\":%d" : "%s,%d", name, value);
+				}
+				append(field);
+			}
 
-		// append to buffer
-		stringBuffer.append((char *)buf, bytes_read);
+			append(ndjson ? "}\n" : "\n");
+		}
 	}
 
-	string commandResult = mainInstance->processCommand(stringBuffer);
+	if (failed)
+	{
+		return ESP_FAIL;
+	}
 
-	const char *returnBuf = commandResult.c_str();
-	httpd_resp_set_type(req, "text/plain");
-	httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
-	httpd_resp_sendstr(req, returnBuf);
+	if (used > 0 && httpd_resp_send_chunk(req, buffer, used) != ESP_OK)
+	{
+		return ESP_FAIL;
+	}
 
-	return ESP_OK;
+	// empty chunk ends the response
+	return httpd_resp_send_chunk(req, NULL, 0);
 }
 
 // needed for cors
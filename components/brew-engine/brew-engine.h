@@ -9,10 +9,15 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/event_groups.h"
+#include "freertos/semphr.h"
 
 #include "esp_log.h"
 #include <esp_http_server.h>
 #include "esp_ota_ops.h"
+#include "esp_timer.h"
+#include "esp_spiffs.h"
+#include "esp_heap_caps.h"
+#include "esp_wifi.h"
 #include "driver/gpio.h"
 
 #include <iostream>
@@ -23,10 +28,18 @@
 #include <iomanip>
 #include <ranges>
 #include <map>
+#include <array>
+#include <charconv>
+#include <span>
+#include <string_view>
 #include <vector>
+#include <cstdio>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include "onewire_bus.h"
 #include "ds18b20.h"
+#include "driver/spi_master.h"
 
 #include "mqtt_client.h"
 
@@ -37,13 +50,56 @@
 #include "mash-schedule.h"
 #include "execution-step.h"
 #include "temperature-sensor.h"
+#include "temperature-bus.h"
+#include "temperature-fusion.h"
+#include "time-series.h"
+#include "downsample.h"
+#include "json-writer.h"
+#include "live-groups.h"
+#include "request-reader.h"
+#include "json-check.h"
+#include "gzip-writer.h"
+#include "metrics-writer.h"
+#include "brew-log.h"
+#include "ds18b20-driver.h"
+#include "max31865-driver.h"
+#include "max31855-driver.h"
+#include "mock-sensor-driver.h"
 #include "notification.h"
 
 #include "settings-manager.h"
 
 #include "nlohmann_json.hpp"
 
-#define ONEWIRE_MAX_DS18B20 10
+#define TEMP_READ_INTERVAL_MIN 100 // we allow a bit more then a 9 bit conversion
+#define ONEWIRE_SEARCH_INTERVAL 10000000 // in µs, time between background searches for new or returning sensors
+#define ONEWIRE_SEARCH_STEP_TIME 30000   // in µs, one rom search with reset takes about 15ms, we want some margin
+#define SENSOR_MAX_ERRORS 3              // consecutive failed reads before a sensor is disconnected
+#define SENSOR_HEALTH_INTERVAL 60000000  // in µs, how often sensor health is published to mqtt
+#define TEMP_LOG_PERIOD 5000             // in ms, min time between history rows
+#define TEMP_LOG_BLOCK_SIZE 256          // history is kept in blocks of delta encoded samples
+#define TEMP_LOG_BLOCK_COUNT 128         // 32KB shared by all channels, a steady channel takes about 1 byte per row
+#define HISTORY_MAX_POINTS 2000          // upper limit for downsampled history requests
+#define EXPORT_BUFFER_SIZE 1024         // export is sent in chunks of this size
+#define EXPORT_BATCH_ROWS 16             // rows read from the history per lock
+#define LIVE_PUSH_INTERVAL 1000         // in ms, max time before changes that don't come with a sample are pushed
+#define LIVE_MAX_CLIENTS 8               // at least max_open_sockets of the http server
+#define LIVE_MAX_MESSAGE 128             // clients don't need to send us anything, we ignore small messages
+#define HTTPD_MAX_URI_HANDLERS 16       // room for all our endpoints
+#define API_BUFFER_SIZE 1024             // api responses are sent in chunks of this size, larger ones are gzipped when the client accepts it
+#define METRICS_CONTENT_TYPE "text/plain; version=0.0.4; charset=utf-8" // prometheus text format
+#define WEB_PARTITION "webui"            // spiffs partition with the web interface
+#define WEB_BASE_PATH "/webui"
+#define WEB_MAX_FILES 4                  // files open at the same time
+#define WEB_MAX_NAME_LENGTH 27           // spiffs names are at most 32 bytes, this leaves room for .gz
+#define WEB_CHUNK_SIZE 2048              // web files are read and sent in chunks of this size
+#define WEB_CACHE_CONTROL "public, max-age=604800" // files other than index rarely change, browsers keep them a week
+#define EVENTS_MAX_CLIENTS 3             // every event stream keeps a socket open
+#define EVENTS_KEEPALIVE_INTERVAL 15000000 // in µs, event streams get a comment when nothing happened
+#define RUN_CHECKPOINT_INTERVAL 60       // in s, a running program saves its state at least this often
+#define RUN_RESUME_MAX_DOWNTIME 7200     // in s, after a longer power loss we don't resume the program
+#define RUN_RESUME_CLOCK_WAIT 120        // in s, how long a checkpoint waits for ntp before it's dropped
+#define RUN_RESUME_VALID_TIME 1577836800 // 2020-01-01, an earlier clock was not set by ntp
 
 enum TemperatureScale
 {
@@ -51,6 +107,12 @@ enum TemperatureScale
     Fahrenheit = 1
 };
 
+enum AcquisitionState
+{
+    Idle = 0,      // waiting for the next sample period
+    Converting = 1 // conversion is running on the bus, waiting for the deadline
+};
+
 enum BoostStatus
 {
     Off = 0,
@@ -58,6 +120,23 @@ enum BoostStatus
     Rest = 2
 };
 
+enum ApiEncoding
+{
+    JsonEncoding = 0,
+    CborEncoding = 1,
+    MsgpackEncoding = 2
+};
+
+// live fields are pushed per group, every group is also one server sent event
+enum LiveGroup
+{
+    LiveTemperature = 0,
+    LiveOutput = 1,
+    LiveStatus = 2,
+    LiveStep = 3,
+    LiveGroupCount = 4
+};
+
 using namespace std;
 using namespace std::chrono;
 using std::cout;
@@ -68,6 +147,7 @@ class BrewEngine
 {
 private:
     static void readLoop(void *arg);
+    static void readTimerCallback(void *arg);
     static void pidLoop(void *arg);
     static void outputLoop(void *arg);
     static void controlLoop(void *arg);
@@ -75,10 +155,45 @@ private:
     static void reboot(void *arg);
     static void factoryReset(void *arg);
     static void buzzer(void *arg);
+    static void pushLoop(void *arg);
+    static void sendLive(void *arg);
+    static void resumeLoop(void *arg);
+    void createTask(TaskFunction_t function, const char *name, uint32_t stackSize, void *arg, UBaseType_t priority, TaskHandle_t *handle);
+    void deleteTask(TaskHandle_t *handle);
 
     void readTempSensorSettings();
     void detectOnewireTemperatureSensors();
-    void initOneWire();
+    void initBuses();
+    void initSensorDrivers();
+    void initSensorDriver(TemperatureSensor *sensor);
+    void setSensorDriver(TemperatureSensor *sensor, SensorDriver *driver, bool connected);
+    void swapSensorDriver(TemperatureSensor *sensor);
+    void handOverDrivers(TemperatureBus *bus);
+    void searchOnewireBus(TemperatureBus *bus);
+    void discoverStep(TemperatureBus *bus, int64_t deadline);
+    bool attachOnewireDevice(TemperatureBus *bus, onewire_device_t &device);
+    vector<TemperatureSensor *> busSensors(TemperatureBus *bus);
+    void readTemperatureBusSettings();
+    void saveTemperatureBusSettings(const json &jBuses);
+    esp_err_t startConversion(TemperatureBus *bus, uint16_t &conversionTime);
+    uint8_t desiredResolution(TemperatureSensor *sensor);
+    void readTemperatures(TemperatureBus *bus, system_clock::time_point sampleTime);
+    json sensorHealth();
+    json brewSession(uint32_t id, uint32_t maxPoints);
+    vector<string> historyChannels(const json &jChannels);
+    static bool temperatureChannel(const string &channel);
+    uint32_t writeHistoryColumns(const json &data, const vector<string> &channels, JsonWriter &writer);
+    void liveGroup(JsonWriter &writer, LiveGroup group);
+    void liveFields(JsonWriter &writer);
+    bool updateLive(LiveGroups &live, bool *changed);
+    vector<int> liveClients();
+    static void formatEvents(string &events, LiveGroups &live, const bool *changed);
+    void sendEvents(LiveGroups &live, const bool *changed);
+    esp_err_t exportHistory(httpd_req_t *req, bool ndjson);
+    uint32_t readHistory(const json &data, const vector<string> &channels, const std::function<void(uint32_t seq, time_t time, const int16_t *values)> &callback);
+    void readLog(uint32_t cursor, uint32_t end, const vector<string> &channels, const std::function<void(uint32_t seq, time_t time, const int16_t *values)> &callback);
+    void publishSensorHealth();
+    void logTemperature(system_clock::time_point sampleTime);
     void initMqtt();
     void initHeaters();
     void readSystemSettings();
@@ -88,11 +203,17 @@ private:
     void savePIDSettings();
     void saveSystemSettingsJson(const json &config);
     void addDefaultMash();
-    void start();
+    void start(const string &scheduleName);
+    void startLoops();
+    void saveRunPlan();
+    void saveRunState(bool force);
+    void clearRunState();
+    void resumeRun();
     void loadSchedule();
     void recalculateScheduleAfterOverTime();
     void stop();
     void logRemote(const string &message);
+    void logEvent(const string &message);
     void addDefaultHeaters();
     void readHeaterSettings();
     void saveHeaterSettings(const json &jHeaters);
@@ -102,29 +223,116 @@ private:
     void stopStir();
     string bootIntoRecovery();
 
-    string processCommand(const string &payLoad);
+    // the api commands, every command has a handler that fills a result
+    struct CommandResult
+    {
+        json data = {};
+        string message = "";
+        bool success = true;
+    };
+
+    // a command has a handler, or a stream handler when it writes its data to the response itself
+    struct Command
+    {
+        std::string_view name;
+        void (BrewEngine::*handler)(json &data, CommandResult &result);
+        void (BrewEngine::*stream)(json &data, JsonWriter &writer);
+    };
+
+    struct CommandStats
+    {
+        uint32_t calls = 0;
+        uint64_t totalTime = 0; // in µs, from the parsed request until the response is sent
+        uint32_t maxTime = 0;
+        uint64_t totalSize = 0; // response bytes
+        uint32_t maxSize = 0;
+    };
+
+    static std::span<const Command> commands();
+    void processCommand(json &jCommand, JsonWriter &writer);
+    void runCommands(json &jCommand, JsonWriter &writer);
+    static void writeJson(const json &value, JsonWriter &writer);
+    void streamData(json &data, JsonWriter &writer);
+    void commandGetRunningSchedule(json &data, CommandResult &result);
+    void commandSetTemp(json &data, CommandResult &result);
+    void commandSetOverrideOutput(json &data, CommandResult &result);
+    void commandStart(json &data, CommandResult &result);
+    void commandStartStir(json &data, CommandResult &result);
+    void commandStop(json &data, CommandResult &result);
+    void commandStopStir(json &data, CommandResult &result);
+    void commandGetMashSchedules(json &data, CommandResult &result);
+    void commandSaveMashSchedule(json &data, CommandResult &result);
+    void commandSetMashSchedule(json &data, CommandResult &result);
+    void commandDeleteMashSchedule(json &data, CommandResult &result);
+    void commandGetPIDSettings(json &data, CommandResult &result);
+    void commandSavePIDSettings(json &data, CommandResult &result);
+    void commandGetTempSettings(json &data, CommandResult &result);
+    void commandSaveTempSettings(json &data, CommandResult &result);
+    void commandDetectTempSensors(json &data, CommandResult &result);
+    void commandGetSensorHealth(json &data, CommandResult &result);
+    void commandGetApiStats(json &data, CommandResult &result);
+    void commandGetBrewSessions(json &data, CommandResult &result);
+    void commandGetBrewSession(json &data, CommandResult &result);
+    void commandGetHeaterSettings(json &data, CommandResult &result);
+    void commandSaveHeaterSettings(json &data, CommandResult &result);
+    void commandGetWifiSettings(json &data, CommandResult &result);
+    void commandSaveWifiSettings(json &data, CommandResult &result);
+    void commandScanWifi(json &data, CommandResult &result);
+    void commandGetSystemSettings(json &data, CommandResult &result);
+    void commandSaveSystemSettings(json &data, CommandResult &result);
+    void commandReboot(json &data, CommandResult &result);
+    void commandFactoryReset(json &data, CommandResult &result);
+    void commandBootIntoRecovery(json &data, CommandResult &result);
 
     httpd_handle_t startWebserver(void);
     void stopWebserver(httpd_handle_t server);
-    static esp_err_t indexGetHandler(httpd_req_t *req);
-    static esp_err_t logoGetHandler(httpd_req_t *req);
-    static esp_err_t manifestGetHandler(httpd_req_t *req);
-    static esp_err_t otherGetHandler(httpd_req_t *req);
+    void mountWebFiles();
+    static esp_err_t webGetHandler(httpd_req_t *req);
+    static esp_err_t webUploadHandler(httpd_req_t *req);
+    static esp_err_t sendUploadPage(httpd_req_t *req);
+    static esp_err_t sendEmbeddedWebFile(httpd_req_t *req, const string &uri);
+    string webEtag(const string &path, FILE *file);
+    static const char *contentType(const string &uri);
     static esp_err_t apiPostHandler(httpd_req_t *req);
+    static esp_err_t apiError(httpd_req_t *req, const char *status, const string &message);
+    static bool validCommand(const json &jCommand);
+    static bool checkData(const JsonCheck &check, CommandResult &result);
+    static ApiEncoding apiEncoding(httpd_req_t *req, const char *header);
+    static bool acceptsGzip(httpd_req_t *req);
     static esp_err_t apiOptionsHandler(httpd_req_t *req);
+    static esp_err_t exportGetHandler(httpd_req_t *req);
+    static esp_err_t wsHandler(httpd_req_t *req);
+    static esp_err_t eventsGetHandler(httpd_req_t *req);
+    static esp_err_t metricsGetHandler(httpd_req_t *req);
+    void writeMetrics(MetricsWriter &writer);
 
     // small helpers
     static string to_iso_8601(std::chrono::time_point<std::chrono::system_clock> t);
 
     SettingsManager *settingsManager;
-    httpd_handle_t server;
+    httpd_handle_t server = NULL;
+    TaskHandle_t pushLoopHandle = NULL; // pushes changes to websocket and event stream clients
+    SemaphoreHandle_t taskMutex;        // guards the handles of the loop tasks, a task clears its own before it's deleted
+    SemaphoreHandle_t liveMutex;        // guards the event stream clients and the queued websocket frame
+    vector<httpd_req_t *> eventClients; // async requests of the event streams
+    int64_t lastEventTime = 0;          // esp_timer time we last sent something to the event streams
+    string events;                      // formatted events of a push, kept so it doesn't grow every time, needs liveMutex
+    string livePayload;                 // websocket frame queued for the http server task, needs liveMutex
+    bool liveQueued = false;            // livePayload is not sent yet, needs liveMutex
+    vector<CommandStats> commandStats;  // per entry of commands(), only the http server task touches them
+    char apiBuffer[API_BUFFER_SIZE];    // api responses are formatted in here, only the http server task uses it
+    GzipWriter gzip;                    // compresses large api responses, allocated once with us, also only for the http server task
+    bool webMounted = false;            // the web partition is mounted
+    std::map<string, string> webEtags;  // etag per web file path, cleared on upload
 
     TemperatureScale temperatureScale = Celsius;
-    float temperature = 0;                                         // average temp, we use float beceasue ds18b20_get_temperature returns float, no point in going more percise
+    float temperature = 0;                                         // fused temp of the control sensors, we use float beceasue ds18b20_get_temperature returns float, no point in going more percise
+    float temperatureRate = 0;                                     // rate of change in °/s, estimated together with temperature
     float targetTemperature = 0;                                   // requested temp
     std::optional<float> overrideTargetTemperature = std::nullopt; // manualy overwritten temp
     std::map<uint64_t, float> currentTemperatures;                 // map with last temp for each sensor
-    std::map<time_t, int8_t> tempLog;                              // integer log of averages, only used to show running history on web
+    TimeSeries tempLog = TimeSeries(TEMP_LOG_BLOCK_SIZE, TEMP_LOG_BLOCK_COUNT); // columnar log of temp, target, output and sensors, only used to show running history on web
+    BrewLog brewLog;                                                            // sessions on flash, so a brew record survives a power loss
 
     // pid
     uint8_t pidOutput = 0;
@@ -141,6 +349,7 @@ private:
     uint16_t pidLoopTime = 60; // time in seconds for a full loop,
     bool resetPitTime = false; // bool to reset pit , we do this when out target changes
     float tempMargin = 0.5;    // we don't want to nitpick about 0.5°C, water heating is not that percise
+    float resolutionMargin = 2; // auto resolution sensors switch to 12 bit when closer then this to target
 
     uint8_t boostModeUntil = 85;
 	uint8_t heaterLimit = 100;
@@ -166,6 +375,11 @@ private:
     uint16_t currentExecutionStep = 0;
     uint16_t stepInterval = 60;  // calcualte a substep every x seconds
     uint16_t runningVersion = 0; // we increase our version after recalc, so client can keep uptodate with planning
+    uint32_t brewSessionId = 0;  // session in the brew log, kept in the checkpoint so a resume continues it
+    json lastRunState;           // last checkpointed run state without time, we only write when it changes or is too old
+    time_t lastRunStateTime = 0;
+    SemaphoreHandle_t runStateMutex; // control loop and stop both write the run state
+    SemaphoreHandle_t programMutex;  // start, stop and a resume change the program, one at a time
 
     // IO
     uint8_t gpioHigh = 1;
@@ -174,7 +388,6 @@ private:
 
     std::vector<Heater *> heaters; // we support up to 10 heaters
 
-    gpio_num_t oneWire_PIN;
     gpio_num_t stir_PIN;
     gpio_num_t buzzer_PIN;
 
@@ -189,9 +402,14 @@ private:
     esp_mqtt_client_handle_t mqttClient;
     string mqttTopic = "";
     string mqttTopicLog = "";
+    string mqttTopicHealth = "";
+    int64_t lastHealthPublish = 0; // esp_timer time we last published sensor health
 
     // stirring/pumping
     TaskHandle_t stirLoopHandle = NULL;
+    TaskHandle_t controlLoopHandle = NULL;
+    TaskHandle_t pidLoopHandle = NULL;
+    TaskHandle_t outputLoopHandle = NULL;
     string stirStatusText = "Idle";
     bool stirRun = false;
     uint16_t stirTimeSpan = 10; // stir timespan in minutes
@@ -200,8 +418,15 @@ private:
     system_clock::time_point stirStartCycle;
 
     // one wire
-    onewire_bus_handle_t obh;
-    std::map<uint64_t, TemperatureSensor *> sensors; // map with sensor id and handle
+    std::vector<TemperatureBus *> temperatureBuses;  // every bus has its own gpio, rmt channels and read task
+    std::map<uint64_t, TemperatureSensor *> sensors; // map with sensor id and driver
+    SemaphoreHandle_t sensorMutex;                   // buses publish their readings concurrently
+    TemperatureFusion fusion;                        // median, noise weighting and kalman over the control sensors, guarded by sensorMutex
+    int64_t lastFusionTime = 0;                      // esp_timer time the control sensors were last fused, once per read period
+    uint16_t tempReadInterval = 1000;                // sample period in ms, a sample is started every period
+    system_clock::time_point lastSampleTime;         // time the conversion of the last sample was started
+    system_clock::time_point lastLogTime;            // time of the last sample we published
+    system_clock::time_point lastHistoryTime;        // time of the last sample we added to the history
 
 public:
     BrewEngine(SettingsManager *settingsManager); // constructor
@@ -0,0 +1,608 @@
+#ifndef _BrewLog_H_
+#define _BrewLog_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_partition.h"
+#include "esp_rom_crc.h"
+
+using namespace std;
+
+#define BREWLOG_PARTITION "brewlog"   // label of the data partition in partitions.csv
+#define BREWLOG_SECTOR_SIZE 4096      // erase unit of the flash
+#define BREWLOG_PAGE_SIZE 256         // records are buffered in ram and written a page at a time
+#define BREWLOG_FLUSH_INTERVAL 60000  // in ms, max time a record waits in ram
+#define BREWLOG_MAGIC 0x474C5242      // "BRLG"
+#define BREWLOG_MAX_TEXT 200          // longer event texts are cut off
+#define BREWLOG_TAG "BrewLog"
+
+enum BrewLogRecordType
+{
+    RecordSession = 1, // a session starts, repeated at the start of every sector so a sector can be read on its own
+    RecordSample = 2,
+    RecordEvent = 3,
+    RecordEnd = 4,
+    RecordFree = 0xFF // erased flash, nothing was written after this
+};
+
+// Append only log of brew sessions on a raw flash partition, survives power loss.
+// The partition is a ring of sectors, each starts with a header holding a sequence nr so we know the order after a reboot,
+// the oldest sector is erased when we run out of space.
+// Records are type, length, payload and a crc32, so a torn write only loses the records of the page that was being written.
+class BrewLog
+{
+public:
+    struct Session
+    {
+        uint32_t id;
+        string name;
+        time_t start;
+        time_t end;    // time of the last record when the session didn't end properly
+        bool complete; // false when power was lost or the log wrapped before the session ended
+        uint32_t samples;
+        uint32_t events;
+    };
+
+    struct Sample
+    {
+        time_t time;
+        int16_t temp;   // in 0.1°
+        int16_t target; // in 0.1°
+        uint8_t output; // in %
+    };
+
+    struct Event
+    {
+        time_t time;
+        string message;
+    };
+
+    struct WriteStats
+    {
+        uint32_t eraseErrors;
+        uint32_t writeErrors;
+        uint32_t lostRecords; // records that are not on flash because of an erase or write error
+    };
+
+    // finds the partition, the position to continue writing and starts the writer task
+    esp_err_t Init(const char *label)
+    {
+        this->partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, label);
+        if (this->partition == NULL)
+        {
+            return ESP_ERR_NOT_FOUND;
+        }
+
+        this->sectorCount = this->partition->size / BREWLOG_SECTOR_SIZE;
+        if (this->sectorCount < 2)
+        {
+            this->partition = NULL;
+            return ESP_ERR_INVALID_SIZE;
+        }
+
+        this->bufferMutex = xSemaphoreCreateMutex();
+        this->ioMutex = xSemaphoreCreateMutex();
+
+        // newest sector and session, we never continue in a sector after a reboot, its erased looking tail could be a torn write
+        for (auto const &[sector, seq] : this->sectorsInOrder())
+        {
+            this->writeSector = sector;
+            this->sectorSeq = seq;
+        }
+
+        this->scan([this](uint8_t type, const uint8_t *payload, uint8_t length)
+                   {
+                       if (type == RecordSession && length >= 8)
+                       {
+                           this->nextSessionId = std::max(this->nextSessionId, readUint32(payload + 4) + 1);
+                       } });
+
+        xTaskCreate(&this->writerLoop, "brewlog_task", 3072, this, 3, &this->writerHandle);
+
+        return ESP_OK;
+    };
+
+    bool Ready()
+    {
+        return this->partition != NULL;
+    };
+
+    // returns the id of the new session, a running session is ended first
+    uint32_t StartSession(time_t time, const string &name)
+    {
+        if (!this->Ready())
+        {
+            return 0;
+        }
+
+        xSemaphoreTake(this->bufferMutex, portMAX_DELAY);
+        uint32_t id = this->nextSessionId++;
+        this->openSession(id, time, name);
+        xSemaphoreGive(this->bufferMutex);
+
+        // a session start is worth a write
+        xTaskNotifyGive(this->writerHandle);
+
+        return id;
+    };
+
+    // continues a session after a reboot, its records are added to what is already on flash
+    void ResumeSession(uint32_t id, time_t start, const string &name)
+    {
+        if (!this->Ready() || id == 0)
+        {
+            return;
+        }
+
+        xSemaphoreTake(this->bufferMutex, portMAX_DELAY);
+        this->openSession(id, start, name);
+        xSemaphoreGive(this->bufferMutex);
+
+        xTaskNotifyGive(this->writerHandle);
+    };
+
+    void EndSession(time_t time)
+    {
+        if (!this->Ready())
+        {
+            return;
+        }
+
+        xSemaphoreTake(this->bufferMutex, portMAX_DELAY);
+        if (this->sessionId != 0)
+        {
+            this->appendRecord(RecordEnd, time, NULL, 0);
+            this->sessionId = 0;
+        }
+        xSemaphoreGive(this->bufferMutex);
+
+        xTaskNotifyGive(this->writerHandle);
+    };
+
+    // samples and events outside of a session are not logged
+    void AddSample(time_t time, int16_t temp, int16_t target, uint8_t output)
+    {
+        uint8_t payload[5];
+        memcpy(payload, &temp, 2);
+        memcpy(payload + 2, &target, 2);
+        payload[4] = output;
+        this->add(RecordSample, time, payload, sizeof(payload));
+    };
+
+    void AddEvent(time_t time, const string &message)
+    {
+        string text = message.substr(0, BREWLOG_MAX_TEXT);
+        this->add(RecordEvent, time, (const uint8_t *)text.data(), text.size());
+    };
+
+    // writes what is buffered, called by the writer task, but also before we read so the running session is complete
+    void Flush()
+    {
+        if (!this->Ready())
+        {
+            return;
+        }
+
+        xSemaphoreTake(this->ioMutex, portMAX_DELAY);
+
+        xSemaphoreTake(this->bufferMutex, portMAX_DELAY);
+        vector<uint8_t> records;
+        records.swap(this->buffer);
+        xSemaphoreGive(this->bufferMutex);
+
+        // records never span sectors, what fits in the current sector goes in one write
+        size_t position = 0;
+        while (position < records.size())
+        {
+            if (!this->sectorOpen || this->writeOffset + recordSize(records[position + 1]) > BREWLOG_SECTOR_SIZE)
+            {
+                // the next flush tries the sector after it
+                if (this->nextSector() != ESP_OK)
+                {
+                    this->lose(records, position, records.size());
+                    break;
+                }
+            }
+
+            size_t end = position;
+            while (end < records.size() && this->writeOffset + (end - position) + recordSize(records[end + 1]) <= BREWLOG_SECTOR_SIZE)
+            {
+                // we keep the running session, so it can be repeated in the next sector
+                if (records[end] == RecordSession)
+                {
+                    this->sessionRecord.assign(records.begin() + end, records.begin() + end + recordSize(records[end + 1]));
+                }
+                else if (records[end] == RecordEnd)
+                {
+                    this->sessionRecord.clear();
+                }
+                end += recordSize(records[end + 1]);
+            }
+
+            esp_err_t err = esp_partition_write(this->partition, this->writeSector * BREWLOG_SECTOR_SIZE + this->writeOffset, records.data() + position, end - position);
+            if (err != ESP_OK)
+            {
+                // we don't know what is on flash after the write offset now, so the next records go to a new sector
+                ESP_LOGW(BREWLOG_TAG, "Writing sector %lu failed: %s", this->writeSector, esp_err_to_name(err));
+                this->stats.writeErrors++;
+                this->sectorOpen = false;
+                this->lose(records, position, end);
+            }
+            else
+            {
+                this->writeOffset += end - position;
+            }
+            position = end;
+        }
+
+        xSemaphoreGive(this->ioMutex);
+    };
+
+    WriteStats Stats()
+    {
+        if (!this->Ready())
+        {
+            return {};
+        }
+
+        xSemaphoreTake(this->ioMutex, portMAX_DELAY);
+        WriteStats stats = this->stats;
+        xSemaphoreGive(this->ioMutex);
+
+        return stats;
+    };
+
+    // all sessions still in the log, oldest first
+    vector<Session> Sessions()
+    {
+        vector<Session> sessions;
+        if (!this->Ready())
+        {
+            return sessions;
+        }
+
+        this->Flush();
+
+        bool open = false; // the last session in sessions is still getting records
+        this->scan([&sessions, &open](uint8_t type, const uint8_t *payload, uint8_t length)
+                   {
+                       if (length < 4)
+                       {
+                           return;
+                       }
+                       time_t time = readUint32(payload);
+
+                       if (type == RecordSession && length >= 8)
+                       {
+                           uint32_t id = readUint32(payload + 4);
+                           if (open && sessions.back().id == id)
+                           {
+                               return; // continues in the next sector
+                           }
+                           sessions.push_back({id, string((const char *)payload + 8, length - 8), time, time, false, 0, 0});
+                           open = true;
+                           return;
+                       }
+
+                       // records of a session that started in a sector that was already erased
+                       if (!open)
+                       {
+                           return;
+                       }
+
+                       Session *current = &sessions.back();
+                       current->end = time;
+                       if (type == RecordSample)
+                       {
+                           current->samples++;
+                       }
+                       else if (type == RecordEvent)
+                       {
+                           current->events++;
+                       }
+                       else if (type == RecordEnd)
+                       {
+                           current->complete = true;
+                           open = false;
+                       } });
+
+        return sessions;
+    };
+
+    // streams the samples and events of a session, false when the session is not in the log
+    bool ReadSession(uint32_t id, const std::function<void(const Sample &sample)> &onSample, const std::function<void(const Event &event)> &onEvent)
+    {
+        if (!this->Ready())
+        {
+            return false;
+        }
+
+        this->Flush();
+
+        bool found = false;
+        uint32_t current = 0;
+        this->scan([&](uint8_t type, const uint8_t *payload, uint8_t length)
+                   {
+                       if (length < 4)
+                       {
+                           return;
+                       }
+                       time_t time = readUint32(payload);
+
+                       if (type == RecordSession && length >= 8)
+                       {
+                           current = readUint32(payload + 4);
+                           found = found || current == id;
+                       }
+                       else if (current != id)
+                       {
+                           return;
+                       }
+                       else if (type == RecordSample && length >= 9)
+                       {
+                           Sample sample;
+                           sample.time = time;
+                           memcpy(&sample.temp, payload + 4, 2);
+                           memcpy(&sample.target, payload + 6, 2);
+                           sample.output = payload[8];
+                           onSample(sample);
+                       }
+                       else if (type == RecordEvent)
+                       {
+                           onEvent({time, string((const char *)payload + 4, length - 4)});
+                       }
+                       else if (type == RecordEnd)
+                       {
+                           current = 0;
+                       } });
+
+        return found;
+    };
+
+    size_t Size()
+    {
+        return this->Ready() ? this->partition->size : 0;
+    };
+
+protected:
+private:
+    struct SectorHeader
+    {
+        uint32_t magic;
+        uint32_t seq;
+        uint32_t crc;
+    };
+
+    const esp_partition_t *partition = NULL;
+    uint32_t sectorCount = 0;
+    SemaphoreHandle_t bufferMutex; // guards the buffer and session
+    SemaphoreHandle_t ioMutex;     // guards the flash and write position
+    TaskHandle_t writerHandle = NULL;
+
+    vector<uint8_t> buffer; // encoded records waiting to be written
+    uint32_t sessionId = 0; // 0 when no session is running
+    uint32_t nextSessionId = 1;
+
+    // write position, only used with ioMutex
+    uint32_t writeSector = 0;
+    uint32_t writeOffset = 0;
+    uint32_t sectorSeq = 0;
+    bool sectorOpen = false;
+    vector<uint8_t> sessionRecord; // last written session record, repeated in every new sector
+    WriteStats stats = {};
+
+    static void writerLoop(void *arg)
+    {
+        BrewLog *instance = (BrewLog *)arg;
+
+        while (true)
+        {
+            ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(BREWLOG_FLUSH_INTERVAL));
+            instance->Flush();
+        }
+    };
+
+    void add(BrewLogRecordType type, time_t time, const uint8_t *data, size_t length)
+    {
+        if (!this->Ready())
+        {
+            return;
+        }
+
+        xSemaphoreTake(this->bufferMutex, portMAX_DELAY);
+        bool added = this->sessionId != 0;
+        if (added)
+        {
+            this->appendRecord(type, time, data, length);
+        }
+        bool full = this->buffer.size() >= BREWLOG_PAGE_SIZE;
+        xSemaphoreGive(this->bufferMutex);
+
+        if (added && full)
+        {
+            xTaskNotifyGive(this->writerHandle);
+        }
+    };
+
+    // needs bufferMutex
+    void openSession(uint32_t id, time_t time, const string &name)
+    {
+        if (this->sessionId != 0 && this->sessionId != id)
+        {
+            this->appendRecord(RecordEnd, time, NULL, 0);
+        }
+        this->sessionId = id;
+
+        uint8_t payload[4];
+        writeUint32(payload, id);
+        string text = name.substr(0, BREWLOG_MAX_TEXT);
+        vector<uint8_t> extra(payload, payload + sizeof(payload));
+        extra.insert(extra.end(), text.begin(), text.end());
+        this->appendRecord(RecordSession, time, extra.data(), extra.size());
+    };
+
+    // every payload starts with the time, needs bufferMutex
+    void appendRecord(BrewLogRecordType type, time_t time, const uint8_t *data, size_t length)
+    {
+        size_t start = this->buffer.size();
+        this->buffer.push_back(type);
+        this->buffer.push_back(4 + length);
+        this->buffer.resize(start + 6);
+        writeUint32(&this->buffer[start + 2], (uint32_t)time);
+        if (length > 0)
+        {
+            this->buffer.insert(this->buffer.end(), data, data + length);
+        }
+
+        uint8_t crc[4];
+        writeUint32(crc, esp_rom_crc32_le(0, &this->buffer[start], this->buffer.size() - start));
+        this->buffer.insert(this->buffer.end(), crc, crc + 4);
+    };
+
+    // erases the next (oldest) sector, a running session is repeated at its start, needs ioMutex
+    // on an error the sector stays closed, so nothing is written after a header or session record that isn't there
+    esp_err_t nextSector()
+    {
+        this->writeSector = (this->writeSector + 1) % this->sectorCount;
+        this->sectorSeq++;
+        this->sectorOpen = false;
+
+        size_t address = this->writeSector * BREWLOG_SECTOR_SIZE;
+        esp_err_t err = esp_partition_erase_range(this->partition, address, BREWLOG_SECTOR_SIZE);
+        if (err != ESP_OK)
+        {
+            ESP_LOGW(BREWLOG_TAG, "Erasing sector %lu failed: %s", this->writeSector, esp_err_to_name(err));
+            this->stats.eraseErrors++;
+            return err;
+        }
+
+        SectorHeader header;
+        header.magic = BREWLOG_MAGIC;
+        header.seq = this->sectorSeq;
+        header.crc = esp_rom_crc32_le(0, (const uint8_t *)&header, offsetof(SectorHeader, crc));
+        err = esp_partition_write(this->partition, address, &header, sizeof(header));
+
+        if (err == ESP_OK && !this->sessionRecord.empty())
+        {
+            err = esp_partition_write(this->partition, address + sizeof(header), this->sessionRecord.data(), this->sessionRecord.size());
+        }
+
+        if (err != ESP_OK)
+        {
+            ESP_LOGW(BREWLOG_TAG, "Writing sector %lu failed: %s", this->writeSector, esp_err_to_name(err));
+            this->stats.writeErrors++;
+            return err;
+        }
+
+        this->writeOffset = sizeof(header) + this->sessionRecord.size();
+        this->sectorOpen = true;
+
+        return ESP_OK;
+    };
+
+    // counts the records from start to end that didn't make it to flash, needs ioMutex
+    void lose(const vector<uint8_t> &records, size_t start, size_t end)
+    {
+        uint32_t count = 0;
+        for (size_t position = start; position < end; position += recordSize(records[position + 1]))
+        {
+            count++;
+        }
+        this->stats.lostRecords += count;
+
+        ESP_LOGW(BREWLOG_TAG, "%lu record(s) lost", count);
+    };
+
+    // sector index and seq of all valid sectors, oldest first
+    vector<std::pair<uint32_t, uint32_t>> sectorsInOrder()
+    {
+        vector<std::pair<uint32_t, uint32_t>> sectors;
+        for (uint32_t sector = 0; sector < this->sectorCount; sector++)
+        {
+            SectorHeader header;
+            if (esp_partition_read(this->partition, sector * BREWLOG_SECTOR_SIZE, &header, sizeof(header)) != ESP_OK)
+            {
+                continue;
+            }
+
+            if (header.magic == BREWLOG_MAGIC && header.crc == esp_rom_crc32_le(0, (const uint8_t *)&header, offsetof(SectorHeader, crc)))
+            {
+                sectors.push_back({sector, header.seq});
+            }
+        }
+
+        std::sort(sectors.begin(), sectors.end(), [](auto const &a, auto const &b)
+                  { return a.second < b.second; });
+        return sectors;
+    };
+
+    // calls callback with every valid record in the order they were written, a sector stops at the first bad record
+    void scan(const std::function<void(uint8_t type, const uint8_t *payload, uint8_t length)> &callback)
+    {
+        auto data = std::make_unique<uint8_t[]>(BREWLOG_SECTOR_SIZE);
+
+        xSemaphoreTake(this->ioMutex, portMAX_DELAY);
+
+        for (auto const &[sector, seq] : this->sectorsInOrder())
+        {
+            if (esp_partition_read(this->partition, sector * BREWLOG_SECTOR_SIZE, data.get(), BREWLOG_SECTOR_SIZE) != ESP_OK)
+            {
+                continue;
+            }
+
+            size_t position = sizeof(SectorHeader);
+            while (position + 2 <= BREWLOG_SECTOR_SIZE && data[position] != RecordFree)
+            {
+                uint8_t length = data[position + 1];
+                if (position + recordSize(length) > BREWLOG_SECTOR_SIZE)
+                {
+                    break;
+                }
+
+                uint32_t crc = readUint32(&data[position + 2 + length]);
+                if (crc != esp_rom_crc32_le(0, &data[position], 2 + length))
+                {
+                    break;
+                }
+
+                callback(data[position], &data[position + 2], length);
+                position += recordSize(length);
+            }
+        }
+
+        xSemaphoreGive(this->ioMutex);
+    };
+
+    // type, length, payload and crc
+    static size_t recordSize(uint8_t length)
+    {
+        return 2 + length + 4;
+    };
+
+    static uint32_t readUint32(const uint8_t *data)
+    {
+        uint32_t value;
+        memcpy(&value, data, 4);
+        return value;
+    };
+
+    static void writeUint32(uint8_t *data, uint32_t value)
+    {
+        memcpy(data, &value, 4);
+    };
+};
+
+#endif /* _BrewLog_H_ */
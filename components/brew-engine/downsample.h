@@ -0,0 +1,185 @@
+#ifndef _Downsample_H_
+#define _Downsample_H_
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <ctime>
+#include <functional>
+#include <vector>
+
+using namespace std;
+
+// Largest-Triangle-Three-Buckets, keeps the points that shape the line most so a short chart still shows peaks and dips.
+// Points are fed in time order and emitted as soon as they are picked, only two buckets are kept in memory.
+// The first value of a row decides which rows are kept, the other values come along so the columns stay aligned.
+// Both buckets are sized once for the rows of a bucket, so feeding rows doesn't allocate.
+// Every row has a sequence nr that is handed back with it, so a caller can find the picked rows again.
+class Downsampler
+{
+public:
+    Downsampler(uint32_t total, uint32_t maxPoints, size_t channels, const std::function<void(uint32_t seq, time_t time, const int16_t *values)> &emit)
+    {
+        this->total = total;
+        this->maxPoints = maxPoints;
+        this->channels = channels;
+        this->emit = emit;
+
+        // below 3 points there are no buckets, we just pass everything
+        this->passThrough = maxPoints < 3 || total <= maxPoints;
+        if (!this->passThrough)
+        {
+            this->every = (double)(total - 2) / (maxPoints - 2);
+
+            uint32_t rows = (uint32_t)std::ceil(this->every) + 1;
+            this->current.Resize(rows, channels);
+            this->next.Resize(rows, channels);
+        }
+    };
+
+    // values has a value for every channel, it's copied so the caller can reuse it
+    void Add(uint32_t seq, time_t time, const int16_t *values)
+    {
+        uint32_t index = this->count++;
+
+        if (this->passThrough || index == 0)
+        {
+            this->emitRow(seq, time, values);
+            return;
+        }
+
+        if (index >= this->total - 1)
+        {
+            // the last point closes the last bucket(s) and is always kept
+            if (this->next.rows > 0)
+            {
+                this->selectCurrent(this->average(this->next));
+                std::swap(this->current, this->next);
+                this->next.rows = 0;
+            }
+            if (this->current.rows > 0)
+            {
+                this->selectCurrent({(double)time, (double)values[0]});
+            }
+            this->emitRow(seq, time, values);
+            return;
+        }
+
+        uint32_t bucket = std::min<uint32_t>(this->maxPoints - 3, (uint32_t)((index - 1) / this->every));
+
+        if (this->current.rows == 0 || bucket == this->current.index)
+        {
+            this->current.index = bucket;
+            this->current.Push(seq, time, values, this->channels);
+        }
+        else if (this->next.rows == 0 || bucket == this->next.index)
+        {
+            this->next.index = bucket;
+            this->next.Push(seq, time, values, this->channels);
+        }
+        else
+        {
+            // a third bucket starts, so the next one is complete and we can pick from the current one
+            this->selectCurrent(this->average(this->next));
+            std::swap(this->current, this->next);
+            this->next.rows = 0;
+            this->next.index = bucket;
+            this->next.Push(seq, time, values, this->channels);
+        }
+    };
+
+protected:
+private:
+    struct Point
+    {
+        double x;
+        double y;
+    };
+
+    // the rows of a bucket, values are flat with the channels of a row next to each other
+    struct Bucket
+    {
+        uint32_t index = 0;
+        uint32_t rows = 0;
+        vector<uint32_t> seqs;
+        vector<time_t> times;
+        vector<int16_t> values;
+
+        void Resize(uint32_t rows, size_t channels)
+        {
+            this->seqs.resize(rows);
+            this->times.resize(rows);
+            this->values.resize(rows * channels);
+        };
+
+        void Push(uint32_t seq, time_t time, const int16_t *values, size_t channels)
+        {
+            // rounding could give a bucket one row more than we sized for
+            if (this->rows == this->times.size())
+            {
+                this->Resize(this->rows + 1, channels);
+            }
+
+            this->seqs[this->rows] = seq;
+            this->times[this->rows] = time;
+            std::copy(values, values + channels, this->values.begin() + this->rows * channels);
+            this->rows++;
+        };
+    };
+
+    uint32_t total;
+    uint32_t maxPoints;
+    size_t channels;
+    std::function<void(uint32_t seq, time_t time, const int16_t *values)> emit;
+    bool passThrough;
+    double every = 1;
+    uint32_t count = 0;
+
+    Point selected;
+    Bucket current;
+    Bucket next;
+
+    void emitRow(uint32_t seq, time_t time, const int16_t *values)
+    {
+        this->selected = {(double)time, (double)values[0]};
+        this->emit(seq, time, values);
+    };
+
+    Point average(const Bucket &bucket)
+    {
+        Point average = {0, 0};
+        for (uint32_t i = 0; i < bucket.rows; i++)
+        {
+            average.x += bucket.times[i];
+            average.y += bucket.values[i * this->channels];
+        }
+        average.x /= bucket.rows;
+        average.y /= bucket.rows;
+        return average;
+    };
+
+    // keeps the row that makes the biggest triangle with the last kept point and the average of the next bucket
+    void selectCurrent(Point next)
+    {
+        double maxArea = -1;
+        int64_t best = -1;
+
+        for (uint32_t i = 0; i < this->current.rows; i++)
+        {
+            double area = std::abs((this->selected.x - next.x) * (this->current.values[i * this->channels] - this->selected.y) -
+                                   (this->selected.x - this->current.times[i]) * (next.y - this->selected.y));
+            if (area > maxArea)
+            {
+                maxArea = area;
+                best = i;
+            }
+        }
+
+        if (best >= 0)
+        {
+            this->emitRow(this->current.seqs[best], this->current.times[best], this->current.values.data() + best * this->channels);
+        }
+    };
+};
+
+#endif /* _Downsample_H_ */
@@ -0,0 +1,92 @@
+#ifndef _DS18B20Driver_H_
+#define _DS18B20Driver_H_
+
+#include "esp_timer.h"
+#include "onewire_bus.h"
+#include "ds18b20.h"
+#include "sensor-driver.h"
+
+// 1-Wire commands we send ourselfs, the ds18b20 component only addresses single devices
+#define ONEWIRE_SKIP_ROM 0xCC
+#define DS18B20_CONVERT_T 0x44
+
+class DS18B20Driver : public SensorDriver
+{
+public:
+    DS18B20Driver(ds18b20_device_handle_t handle)
+    {
+        this->handle = handle;
+    };
+
+    ~DS18B20Driver()
+    {
+        ds18b20_del_device(this->handle);
+    };
+
+    // Skip ROM addresses all devices, so every DS18B20 on the bus starts its conversion at once
+    static esp_err_t StartAll(onewire_bus_handle_t bus)
+    {
+        // reset also checks if there is any device present on the bus
+        esp_err_t err = onewire_bus_reset(bus);
+        if (err != ESP_OK)
+        {
+            return err;
+        }
+
+        const uint8_t tx_buffer[] = {ONEWIRE_SKIP_ROM, DS18B20_CONVERT_T};
+        return onewire_bus_write_bytes(bus, tx_buffer, sizeof(tx_buffer));
+    };
+
+    // the conversion itself is started for the whole bus by StartAll, we only keep track of time
+    esp_err_t Start() override
+    {
+        this->startTime = esp_timer_get_time();
+        return ESP_OK;
+    };
+
+    bool Poll() override
+    {
+        return (esp_timer_get_time() - this->startTime) >= (this->ConversionTime() * 1000);
+    };
+
+    // only reads the scratchpad, conversion must be done
+    esp_err_t Read(float &temperature) override
+    {
+        return ds18b20_get_temperature(this->handle, &temperature);
+    };
+
+    // max conversion time in ms from the datasheet
+    uint16_t ConversionTime() override
+    {
+        switch (this->resolution)
+        {
+        case 9:
+            return 94;
+        case 10:
+            return 188;
+        case 11:
+            return 375;
+        default:
+            return 750;
+        }
+    };
+
+    esp_err_t SetResolution(uint8_t resolution) override
+    {
+        // resolution is written to the scratchpad, so this needs to happen before a conversion starts
+        esp_err_t err = ds18b20_set_resolution(this->handle, (ds18b20_resolution_t)(resolution - 9));
+        if (err == ESP_OK)
+        {
+            this->resolution = resolution;
+        }
+        return err;
+    };
+
+protected:
+private:
+    ds18b20_device_handle_t handle;
+    uint8_t resolution = 12;
+    int64_t startTime = 0;
+};
+
+#endif /* _DS18B20Driver_H_ */
@@ -29,6 +29,14 @@ public:
         return jStep;
     };
 
+    void from_json(const json &jsonData)
+    {
+        this->temperature = jsonData["temperature"].get<float>();
+        this->time = system_clock::from_time_t(jsonData["time"].get<time_t>());
+        this->extendIfNeeded = jsonData["extendIfNeeded"].get<bool>();
+        this->allowBoost = jsonData["allowBoost"].get<bool>();
+    };
+
 protected:
 private:
 };
@@ -0,0 +1,251 @@
+#ifndef _GzipWriter_H_
+#define _GzipWriter_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include "esp_err.h"
+#include "esp_rom_crc.h"
+
+using namespace std;
+
+#define GZIP_WINDOW_SIZE 2048 // max distance of a match, the input buffer is twice this
+#define GZIP_HASH_BITS 10     // 1024 hash heads
+#define GZIP_OUTPUT_SIZE 512  // compressed data is flushed in chunks of this size
+#define GZIP_MIN_MATCH 3
+#define GZIP_MAX_MATCH 258
+
+// Streaming gzip with a small lz77 window and the fixed huffman codes of deflate, so all memory is in the object.
+// The rom miniz compressor needs over 300KB of state, this one under 7KB, repetitive json still shrinks to a fraction.
+// Begin starts a stream, Write takes any amount of input, Finish sends the rest and the gzip trailer.
+// Like JsonWriter the first flush error is kept, later writes are dropped and Finish returns it.
+class GzipWriter
+{
+public:
+    void Begin(const std::function<esp_err_t(const char *data, size_t length)> &flush)
+    {
+        this->flush = flush;
+        this->err = ESP_OK;
+        this->crc = 0;
+        this->inputSize = 0;
+        this->start = 0;
+        this->end = 0;
+        this->bits = 0;
+        this->bitCount = 0;
+        this->used = 0;
+        std::fill(std::begin(this->head), std::end(this->head), -1);
+
+        // gzip header without name or time, unix as os
+        static const uint8_t header[] = {0x1F, 0x8B, 8, 0, 0, 0, 0, 0, 0, 3};
+        std::copy(std::begin(header), std::end(header), this->output);
+        this->used = sizeof(header);
+
+        // everything is one final block with fixed codes
+        this->putBits(1, 1);
+        this->putBits(1, 2);
+    };
+
+    esp_err_t Write(const char *data, size_t length)
+    {
+        this->crc = esp_rom_crc32_le(this->crc, (const uint8_t *)data, length);
+        this->inputSize += length;
+
+        while (length > 0 && this->err == ESP_OK)
+        {
+            if (this->end == sizeof(this->window))
+            {
+                this->slide();
+            }
+
+            size_t part = std::min(length, sizeof(this->window) - this->end);
+            memcpy(this->window + this->end, data, part);
+            this->end += part;
+            data += part;
+            length -= part;
+
+            // keep a max match of lookahead, so a match is never cut off by the chunk boundary
+            this->compress(GZIP_MAX_MATCH);
+        }
+
+        return this->err;
+    };
+
+    esp_err_t Finish()
+    {
+        this->compress(0);
+        this->putSymbol(256); // end of block
+
+        // to a byte boundary, then crc and size of the input, little endian
+        if (this->bitCount > 0)
+        {
+            this->putBits(0, 8 - this->bitCount);
+        }
+        for (uint32_t value : {this->crc, this->inputSize})
+        {
+            this->putBits(value & 0xFFFF, 16);
+            this->putBits(value >> 16, 16);
+        }
+
+        this->flushOutput();
+        return this->err;
+    };
+
+protected:
+private:
+    std::function<esp_err_t(const char *data, size_t length)> flush;
+    esp_err_t err = ESP_OK;
+    uint32_t crc = 0;
+    uint32_t inputSize = 0;
+
+    uint8_t window[GZIP_WINDOW_SIZE * 2]; // the last window of input and what is not compressed yet
+    uint16_t start = 0;                   // first byte that is not compressed yet
+    uint16_t end = 0;                     // end of the input
+    int16_t head[1 << GZIP_HASH_BITS];    // last position of every hash of 3 bytes, -1 when none
+
+    uint32_t bits = 0;
+    uint8_t bitCount = 0;
+    uint8_t output[GZIP_OUTPUT_SIZE];
+    size_t used = 0;
+
+    // compresses until only lookahead bytes are left, greedy with a single candidate per hash
+    void compress(uint16_t lookahead)
+    {
+        while (this->end - this->start > lookahead && this->err == ESP_OK)
+        {
+            uint16_t available = std::min(this->end - this->start, GZIP_MAX_MATCH);
+            uint16_t length = 0;
+            uint16_t distance = 0;
+
+            if (available >= GZIP_MIN_MATCH)
+            {
+                uint16_t hash = this->hash(this->start);
+                int16_t candidate = this->head[hash];
+                this->head[hash] = this->start;
+
+                if (candidate >= 0 && this->start - candidate <= GZIP_WINDOW_SIZE)
+                {
+                    while (length < available && this->window[candidate + length] == this->window[this->start + length])
+                    {
+                        length++;
+                    }
+                    distance = this->start - candidate;
+                }
+            }
+
+            if (length < GZIP_MIN_MATCH)
+            {
+                this->putSymbol(this->window[this->start]);
+                this->start++;
+                continue;
+            }
+
+            this->putMatch(length, distance);
+
+            // the skipped positions are hashed too, they are the most likely next matches
+            for (uint16_t i = 1; i < length; i++)
+            {
+                if (this->end - (this->start + i) >= GZIP_MIN_MATCH)
+                {
+                    this->head[this->hash(this->start + i)] = this->start + i;
+                }
+            }
+            this->start += length;
+        }
+    };
+
+    // the first half of the buffer is dropped, the hash heads that point there are forgotten
+    void slide()
+    {
+        memmove(this->window, this->window + GZIP_WINDOW_SIZE, GZIP_WINDOW_SIZE);
+        this->start -= GZIP_WINDOW_SIZE;
+        this->end -= GZIP_WINDOW_SIZE;
+
+        for (int16_t &position : this->head)
+        {
+            position = position >= GZIP_WINDOW_SIZE ? position - GZIP_WINDOW_SIZE : -1;
+        }
+    };
+
+    uint16_t hash(uint16_t position)
+    {
+        uint32_t bytes = this->window[position] << 16 | this->window[position + 1] << 8 | this->window[position + 2];
+        return (bytes * 2654435761u) >> (32 - GZIP_HASH_BITS);
+    };
+
+    // fixed huffman code of a literal, length or end of block symbol
+    void putSymbol(uint16_t symbol)
+    {
+        if (symbol < 144)
+        {
+            this->putCode(0x30 + symbol, 8);
+        }
+        else if (symbol < 256)
+        {
+            this->putCode(0x190 + symbol - 144, 9);
+        }
+        else if (symbol < 280)
+        {
+            this->putCode(symbol - 256, 7);
+        }
+        else
+        {
+            this->putCode(0xC0 + symbol - 280, 8);
+        }
+    };
+
+    void putMatch(uint16_t length, uint16_t distance)
+    {
+        static const uint16_t lengthBase[] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+        static const uint8_t lengthExtra[] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+        static const uint16_t distanceBase[] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+        static const uint8_t distanceExtra[] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+        uint8_t code = std::upper_bound(std::begin(lengthBase), std::end(lengthBase), length) - std::begin(lengthBase) - 1;
+        this->putSymbol(257 + code);
+        this->putBits(length - lengthBase[code], lengthExtra[code]);
+
+        code = std::upper_bound(std::begin(distanceBase), std::end(distanceBase), distance) - std::begin(distanceBase) - 1;
+        this->putCode(code, 5);
+        this->putBits(distance - distanceBase[code], distanceExtra[code]);
+    };
+
+    // huffman codes go out most significant bit first, the rest of deflate least significant first
+    void putCode(uint16_t code, uint8_t length)
+    {
+        uint16_t reversed = 0;
+        for (uint8_t i = 0; i < length; i++)
+        {
+            reversed = reversed << 1 | ((code >> i) & 1);
+        }
+        this->putBits(reversed, length);
+    };
+
+    void putBits(uint32_t value, uint8_t count)
+    {
+        this->bits |= value << this->bitCount;
+        this->bitCount += count;
+
+        while (this->bitCount >= 8)
+        {
+            if (this->used == sizeof(this->output))
+            {
+                this->flushOutput();
+            }
+            this->output[this->used++] = this->bits & 0xFF;
+            this->bits >>= 8;
+            this->bitCount -= 8;
+        }
+    };
+
+    void flushOutput()
+    {
+        if (this->used > 0 && this->err == ESP_OK)
+        {
+            this->err = this->flush((const char *)this->output, this->used);
+        }
+        this->used = 0;
+    };
+};
+
+#endif /* _GzipWriter_H_ */
@@ -2,6 +2,7 @@
 #define _Heater_H_
 
 #include "nlohmann_json.hpp"
+#include "json-check.h"
 
 using namespace std;
 using json = nlohmann::json;
@@ -19,6 +20,8 @@ public:
     uint8_t burnTime; // runtime burn Time flag, doesn't go to json, in %
     bool burn;        // runtime burn flag true means burn now
     bool enabled;     // runtime flag to make it easyer to filter in loops, is set based on mode and mash/boil
+    bool on = false;     // runtime, level the output loop set
+    uint32_t onTime = 0; // runtime, ms the output was on since the heater was loaded, for metrics
 
     json to_json()
     {
@@ -34,6 +37,12 @@ public:
         return jHeater;
     };
 
+    // what from_json needs, the id is given by saveHeaterSettings
+    static JsonCheck check_json(const json &jsonData)
+    {
+        return JsonCheck(jsonData).String("name").Number("preference").Number("pinNr");
+    };
+
     void from_json(const json &jsonData)
     {
         this->id = jsonData["id"].get<uint>();
@@ -41,7 +50,7 @@ public:
         this->preference = jsonData["preference"].get<uint>();
         this->pinNr = (gpio_num_t)jsonData["pinNr"].get<uint>();
 
-        if (!jsonData["watt"].is_null() && jsonData["watt"].is_number())
+        if (jsonData.contains("watt") && jsonData["watt"].is_number())
         {
             this->watt = (uint16_t)jsonData["watt"];
         }
@@ -50,7 +59,7 @@ public:
             this->watt = 0;
         }
 
-        if (!jsonData["useForMash"].is_null() && jsonData["useForMash"].is_boolean())
+        if (jsonData.contains("useForMash") && jsonData["useForMash"].is_boolean())
         {
             this->useForMash = jsonData["useForMash"];
         }
@@ -59,7 +68,7 @@ public:
             this->useForMash = true;
         }
 
-        if (!jsonData["useForBoil"].is_null() && jsonData["useForBoil"].is_boolean())
+        if (jsonData.contains("useForBoil") && jsonData["useForBoil"].is_boolean())
         {
             this->useForBoil = jsonData["useForBoil"];
         }
@@ -0,0 +1,19 @@
+#ifndef _HostTest_H_
+#define _HostTest_H_
+
+#include <cstdio>
+
+// a failed check is printed and counted, main returns the count so ctest sees the failure
+static int failures = 0;
+
+#define CHECK(condition)                                                          \
+    do                                                                            \
+    {                                                                             \
+        if (!(condition))                                                         \
+        {                                                                         \
+            std::printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+            failures++;                                                           \
+        }                                                                         \
+    } while (0)
+
+#endif /* _HostTest_H_ */
@@ -0,0 +1,158 @@
+// Checks JsonCheck and the checks of the schedule models, then breaks a valid schedule in random ways:
+// whatever passes the check has to load without an exception, on the controller that would be a restart.
+#include <random>
+#include "host-test.h"
+#include "mash-schedule.h"
+
+static const json schedule = {
+    {"name", "Single Infusion"},
+    {"boil", false},
+    {"steps", {
+                  {{"index", 0}, {"name", "Mash In"}, {"temperature", 66}, {"stepTime", 5}, {"time", 0}, {"extendStepTimeIfNeeded", true}},
+                  {{"index", 1}, {"name", "Rest"}, {"temperature", 66}, {"stepTime", 60}, {"time", 5}, {"extendStepTimeIfNeeded", false}, {"allowBoost", true}},
+              }},
+    {"notifications", {
+                          {{"name", "Add grain"}, {"timeFromStart", 5}, {"buzzer", true}, {"message", "now"}},
+                      }},
+};
+
+static void fields()
+{
+    json data = {{"kP", 10}, {"name", "x"}, {"boil", true}, {"empty", nullptr}};
+
+    CHECK(JsonCheck(data).Number("kP").String("name").Bool("boil").Valid());
+    CHECK(JsonCheck(data).Number("missing", false).String("empty", false).Valid());
+
+    JsonCheck wrongType = JsonCheck(json{{"kP", "x"}}).Number("kP");
+    CHECK(!wrongType.Valid());
+    CHECK(wrongType.Error() == "kP: number expected");
+
+    // the first field that fails is kept
+    JsonCheck missing = JsonCheck(data).Number("kI").String("kP");
+    CHECK(missing.Error() == "kI: number expected");
+
+    // optional fields still need the right type
+    CHECK(!JsonCheck(data).Bool("name", false).Valid());
+
+    CHECK(JsonCheck(json(5)).Error() == "object expected");
+    CHECK(JsonCheck(json::array()).Error() == "object expected");
+}
+
+static void models()
+{
+    CHECK(MashSchedule::check_json(schedule).Valid());
+
+    json data = schedule;
+    data["steps"][1]["name"] = 3;
+    CHECK(MashSchedule::check_json(data).Error() == "steps[1].name: string expected");
+
+    data = schedule;
+    data["notifications"][0] = "beep";
+    CHECK(MashSchedule::check_json(data).Error() == "notifications[0]: object expected");
+
+    data = schedule;
+    data.erase("steps");
+    CHECK(MashSchedule::check_json(data).Error() == "steps: array expected");
+
+    CHECK(JsonCheck::Items(json::array({schedule["steps"][0]}), MashStep::check_json).Valid());
+    CHECK(JsonCheck::Items(schedule, MashStep::check_json).Error() == "array expected");
+    CHECK(JsonCheck::Items(json::array({1}), MashStep::check_json).Error() == "[0]: object expected");
+}
+
+// loads a schedule like BrewEngine::setMashSchedule does
+static bool load(const json &data)
+{
+    try
+    {
+        MashSchedule mash;
+        mash.name = data["name"].get<string>();
+        mash.boil = data["boil"].get<bool>();
+        for (auto const &jStep : data["steps"])
+        {
+            MashStep step;
+            step.from_json(jStep);
+        }
+        for (auto const &jNotification : data["notifications"])
+        {
+            Notification notification;
+            notification.from_json(jNotification);
+        }
+        return true;
+    }
+    catch (const std::exception &e)
+    {
+        std::printf("%s: %s\n", data.dump().c_str(), e.what());
+        return false;
+    }
+}
+
+// replaces or removes a random value somewhere in the schedule
+static void mutate(json &data, std::minstd_rand &generator)
+{
+    static const json values[] = {nullptr, 1, -1, 2.5, "text", true, json::array(), json::object()};
+
+    json *target = &data;
+    while (true)
+    {
+        bool container = target->is_object() || target->is_array();
+        if (!container || target->empty() || generator() % 3 == 0)
+        {
+            break;
+        }
+
+        size_t index = generator() % target->size();
+        if (target->is_object())
+        {
+            auto it = target->begin();
+            std::advance(it, index);
+            if (generator() % 4 == 0)
+            {
+                target->erase(it);
+                return;
+            }
+            target = &it.value();
+        }
+        else
+        {
+            target = &(*target)[index];
+        }
+    }
+
+    *target = values[generator() % std::size(values)];
+}
+
+static void brokenSchedules()
+{
+    std::minstd_rand generator(7);
+    int rejected = 0;
+
+    for (int i = 0; i < 5000; i++)
+    {
+        json data = schedule;
+        for (int n = 1 + generator() % 3; n > 0; n--)
+        {
+            mutate(data, generator);
+        }
+
+        if (MashSchedule::check_json(data).Valid())
+        {
+            CHECK(load(data));
+        }
+        else
+        {
+            rejected++;
+        }
+    }
+
+    // most changes break something, but not all of them, a step without allowBoost is fine
+    CHECK(rejected > 1000 && rejected < 5000);
+}
+
+int main()
+{
+    fields();
+    models();
+    brokenSchedules();
+
+    return failures;
+}
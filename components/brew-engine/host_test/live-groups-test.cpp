@@ -0,0 +1,320 @@
+// Pushes live fields like BrewEngine::pushLoop, once the old way with a json tree per push and once with LiveGroups,
+// checks they send the same and counts what a push allocates.
+#include <chrono>
+#include <cstdlib>
+#include <new>
+#include "host-test.h"
+#include "live-groups.h"
+#include "nlohmann_json.hpp"
+
+using json = nlohmann::json;
+
+static size_t allocations = 0;
+static size_t allocatedBytes = 0;
+
+void *operator new(size_t size)
+{
+    allocations++;
+    allocatedBytes += size;
+    void *pointer = std::malloc(size);
+    if (!pointer)
+    {
+        throw std::bad_alloc();
+    }
+    return pointer;
+}
+
+void operator delete(void *pointer) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete(void *pointer, size_t) noexcept
+{
+    std::free(pointer);
+}
+
+#define GROUPS 4
+static const char *names[GROUPS] = {"temperature", "output", "status", "step"};
+
+// what the engine has at the time of a push, the temperature changes every sample, the rest now and then
+struct State
+{
+    int temp = 623;
+    int temps[6] = {621, 622, 623, 624, 625, 626};
+    int rate = 5;
+    int output = 45;
+    const char *status = "Running";
+    int mashStep = 1;
+};
+
+// the fields of a group, in the same order and format as BrewEngine::liveGroup
+static void group(JsonWriter &writer, const State &state, size_t index)
+{
+    switch (index)
+    {
+    case 0:
+        writer.Key("temp");
+        writer.Tenths(state.temp);
+        writer.Key("temps");
+        writer.BeginArray();
+        for (int i = 0; i < 6; i++)
+        {
+            char sensor[24];
+            auto result = std::to_chars(sensor, sensor + sizeof(sensor), 2890000000000000000ull + i);
+            writer.BeginObject();
+            writer.Key("sensor");
+            writer.String(string_view(sensor, result.ptr - sensor));
+            writer.Key("temp");
+            writer.Tenths(state.temps[i]);
+            writer.EndObject();
+        }
+        writer.EndArray();
+        writer.Key("tempRate");
+        writer.Tenths(state.rate);
+        break;
+    case 1:
+        writer.Key("output");
+        writer.Int(state.output);
+        writer.Key("manualOverrideOutput");
+        writer.Null();
+        break;
+    case 2:
+        writer.Key("status");
+        writer.String(state.status);
+        writer.Key("stirStatus");
+        writer.String("Idle");
+        writer.Key("inOverTime");
+        writer.Bool(false);
+        writer.Key("boostStatus");
+        writer.Int(0);
+        break;
+    case 3:
+        writer.Key("mashStep");
+        writer.Int(state.mashStep);
+        writer.Key("targetTemp");
+        writer.Tenths(650);
+        writer.Key("manualOverrideTargetTemp");
+        writer.Null();
+        writer.Key("runningVersion");
+        writer.Int(3);
+        break;
+    }
+}
+
+// the push before LiveGroups, the fields parsed into a tree, a delta by key and every event dumped on its own
+struct TreePush
+{
+    json lastLive;
+    string payload;
+    string events;
+
+    void Push(const State &state)
+    {
+        string text;
+        char buffer[128];
+        JsonWriter writer(buffer, sizeof(buffer), [&text](const char *data, size_t length)
+                          {
+                              text.append(data, length);
+                              return ESP_OK; });
+        writer.BeginObject();
+        for (size_t i = 0; i < GROUPS; i++)
+        {
+            group(writer, state, i);
+        }
+        writer.EndObject();
+        writer.Finish();
+        json jLive = json::parse(text);
+
+        json jDelta = json::object();
+        for (auto const &[key, value] : jLive.items())
+        {
+            if (!this->lastLive.contains(key) || this->lastLive[key] != value)
+            {
+                jDelta[key] = value;
+            }
+        }
+        this->lastLive = jLive;
+
+        static const std::vector<std::vector<const char *>> keys = {{"temp", "tempRate", "temps"}, {"output", "manualOverrideOutput"}, {"status", "stirStatus", "inOverTime", "boostStatus"}, {"mashStep", "targetTemp", "manualOverrideTargetTemp", "runningVersion"}};
+        this->events.clear();
+        for (size_t i = 0; i < GROUPS; i++)
+        {
+            if (std::none_of(keys[i].begin(), keys[i].end(), [&jDelta](const char *key)
+                             { return jDelta.contains(key); }))
+            {
+                continue;
+            }
+            json jData;
+            for (const char *key : keys[i])
+            {
+                jData[key] = jLive[key];
+            }
+            this->events += string("event: ") + names[i] + "\ndata: " + jData.dump() + "\n\n";
+        }
+
+        this->payload = jDelta.empty() ? "" : jDelta.dump();
+    };
+};
+
+// the push with LiveGroups, as BrewEngine::pushLoop and formatEvents do it
+struct GroupPush
+{
+    LiveGroups live = LiveGroups(GROUPS);
+    bool changed[GROUPS];
+    string payload;
+    string events;
+
+    void Push(const State &state)
+    {
+        bool any = false;
+        for (size_t i = 0; i < GROUPS; i++)
+        {
+            this->changed[i] = this->live.Update(i, [&state, i](JsonWriter &writer)
+                                                 { group(writer, state, i); });
+            any = any || this->changed[i];
+        }
+
+        this->events.clear();
+        for (size_t i = 0; i < GROUPS; i++)
+        {
+            if (this->changed[i])
+            {
+                this->events += "event: ";
+                this->events += names[i];
+                this->events += "\ndata: ";
+                this->events += this->live.Text(i);
+                this->events += "\n\n";
+            }
+        }
+
+        this->payload.clear();
+        if (!any)
+        {
+            return;
+        }
+
+        char buffer[256];
+        JsonWriter writer(buffer, sizeof(buffer), [this](const char *data, size_t length)
+                          {
+                              this->payload.append(data, length);
+                              return ESP_OK; });
+        writer.BeginObject();
+        for (size_t i = 0; i < GROUPS; i++)
+        {
+            if (this->changed[i])
+            {
+                group(writer, state, i);
+            }
+        }
+        writer.EndObject();
+        writer.Finish();
+    };
+};
+
+static void update()
+{
+    LiveGroups live(2);
+    State state;
+
+    CHECK(live.Update(1, [&state](JsonWriter &writer)
+                      { group(writer, state, 1); }));
+    CHECK(live.Text(1) == "{\"output\":45,\"manualOverrideOutput\":null}");
+    CHECK(!live.Update(1, [&state](JsonWriter &writer)
+                       { group(writer, state, 1); }));
+
+    state.output = 46;
+    CHECK(live.Update(1, [&state](JsonWriter &writer)
+                      { group(writer, state, 1); }));
+    CHECK(live.Text(1) == "{\"output\":46,\"manualOverrideOutput\":null}");
+
+    live.Reset();
+    CHECK(live.Update(1, [&state](JsonWriter &writer)
+                      { group(writer, state, 1); }));
+}
+
+// the state of push n, the temperature moves every push, the status every 50
+static void step(State &state, int n)
+{
+    state.temp = 600 + n % 40;
+    state.temps[n % 6] = 600 + n % 30;
+    state.rate = n % 7;
+    state.output = 40 + n % 3;
+    state.status = n % 50 < 25 ? "Running" : "Boost";
+    state.mashStep = n / 100;
+}
+
+static void samePayload()
+{
+    TreePush tree;
+    GroupPush groups;
+    State state;
+
+    for (int n = 0; n < 300; n++)
+    {
+        step(state, n);
+        tree.Push(state);
+        groups.Push(state);
+
+        // the groups send whole groups, the tree only the keys that changed, so every key of the tree has to be in it
+        CHECK(tree.payload.empty() == groups.payload.empty());
+        if (!tree.payload.empty())
+        {
+            json jTree = json::parse(tree.payload);
+            json jGroups = json::parse(groups.payload);
+            for (auto const &[key, value] : jTree.items())
+            {
+                CHECK(jGroups.contains(key) && jGroups[key] == value);
+            }
+        }
+
+        // events have the same values, the tree sorts the keys
+        CHECK(tree.events.size() == groups.events.size());
+    }
+}
+
+template <typename Push>
+static void measure(const char *name, Push &push, size_t &allocationsPerPush)
+{
+    State state;
+    const int pushes = 2000;
+
+    // the strings grow to their size in the first pushes
+    for (int n = 0; n < 50; n++)
+    {
+        step(state, n);
+        push.Push(state);
+    }
+
+    size_t startAllocations = allocations;
+    size_t startBytes = allocatedBytes;
+    auto start = std::chrono::steady_clock::now();
+
+    for (int n = 50; n < 50 + pushes; n++)
+    {
+        step(state, n);
+        push.Push(state);
+    }
+
+    double time = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / pushes;
+    allocationsPerPush = (allocations - startAllocations) / pushes;
+    std::printf("  %-10s %5zu allocations %7zu bytes %7.2fus per push\n", name, allocationsPerPush, (allocatedBytes - startBytes) / pushes, time);
+}
+
+int main()
+{
+    update();
+    samePayload();
+
+    std::printf("live push with 6 sensors, websocket delta and events:\n");
+    TreePush tree;
+    GroupPush groups;
+    size_t treeAllocations, groupAllocations;
+    measure("json tree", tree, treeAllocations);
+    measure("LiveGroups", groups, groupAllocations);
+
+    CHECK(treeAllocations > 0);
+    CHECK(groupAllocations == 0);
+
+    return failures;
+}
@@ -0,0 +1,100 @@
+// Runs the mock sensor through the same steps as BrewEngine::readTemperatures: start, poll, read and count in the stats.
+#include <cmath>
+#include "host-test.h"
+#include "mock-sensor-driver.h"
+#include "sensor-stats.h"
+
+#define SENSOR_MAX_ERRORS 3 // as in brew-engine.h
+
+struct MockSensor
+{
+    MockSensorDriver driver = MockSensorDriver(20, 0.1);
+    SensorStats stats;
+    uint8_t consecutiveErrors = 0;
+    bool connected = true;
+    float lastTemp = 0;
+};
+
+// one sample of the read loop, returns true when we got a temperature
+static bool sample(MockSensor &sensor, uint32_t latency)
+{
+    sensor.driver.Start();
+
+    if (!sensor.driver.Poll())
+    {
+        sensor.stats.AddError(ESP_ERR_TIMEOUT);
+        return false;
+    }
+
+    float temperature;
+    esp_err_t err = sensor.driver.Read(temperature);
+    if (err != ESP_OK)
+    {
+        sensor.stats.AddError(err);
+        sensor.consecutiveErrors++;
+        if (sensor.consecutiveErrors >= SENSOR_MAX_ERRORS)
+        {
+            sensor.connected = false;
+        }
+        return false;
+    }
+
+    sensor.consecutiveErrors = 0;
+    sensor.lastTemp = temperature;
+    sensor.stats.AddRead(temperature, latency);
+    return true;
+}
+
+int main()
+{
+    MockSensor sensor;
+
+    // a read before a conversion was started is not ready
+    CHECK(!sensor.driver.Poll());
+
+    // normal samples stay within the noise
+    for (int i = 0; i < 20; i++)
+    {
+        CHECK(sample(sensor, 10000 + i));
+        CHECK(std::abs(sensor.lastTemp - 20) <= 0.1f);
+    }
+    CHECK(sensor.stats.reads == 20);
+    CHECK(sensor.stats.latencyMin == 10000);
+    CHECK(sensor.stats.latencyMax == 10019);
+    CHECK(sensor.stats.Noise() > 0 && sensor.stats.Noise() < 0.1f);
+
+    // a conversion that isn't done counts as timeout and keeps the last value
+    float last = sensor.lastTemp;
+    sensor.driver.ready = false;
+    CHECK(!sample(sensor, 0));
+    CHECK(sensor.stats.timeouts == 1);
+    CHECK(sensor.lastTemp == last);
+    sensor.driver.ready = true;
+
+    // an injected error is returned once, the next read works again
+    sensor.driver.nextError = ESP_ERR_INVALID_CRC;
+    CHECK(!sample(sensor, 0));
+    CHECK(sensor.stats.crcErrors == 1);
+    CHECK(sensor.consecutiveErrors == 1);
+    CHECK(sample(sensor, 10000));
+    CHECK(sensor.consecutiveErrors == 0);
+    CHECK(sensor.connected);
+
+    // the sensor is only disconnected after SENSOR_MAX_ERRORS failed reads in a row
+    for (int i = 0; i < SENSOR_MAX_ERRORS; i++)
+    {
+        CHECK(sensor.connected);
+        sensor.driver.nextError = ESP_FAIL;
+        CHECK(!sample(sensor, 0));
+    }
+    CHECK(!sensor.connected);
+    CHECK(sensor.stats.errors == SENSOR_MAX_ERRORS);
+
+    // a changed temperature shows up in the next sample
+    sensor.driver.temperature = 65;
+    sensor.driver.noise = 0;
+    CHECK(sample(sensor, 10000));
+    CHECK(sensor.lastTemp == 65);
+
+    return failures;
+}
@@ -0,0 +1,130 @@
+// Replays sensor traces through the median filters and the kalman filter, times in µs like the read loop gives them.
+#include <cmath>
+#include <random>
+#include "host-test.h"
+#include "temperature-fusion.h"
+
+#define PERIOD 1000000 // read period of 1s
+
+// the first reads after power on, a ds18b20 reports 85°C until its first conversion is done
+static void powerOnValue()
+{
+    TemperatureFusion fusion;
+
+    CHECK(!fusion.AddSample(1, 85, 0, true).has_value());
+    CHECK(!fusion.Update(0));
+    CHECK(!fusion.AddSample(1, 20, PERIOD, true).has_value());
+    CHECK(fusion.Filter(1)->value == 52.5f); // the mean of two, not the higher one
+
+    std::optional<float> median = fusion.AddSample(1, 20, 2 * PERIOD, true);
+    CHECK(median.has_value() && median.value() == 20);
+    CHECK(fusion.Update(2 * PERIOD));
+    CHECK(fusion.Temperature() == 20);
+
+    for (int i = 3; i < 10; i++)
+    {
+        fusion.AddSample(1, 20, i * PERIOD, true);
+        fusion.Update(i * PERIOD);
+    }
+    CHECK(std::abs(fusion.Temperature() - 20) < 0.01f);
+    CHECK(std::abs(fusion.Rate()) < 0.001f);
+}
+
+// a spike in a full window is an outlier, it doesn't move the median
+static void spike()
+{
+    TemperatureFusion fusion;
+    for (int i = 0; i < 10; i++)
+    {
+        fusion.AddSample(1, 64, i * PERIOD, true);
+    }
+
+    std::optional<float> median = fusion.AddSample(1, 85, 10 * PERIOD, true);
+    CHECK(median.has_value() && median.value() == 64);
+    CHECK(fusion.Filter(1)->outliers == 1);
+}
+
+// after a long gap the window starts over, so we wait for a new median
+static void staleReset()
+{
+    TemperatureFusion fusion;
+    for (int i = 0; i < 5; i++)
+    {
+        fusion.AddSample(1, 64, i * PERIOD, true);
+    }
+
+    int64_t later = 4 * PERIOD + FUSION_STALE_TIME + 1;
+    CHECK(!fusion.AddSample(1, 85, later, true).has_value());
+    CHECK(!fusion.AddSample(1, 66, later + PERIOD, true).has_value());
+    CHECK(fusion.AddSample(1, 66, later + 2 * PERIOD, true).value() == 66);
+}
+
+// two buses each with a control sensor, 0.5° apart, swept 300ms after each other at a steady temperature
+// fused once per period the offset must not show up as a rate
+static void twoBuses()
+{
+    TemperatureFusion fusion;
+    std::minstd_rand generator(1);
+    std::uniform_real_distribution<float> noise(-0.05, 0.05);
+
+    float maxRate = 0;
+    for (int i = 0; i < 300; i++)
+    {
+        int64_t time = (int64_t)i * PERIOD;
+        fusion.AddSample(1, 64.0f + noise(generator), time, true);
+        fusion.AddSample(2, 64.5f + noise(generator), time + 300000, true);
+        fusion.Update(time + 300000);
+
+        if (i > 10)
+        {
+            maxRate = std::max(maxRate, std::abs(fusion.Rate()));
+        }
+    }
+
+    CHECK(std::abs(fusion.Temperature() - 64.25f) < 0.1f);
+    CHECK(maxRate < 0.01f); // what the noise gives, fusing per bus swung by the offset every sweep
+}
+
+// a sensor that isn't used for control is filtered but not fused
+static void displayOnly()
+{
+    TemperatureFusion fusion;
+    for (int i = 0; i < 5; i++)
+    {
+        fusion.AddSample(1, 64, i * PERIOD, true);
+        fusion.AddSample(2, 20, i * PERIOD, false);
+        fusion.Update(i * PERIOD);
+    }
+    CHECK(fusion.Temperature() == 64);
+}
+
+// heating at 1° per minute with noise, the rate should follow
+static void ramp()
+{
+    TemperatureFusion fusion;
+    std::minstd_rand generator(2);
+    std::uniform_real_distribution<float> noise(-0.1, 0.1);
+
+    float rate = 1.0f / 60;
+    for (int i = 0; i < 600; i++)
+    {
+        int64_t time = (int64_t)i * PERIOD;
+        fusion.AddSample(1, 40 + rate * i + noise(generator), time, true);
+        fusion.Update(time);
+    }
+
+    CHECK(std::abs(fusion.Rate() - rate) < rate * 0.2f);
+    CHECK(std::abs(fusion.Temperature() - (40 + rate * 599)) < 0.3f);
+}
+
+int main()
+{
+    powerOnValue();
+    spike();
+    staleReset();
+    twoBuses();
+    displayOnly();
+    ramp();
+
+    return failures;
+}
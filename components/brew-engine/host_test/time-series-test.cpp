@@ -0,0 +1,268 @@
+// Checks TimeSeries against a plain model of every row, with random gaps, channels that come and go and eviction,
+// then compares memory and append cost with the std::map<time_t, ...> log it replaced.
+#include <chrono>
+#include <cstdlib>
+#include <new>
+#include <random>
+#include "host-test.h"
+#include "time-series.h"
+
+// live heap bytes, so we can see what a log really costs including the nodes of a map
+static size_t liveBytes = 0;
+
+void *operator new(size_t size)
+{
+    size_t *block = (size_t *)std::malloc(size + sizeof(max_align_t));
+    if (!block)
+    {
+        throw std::bad_alloc();
+    }
+    *block = size;
+    liveBytes += size;
+    return (char *)block + sizeof(max_align_t);
+}
+
+void operator delete(void *pointer) noexcept
+{
+    if (pointer)
+    {
+        size_t *block = (size_t *)((char *)pointer - sizeof(max_align_t));
+        liveBytes -= *block;
+        std::free(block);
+    }
+}
+
+void operator delete(void *pointer, size_t) noexcept
+{
+    operator delete(pointer);
+}
+
+void *operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete[](void *pointer) noexcept
+{
+    operator delete(pointer);
+}
+
+void operator delete[](void *pointer, size_t) noexcept
+{
+    operator delete(pointer);
+}
+
+struct Row
+{
+    time_t time;
+    std::map<string, int16_t> values;
+};
+
+// every row from cursor on must be there, rows before it may be evicted, a channel can lose its oldest values
+// before the time column does, but once it has a value all later ones have to match
+static void compare(TimeSeries &series, const vector<Row> &model, const vector<string> &channels, uint32_t cursor)
+{
+    vector<Row> rows;
+    uint32_t next = series.Read(cursor, channels, [&](time_t time, const int16_t *values)
+                                {
+                                    Row row;
+                                    row.time = time;
+                                    for (size_t i = 0; i < channels.size(); i++)
+                                    {
+                                        row.values[channels[i]] = values[i];
+                                    }
+                                    rows.push_back(row); });
+
+    CHECK(next == model.size());
+    CHECK(rows.size() <= model.size() - std::min<size_t>(cursor, model.size()));
+    CHECK(!rows.empty() || cursor >= model.size());
+
+    size_t first = model.size() - rows.size();
+    std::map<string, bool> started;
+
+    for (size_t i = 0; i < rows.size(); i++)
+    {
+        const Row &expected = model[first + i];
+        CHECK(rows[i].time == expected.time);
+
+        for (auto const &channel : channels)
+        {
+            auto it = expected.values.find(channel);
+            int16_t value = it == expected.values.end() ? TIMESERIES_MISSING : it->second;
+            int16_t got = rows[i].values[channel];
+
+            if (got != TIMESERIES_MISSING)
+            {
+                started[channel] = true;
+            }
+            if (started[channel] || got != TIMESERIES_MISSING)
+            {
+                if (got != value)
+                {
+                    std::printf("row %zu channel %s: %d != %d\n", first + i, channel.c_str(), got, value);
+                }
+                CHECK(got == value);
+            }
+        }
+    }
+}
+
+// random rows against the model, small pool so old blocks get reused many times
+static void model()
+{
+    TimeSeries series(64, 24);
+    vector<Row> model;
+    vector<string> channels = {"temp", "target", "output", "s1", "s2"};
+
+    std::minstd_rand generator(3);
+    std::uniform_int_distribution<int> percent(0, 99);
+    std::uniform_int_distribution<int> small(-3, 3);
+    std::uniform_int_distribution<int> any(INT16_MIN + 1, INT16_MAX);
+
+    time_t time = 1700000000;
+    std::map<string, int16_t> last = {{"temp", 200}, {"target", 650}, {"output", 0}, {"s1", 198}, {"s2", 201}};
+
+    for (int i = 0; i < 3000; i++)
+    {
+        // mostly the log period, sometimes a pause of the program or a jump of the clock
+        int gap = percent(generator);
+        time += gap < 90 ? 5 : gap < 98 ? 5 + percent(generator) * 60 : 1000000;
+
+        Row row;
+        row.time = time;
+        for (auto &[name, value] : last)
+        {
+            // a sensor that is disconnected for a while, or the s2 sensor that only shows up later
+            if (percent(generator) < 5 || (name == "s2" && i < 500))
+            {
+                continue;
+            }
+
+            value = percent(generator) < 3 ? any(generator) : std::clamp(value + small(generator), INT16_MIN + 1, (int)INT16_MAX);
+            row.values[name] = value;
+        }
+
+        series.Append(row.time, row.values);
+        model.push_back(row);
+
+        CHECK(series.NextSeq() == model.size());
+        CHECK(series.LastTime() == time);
+
+        if (i % 97 == 0)
+        {
+            compare(series, model, channels, 0);
+            compare(series, model, channels, model.size() - std::min<size_t>(model.size(), 1 + percent(generator)));
+        }
+    }
+
+    // the pool holds a good part of the history, 24 blocks of 64 bytes with 6 columns
+    uint32_t rows = 0;
+    series.Read(0, {"temp"}, [&rows](time_t, const int16_t *)
+                { rows++; });
+    CHECK(rows > 100 && rows < model.size());
+
+    // batches give the same rows as one read
+    vector<time_t> all;
+    series.Read(0, {}, [&all](time_t time, const int16_t *)
+                { all.push_back(time); });
+    vector<time_t> batched;
+    uint32_t cursor = 0;
+    while (cursor < series.NextSeq())
+    {
+        cursor = series.Read(cursor, {}, [&batched](time_t time, const int16_t *)
+                             { batched.push_back(time); }, 7);
+    }
+    CHECK(all == batched);
+
+    // a removed channel reads as missing, the others are kept
+    series.RemoveChannel("s1");
+    CHECK(series.ChannelCount() == 4);
+    compare(series, model, {"temp", "target", "output", "s2"}, 0);
+    series.Read(model.size() - 5, {"s1"}, [](time_t, const int16_t *values)
+                { CHECK(values[0] == TIMESERIES_MISSING); });
+
+    // cursors keep counting over a clear
+    uint32_t seq = series.NextSeq();
+    series.Clear();
+    CHECK(series.Empty());
+    CHECK(series.NextSeq() == seq);
+    series.Append(time + 5, {{"temp", 1}});
+    series.Read(seq, {"temp"}, [](time_t, const int16_t *values)
+                { CHECK(values[0] == 1); });
+}
+
+static void sameAsLast()
+{
+    TimeSeries series(64, 4);
+    CHECK(!series.SameAsLast({{"temp", 1}}));
+    series.Append(1, {{"temp", 1}});
+    CHECK(series.SameAsLast({{"temp", 1}}));
+    CHECK(!series.SameAsLast({{"temp", 2}}));
+    CHECK(!series.SameAsLast({{"temp", 1}, {"s1", 1}}));
+    CHECK(!series.SameAsLast({}));
+}
+
+// what a brew of 3 hours with a sample every 5s costs, the old log was a map of time to one value,
+// with the sensors and output in it it would be a map of rows
+static void memory()
+{
+    const int rows = 3 * 3600 / 5;
+    std::map<string, int16_t> row = {{"temp", 200}, {"target", 650}, {"output", 0}, {"s1", 198}, {"s2", 201}};
+
+    size_t before = liveBytes;
+    auto start = std::chrono::steady_clock::now();
+    std::map<time_t, int8_t> single;
+    for (int i = 0; i < rows; i++)
+    {
+        single.insert(std::make_pair(1700000000 + i * 5, (int8_t)(i % 100)));
+    }
+    double singleTime = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / rows;
+    size_t singleBytes = liveBytes - before;
+
+    before = liveBytes;
+    start = std::chrono::steady_clock::now();
+    std::map<time_t, vector<int16_t>> wide;
+    for (int i = 0; i < rows; i++)
+    {
+        row["temp"] = 200 + i / 100;
+        wide.insert(std::make_pair(1700000000 + i * 5, vector<int16_t>{row["temp"], row["target"], row["output"], row["s1"], row["s2"]}));
+    }
+    double wideTime = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / rows;
+    size_t wideBytes = liveBytes - before;
+
+    before = liveBytes;
+    TimeSeries *series = new TimeSeries(256, 128); // TEMP_LOG_BLOCK_SIZE and TEMP_LOG_BLOCK_COUNT
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < rows; i++)
+    {
+        row["temp"] = 200 + i / 100;
+        series->Append(1700000000 + i * 5, row);
+    }
+    double seriesTime = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / rows;
+    size_t seriesBytes = liveBytes - before;
+
+    uint32_t kept = 0;
+    series->Read(0, {"temp"}, [&kept](time_t, const int16_t *)
+                 { kept++; });
+
+    std::printf("%d rows, memory and append time per row:\n", rows);
+    std::printf("  map<time_t, int8_t>, only temp:   %7zu bytes %6.3fus\n", singleBytes, singleTime);
+    std::printf("  map<time_t, vector>, 5 channels:  %7zu bytes %6.3fus\n", wideBytes, wideTime);
+    std::printf("  TimeSeries, 5 channels:           %7zu bytes %6.3fus, %u rows kept\n", seriesBytes, seriesTime, kept);
+
+    // the pool is all the memory it takes, no matter how long the brew is
+    CHECK(seriesBytes < series->MemoryUsage() + 1024);
+    CHECK(seriesBytes < singleBytes);
+    CHECK(kept == rows);
+
+    delete series;
+}
+
+int main()
+{
+    model();
+    sameAsLast();
+    memory();
+
+    return failures;
+}
@@ -0,0 +1,111 @@
+#ifndef _JsonCheck_H_
+#define _JsonCheck_H_
+
+#include <string>
+#include "nlohmann_json.hpp"
+
+using namespace std;
+using json = nlohmann::json;
+
+// Checks the fields of json we get from a client before they are read, a get<> of the wrong type throws
+// and a missing key on a const json asserts, both would restart the controller.
+// Checks are chained and the first field that fails is kept, like JsonCheck(data).Number("kP").Bool("boil").Valid()
+class JsonCheck
+{
+public:
+    JsonCheck(const json &data) : data(data)
+    {
+        if (!data.is_object())
+        {
+            this->reason = "object expected";
+        }
+    };
+
+    // a field that is not required can be missing or null
+    JsonCheck &Number(const char *key, bool required = true)
+    {
+        return this->field(key, required, this->data.contains(key) && this->data[key].is_number(), "number expected");
+    };
+
+    JsonCheck &String(const char *key, bool required = true)
+    {
+        return this->field(key, required, this->data.contains(key) && this->data[key].is_string(), "string expected");
+    };
+
+    JsonCheck &Bool(const char *key, bool required = true)
+    {
+        return this->field(key, required, this->data.contains(key) && this->data[key].is_boolean(), "true or false expected");
+    };
+
+    // every item of the array has to pass item, the item checks of the models take this form
+    JsonCheck &Array(const char *key, JsonCheck (*item)(const json &jsonData), bool required = true)
+    {
+        this->field(key, required, this->data.contains(key) && this->data[key].is_array(), "array expected");
+        if (this->Valid() && this->data.contains(key) && this->data[key].is_array())
+        {
+            this->items(key, this->data[key], item);
+        }
+        return *this;
+    };
+
+    // for data that is an array itself
+    static JsonCheck Items(const json &data, JsonCheck (*item)(const json &jsonData))
+    {
+        JsonCheck check(data);
+        check.reason = data.is_array() ? "" : "array expected";
+        if (check.Valid())
+        {
+            check.items("", data, item);
+        }
+        return check;
+    };
+
+    bool Valid() const
+    {
+        return this->reason.empty();
+    };
+
+    // the field that failed and why, like steps[2].name: string expected
+    string Error() const
+    {
+        return this->path.empty() ? this->reason : this->path + ": " + this->reason;
+    };
+
+protected:
+private:
+    const json &data;
+    string path;
+    string reason;
+
+    JsonCheck &field(const char *key, bool required, bool matches, const char *expected)
+    {
+        if (!this->Valid() || matches)
+        {
+            return *this;
+        }
+
+        if (!required && (!this->data.contains(key) || this->data[key].is_null()))
+        {
+            return *this;
+        }
+
+        this->path = key;
+        this->reason = expected;
+        return *this;
+    };
+
+    void items(const char *key, const json &array, JsonCheck (*item)(const json &jsonData))
+    {
+        for (size_t i = 0; i < array.size() && this->Valid(); i++)
+        {
+            JsonCheck check = item(array[i]);
+            if (!check.Valid())
+            {
+                this->path = string(key) + "[" + to_string(i) + "]" + (check.path.empty() ? "" : "." + check.path);
+                this->reason = check.reason;
+            }
+        }
+    };
+};
+
+#endif /* _JsonCheck_H_ */
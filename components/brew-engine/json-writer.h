@@ -0,0 +1,345 @@
+#ifndef _JsonWriter_H_
+#define _JsonWriter_H_
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <string_view>
+#include "esp_err.h"
+
+using namespace std;
+
+#define JSON_WRITER_MAX_DEPTH 8 // nesting of objects and arrays
+
+// Formats json straight into a fixed buffer, a full buffer is handed to flush and reused.
+// Commas are added for us, a value written after Key belongs to that key.
+// The first flush error is kept, later writes are dropped and Finish returns it.
+// In cbor mode the same calls give cbor, objects and arrays get an indefinite length so nothing has to be counted up front.
+class JsonWriter
+{
+public:
+    enum Format
+    {
+        Text = 0,
+        Cbor = 1
+    };
+
+    JsonWriter(char *buffer, size_t size, const std::function<esp_err_t(const char *data, size_t length)> &flush, Format format = Text)
+    {
+        this->buffer = buffer;
+        this->size = size;
+        this->flush = flush;
+        this->format = format;
+    };
+
+    void BeginObject()
+    {
+        this->value();
+        this->put(this->format == Cbor ? 0xBF : '{');
+        this->push();
+    };
+
+    void EndObject()
+    {
+        this->depth--;
+        this->put(this->format == Cbor ? 0xFF : '}');
+    };
+
+    void BeginArray()
+    {
+        this->value();
+        this->put(this->format == Cbor ? 0x9F : '[');
+        this->push();
+    };
+
+    void EndArray()
+    {
+        this->depth--;
+        this->put(this->format == Cbor ? 0xFF : ']');
+    };
+
+    void Key(string_view key)
+    {
+        this->value();
+        this->quoted(key);
+        if (this->format == Text)
+        {
+            this->put(':');
+        }
+        this->afterKey = true;
+    };
+
+    void String(string_view value)
+    {
+        this->value();
+        this->quoted(value);
+    };
+
+    void Int(int64_t value)
+    {
+        this->value();
+
+        if (this->format == Cbor)
+        {
+            // negative numbers are stored as -1 - n
+            this->head(value < 0 ? 1 : 0, value < 0 ? -(value + 1) : value);
+            return;
+        }
+
+        char digits[24];
+        auto result = std::to_chars(digits, digits + sizeof(digits), value);
+        this->write(digits, result.ptr - digits);
+    };
+
+    // fixed point with one decimal, how we log and round temperatures
+    void Tenths(int32_t value)
+    {
+        if (this->format == Cbor)
+        {
+            // whole degrees fit in one to three bytes as an integer, the rest is a float32
+            if (value % 10 == 0)
+            {
+                this->Int(value / 10);
+            }
+            else
+            {
+                this->Float(value / 10.0f);
+            }
+            return;
+        }
+
+        this->value();
+        if (value < 0)
+        {
+            this->put('-');
+        }
+        uint32_t absolute = value < 0 ? -(int64_t)value : value;
+        char digits[16];
+        auto result = std::to_chars(digits, digits + sizeof(digits) - 2, absolute / 10); // room for the decimal
+        *result.ptr++ = '.';
+        *result.ptr++ = '0' + absolute % 10;
+        this->write(digits, result.ptr - digits);
+    };
+
+    // shortest text that reads back as the same float, json has no nan or inf so they are null
+    void Float(float value)
+    {
+        if (!std::isfinite(value))
+        {
+            this->Null();
+            return;
+        }
+
+        this->value();
+
+        if (this->format == Cbor)
+        {
+            uint32_t bits;
+            memcpy(&bits, &value, sizeof(bits));
+            this->put(0xFA);
+            this->bigEndian(bits, 4);
+            return;
+        }
+
+        char digits[24];
+        auto result = std::to_chars(digits, digits + sizeof(digits), value);
+        this->write(digits, result.ptr - digits);
+    };
+
+    void Bool(bool value)
+    {
+        this->value();
+        if (this->format == Cbor)
+        {
+            this->put(value ? 0xF5 : 0xF4);
+            return;
+        }
+        this->write(value ? "true" : "false", value ? 4 : 5);
+    };
+
+    void Null()
+    {
+        this->value();
+        if (this->format == Cbor)
+        {
+            this->put(0xF6);
+            return;
+        }
+        this->write("null", 4);
+    };
+
+    // a value that is already encoded in our format
+    void Raw(string_view encoded)
+    {
+        this->value();
+        this->write(encoded.data(), encoded.size());
+    };
+
+    esp_err_t Finish()
+    {
+        this->flushBuffer();
+        return this->err;
+    };
+
+    // bytes written so far, flushed or not
+    size_t Size()
+    {
+        return this->total;
+    };
+
+    Format Encoding()
+    {
+        return this->format;
+    };
+
+protected:
+private:
+    char *buffer;
+    size_t size;
+    size_t used = 0;
+    size_t total = 0;
+    std::function<esp_err_t(const char *data, size_t length)> flush;
+    esp_err_t err = ESP_OK;
+    Format format;
+
+    bool first[JSON_WRITER_MAX_DEPTH] = {};
+    uint8_t depth = 0;
+    bool afterKey = false;
+
+    // a comma when something came before us at this level, keys and their value count as one
+    void value()
+    {
+        if (this->afterKey)
+        {
+            this->afterKey = false;
+            return;
+        }
+        if (this->depth > 0 && this->depth <= JSON_WRITER_MAX_DEPTH)
+        {
+            if (!this->first[this->depth - 1] && this->format == Text)
+            {
+                this->put(',');
+            }
+            this->first[this->depth - 1] = false;
+        }
+    };
+
+    void push()
+    {
+        if (this->depth < JSON_WRITER_MAX_DEPTH)
+        {
+            this->first[this->depth] = true;
+        }
+        this->depth++;
+    };
+
+    void quoted(string_view text)
+    {
+        if (this->format == Cbor)
+        {
+            this->head(3, text.size());
+            this->write(text.data(), text.size());
+            return;
+        }
+
+        this->put('"');
+        for (char c : text)
+        {
+            if (c == '"' || c == '\\')
+            {
+                this->put('\\');
+                this->put(c);
+            }
+            else if ((uint8_t)c < 0x20)
+            {
+                static const char hex[] = "0123456789abcdef";
+                char escaped[6] = {'\\', 'u', '0', '0', hex[(uint8_t)c >> 4], hex[c & 0xF]};
+                this->write(escaped, sizeof(escaped));
+            }
+            else
+            {
+                this->put(c);
+            }
+        }
+        this->put('"');
+    };
+
+    // cbor major type and its argument, small arguments fit in the first byte
+    void head(uint8_t major, uint64_t argument)
+    {
+        major <<= 5;
+        if (argument < 24)
+        {
+            this->put(major | argument);
+        }
+        else if (argument <= UINT8_MAX)
+        {
+            this->put(major | 24);
+            this->bigEndian(argument, 1);
+        }
+        else if (argument <= UINT16_MAX)
+        {
+            this->put(major | 25);
+            this->bigEndian(argument, 2);
+        }
+        else if (argument <= UINT32_MAX)
+        {
+            this->put(major | 26);
+            this->bigEndian(argument, 4);
+        }
+        else
+        {
+            this->put(major | 27);
+            this->bigEndian(argument, 8);
+        }
+    };
+
+    void bigEndian(uint64_t value, uint8_t bytes)
+    {
+        char data[8];
+        for (uint8_t i = 0; i < bytes; i++)
+        {
+            data[i] = (char)(value >> (8 * (bytes - 1 - i)));
+        }
+        this->write(data, bytes);
+    };
+
+    void put(char c)
+    {
+        this->write(&c, 1);
+    };
+
+    void write(const char *data, size_t length)
+    {
+        this->total += length;
+
+        while (length > 0 && this->err == ESP_OK)
+        {
+            if (this->used == this->size)
+            {
+                this->flushBuffer();
+                continue;
+            }
+
+            size_t part = std::min(length, this->size - this->used);
+            std::copy(data, data + part, this->buffer + this->used);
+            this->used += part;
+            data += part;
+            length -= part;
+        }
+    };
+
+    void flushBuffer()
+    {
+        if (this->used > 0 && this->err == ESP_OK)
+        {
+            this->err = this->flush(this->buffer, this->used);
+        }
+        this->used = 0;
+    };
+};
+
+#endif /* _JsonWriter_H_ */
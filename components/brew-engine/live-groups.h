@@ -0,0 +1,77 @@
+#ifndef _LiveGroups_H_
+#define _LiveGroups_H_
+
+#include <functional>
+#include <string>
+#include <vector>
+#include "esp_err.h"
+#include "json-writer.h"
+
+using namespace std;
+
+#define LIVE_GROUPS_BUFFER_SIZE 128 // the writer flushes into the text of the group in chunks of this size
+
+// Keeps the last json of every group of live fields, so a push only has to send the groups that changed.
+// A group is rendered into a scratch string that is swapped with the last one when it differs,
+// both keep their capacity, so once they have grown nothing is allocated anymore.
+class LiveGroups
+{
+public:
+    LiveGroups(size_t count)
+    {
+        this->texts.resize(count);
+        this->scratch.resize(count);
+    };
+
+    // write gives the fields of the group, they are wrapped in an object, true when that differs from the last update
+    bool Update(size_t group, const std::function<void(JsonWriter &writer)> &write)
+    {
+        string &text = this->scratch[group];
+        text.clear();
+
+        char buffer[LIVE_GROUPS_BUFFER_SIZE];
+        JsonWriter writer(buffer, sizeof(buffer), [&text](const char *data, size_t length)
+                          {
+                              text.append(data, length);
+                              return ESP_OK; });
+        writer.BeginObject();
+        write(writer);
+        writer.EndObject();
+        writer.Finish();
+
+        if (text == this->texts[group])
+        {
+            return false;
+        }
+
+        this->texts[group].swap(text);
+        return true;
+    };
+
+    // the object of the last update
+    const string &Text(size_t group)
+    {
+        return this->texts[group];
+    };
+
+    // every group counts as changed on the next update, for a client that needs everything
+    void Reset()
+    {
+        for (auto &text : this->texts)
+        {
+            text.clear();
+        }
+    };
+
+    size_t Count()
+    {
+        return this->texts.size();
+    };
+
+protected:
+private:
+    vector<string> texts;
+    vector<string> scratch;
+};
+
+#endif /* _LiveGroups_H_ */
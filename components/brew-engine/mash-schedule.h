@@ -3,6 +3,7 @@
 
 #include <deque>
 #include "nlohmann_json.hpp"
+#include "json-check.h"
 #include "mash-step.h"
 #include "notification.h"
 
@@ -50,11 +51,17 @@ public:
         return jSchedule;
     };
 
+    // a schedule we get from a client, setMashSchedule needs all of it
+    static JsonCheck check_json(const json &jsonData)
+    {
+        return JsonCheck(jsonData).String("name").Bool("boil").Array("steps", MashStep::check_json).Array("notifications", Notification::check_json);
+    };
+
     void from_json(const json &jsonData)
     {
         this->name = jsonData["name"];
 
-        if (!jsonData["boil"].is_null() && jsonData["boil"].is_boolean())
+        if (jsonData.contains("boil") && jsonData["boil"].is_boolean())
         {
             this->boil = jsonData["boil"].get<bool>();
         }
@@ -63,7 +70,7 @@ public:
             this->boil = false;
         }
 
-        if (jsonData.contains("temporary") && !jsonData["temporary"].is_null() && jsonData["temporary"].is_boolean())
+        if (jsonData.contains("temporary") && jsonData["temporary"].is_boolean())
         {
             this->temporary = jsonData["temporary"].get<bool>();
         }
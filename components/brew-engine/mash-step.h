@@ -2,6 +2,7 @@
 #define _MashStep_H_
 
 #include "nlohmann_json.hpp"
+#include "json-check.h"
 using namespace std;
 using json = nlohmann::json;
 
@@ -31,6 +32,12 @@ public:
         return jStep;
     }
 
+    // what from_json needs, for steps we get from a client
+    static JsonCheck check_json(const json &jsonData)
+    {
+        return JsonCheck(jsonData).Number("index").String("name").Number("temperature").Number("stepTime").Number("time").Bool("extendStepTimeIfNeeded").Bool("allowBoost", false);
+    }
+
     void from_json(const json &jsonData)
     {
         this->index = jsonData["index"].get<int>();
@@ -40,7 +47,7 @@ public:
         this->time = jsonData["time"].get<int>();
         this->extendStepTimeIfNeeded = jsonData["extendStepTimeIfNeeded"].get<bool>();
 
-        if (jsonData.contains("allowBoost"))
+        if (jsonData.contains("allowBoost") && jsonData["allowBoost"].is_boolean())
         {
             this->allowBoost = jsonData["allowBoost"].get<bool>();
         }
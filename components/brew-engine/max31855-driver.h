@@ -0,0 +1,94 @@
+#ifndef _MAX31855Driver_H_
+#define _MAX31855Driver_H_
+
+#include "driver/spi_master.h"
+#include "sensor-driver.h"
+
+#define MAX31855_FAULT 0x00010000
+
+// K-type thermocouple over SPI, the chip converts continuously and we can read at any time
+class MAX31855Driver : public SensorDriver
+{
+public:
+    MAX31855Driver(spi_host_device_t host, gpio_num_t csPin)
+    {
+        this->host = host;
+        this->csPin = csPin;
+    };
+
+    ~MAX31855Driver()
+    {
+        if (this->device)
+        {
+            spi_bus_remove_device(this->device);
+        }
+    };
+
+    esp_err_t Init() override
+    {
+        spi_device_interface_config_t devcfg = {};
+        devcfg.clock_speed_hz = 1 * 1000 * 1000;
+        devcfg.mode = 0;
+        devcfg.spics_io_num = this->csPin;
+        devcfg.queue_size = 1;
+
+        esp_err_t err = spi_bus_add_device(this->host, &devcfg, &this->device);
+        if (err != ESP_OK)
+        {
+            this->device = NULL;
+        }
+        return err;
+    };
+
+    esp_err_t Start() override
+    {
+        return ESP_OK;
+    };
+
+    bool Poll() override
+    {
+        return true;
+    };
+
+    esp_err_t Read(float &temperature) override
+    {
+        spi_transaction_t t = {};
+        t.flags = SPI_TRANS_USE_RXDATA;
+        t.length = 32;
+        t.rxlength = 32;
+
+        esp_err_t err = spi_device_polling_transmit(this->device, &t);
+        if (err != ESP_OK)
+        {
+            return err;
+        }
+
+        uint32_t raw = ((uint32_t)t.rx_data[0] << 24) | ((uint32_t)t.rx_data[1] << 16) | ((uint32_t)t.rx_data[2] << 8) | t.rx_data[3];
+        int32_t value = (int32_t)raw;
+
+        // open circuit or short to gnd/vcc
+        if (value & MAX31855_FAULT)
+        {
+            return ESP_ERR_INVALID_RESPONSE;
+        }
+
+        // upper 14 bits are the signed thermocouple temperature in 0.25°C
+        temperature = (float)(value >> 18) * 0.25;
+
+        return ESP_OK;
+    };
+
+    // a conversion takes max 100ms
+    uint16_t ConversionTime() override
+    {
+        return 100;
+    };
+
+protected:
+private:
+    spi_host_device_t host;
+    spi_device_handle_t device = NULL;
+    gpio_num_t csPin;
+};
+
+#endif /* _MAX31855Driver_H_ */
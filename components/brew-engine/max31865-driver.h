@@ -0,0 +1,172 @@
+#ifndef _MAX31865Driver_H_
+#define _MAX31865Driver_H_
+
+#include <cmath>
+#include "driver/spi_master.h"
+#include "sensor-driver.h"
+
+#define MAX31865_REG_CONFIG 0x00
+#define MAX31865_REG_RTD_MSB 0x01
+#define MAX31865_REG_FAULT_STATUS 0x07
+#define MAX31865_WRITE 0x80
+
+#define MAX31865_CONFIG_BIAS 0x80
+#define MAX31865_CONFIG_AUTO 0x40
+#define MAX31865_CONFIG_3WIRE 0x10
+#define MAX31865_CONFIG_FAULT_CLEAR 0x02
+#define MAX31865_CONFIG_FILTER_50HZ 0x01
+
+// Callendar-Van Dusen coefficients for platinum RTDs
+#define RTD_A 3.9083e-3
+#define RTD_B -5.775e-7
+
+// PT100/PT1000 over SPI, runs in auto conversion mode so a fresh value is always ready
+class MAX31865Driver : public SensorDriver
+{
+public:
+    MAX31865Driver(spi_host_device_t host, gpio_num_t csPin, uint16_t rtdNominal, uint16_t refResistor, uint8_t wires)
+    {
+        this->host = host;
+        this->csPin = csPin;
+        this->rtdNominal = rtdNominal;
+        this->refResistor = refResistor;
+        this->wires = wires;
+    };
+
+    ~MAX31865Driver()
+    {
+        if (this->device)
+        {
+            spi_bus_remove_device(this->device);
+        }
+    };
+
+    esp_err_t Init() override
+    {
+        spi_device_interface_config_t devcfg = {};
+        devcfg.clock_speed_hz = 1 * 1000 * 1000;
+        devcfg.mode = 1; // max31865 supports mode 1 and 3
+        devcfg.spics_io_num = this->csPin;
+        devcfg.queue_size = 1;
+
+        esp_err_t err = spi_bus_add_device(this->host, &devcfg, &this->device);
+        if (err != ESP_OK)
+        {
+            this->device = NULL;
+            return err;
+        }
+
+        return this->writeRegister(MAX31865_REG_CONFIG, this->config() | MAX31865_CONFIG_FAULT_CLEAR);
+    };
+
+    // in auto mode the chip converts continuously, nothing to start
+    esp_err_t Start() override
+    {
+        return ESP_OK;
+    };
+
+    bool Poll() override
+    {
+        return true;
+    };
+
+    esp_err_t Read(float &temperature) override
+    {
+        uint8_t rx[2];
+        esp_err_t err = this->readRegisters(MAX31865_REG_RTD_MSB, rx);
+        if (err != ESP_OK)
+        {
+            return err;
+        }
+
+        uint16_t rtd = (rx[0] << 8) | rx[1];
+
+        // lowest bit is the fault flag, we clear it so the next read can succeed
+        if (rtd & 0x01)
+        {
+            this->writeRegister(MAX31865_REG_CONFIG, this->config() | MAX31865_CONFIG_FAULT_CLEAR);
+            return ESP_ERR_INVALID_RESPONSE;
+        }
+
+        rtd >>= 1;
+
+        float resistance = (float)rtd * (float)this->refResistor / 32768.0;
+        temperature = this->resistanceToTemperature(resistance);
+
+        return ESP_OK;
+    };
+
+    // with 50Hz filter a conversion takes 20ms
+    uint16_t ConversionTime() override
+    {
+        return 21;
+    };
+
+protected:
+private:
+    spi_host_device_t host;
+    spi_device_handle_t device = NULL;
+    gpio_num_t csPin;
+    uint16_t rtdNominal;
+    uint16_t refResistor;
+    uint8_t wires;
+
+    uint8_t config()
+    {
+        uint8_t config = MAX31865_CONFIG_BIAS | MAX31865_CONFIG_AUTO | MAX31865_CONFIG_FILTER_50HZ;
+        if (this->wires == 3)
+        {
+            config |= MAX31865_CONFIG_3WIRE;
+        }
+        return config;
+    };
+
+    esp_err_t writeRegister(uint8_t reg, uint8_t value)
+    {
+        spi_transaction_t t = {};
+        t.flags = SPI_TRANS_USE_TXDATA;
+        t.length = 16;
+        t.tx_data[0] = reg | MAX31865_WRITE;
+        t.tx_data[1] = value;
+
+        return spi_device_polling_transmit(this->device, &t);
+    };
+
+    esp_err_t readRegisters(uint8_t reg, uint8_t *rx)
+    {
+        spi_transaction_t t = {};
+        t.flags = SPI_TRANS_USE_TXDATA | SPI_TRANS_USE_RXDATA;
+        t.length = 24;
+        t.tx_data[0] = reg;
+
+        esp_err_t err = spi_device_polling_transmit(this->device, &t);
+        if (err != ESP_OK)
+        {
+            return err;
+        }
+
+        // first byte is clocked out while we send the address
+        rx[0] = t.rx_data[1];
+        rx[1] = t.rx_data[2];
+
+        return ESP_OK;
+    };
+
+    float resistanceToTemperature(float resistance)
+    {
+        float ratio = resistance / (float)this->rtdNominal;
+
+        // Callendar-Van Dusen solved for T, only valid above 0°C which is all we need for brewing
+        float temperature = (-RTD_A + sqrt(RTD_A * RTD_A - 4 * RTD_B * (1 - ratio))) / (2 * RTD_B);
+
+        if (temperature >= 0)
+        {
+            return temperature;
+        }
+
+        // below 0 we use a linear approximation, good enough to show we are way off
+        return (ratio - 1) / RTD_A;
+    };
+};
+
+#endif /* _MAX31865Driver_H_ */
@@ -0,0 +1,170 @@
+#ifndef _MetricsWriter_H_
+#define _MetricsWriter_H_
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <functional>
+#include <initializer_list>
+#include <string_view>
+#include "esp_err.h"
+
+using namespace std;
+
+struct MetricLabel
+{
+    string_view name;
+    string_view value;
+};
+
+// Formats the prometheus text format straight into a fixed buffer, a full buffer is handed to flush and reused.
+// Metric writes the help and type of a metric, the samples after it belong to that metric.
+// Names and help are ours and written as they are, label values are escaped.
+// The first flush error is kept, later writes are dropped and Finish returns it.
+class MetricsWriter
+{
+public:
+    MetricsWriter(char *buffer, size_t size, const std::function<esp_err_t(const char *data, size_t length)> &flush)
+    {
+        this->buffer = buffer;
+        this->size = size;
+        this->flush = flush;
+    };
+
+    void Metric(string_view name, string_view type, string_view help)
+    {
+        this->name = name;
+        this->write("# HELP ");
+        this->write(name);
+        this->put(' ');
+        this->write(help);
+        this->write("\n# TYPE ");
+        this->write(name);
+        this->put(' ');
+        this->write(type);
+        this->put('\n');
+    };
+
+    void Sample(double value, std::initializer_list<MetricLabel> labels = {})
+    {
+        this->write(this->name);
+
+        if (labels.size() > 0)
+        {
+            char separator = '{';
+            for (auto const &label : labels)
+            {
+                this->put(separator);
+                this->write(label.name);
+                this->write("=\"");
+                this->escaped(label.value);
+                this->put('"');
+                separator = ',';
+            }
+            this->put('}');
+        }
+
+        this->put(' ');
+        this->number(value);
+        this->put('\n');
+    };
+
+    esp_err_t Finish()
+    {
+        this->flushBuffer();
+        return this->err;
+    };
+
+    // bytes written so far, flushed or not
+    size_t Size()
+    {
+        return this->total;
+    };
+
+protected:
+private:
+    char *buffer;
+    size_t size;
+    size_t used = 0;
+    size_t total = 0;
+    std::function<esp_err_t(const char *data, size_t length)> flush;
+    esp_err_t err = ESP_OK;
+    string_view name;
+
+    // shortest text that reads back as the same double, so whole numbers have no decimals
+    void number(double value)
+    {
+        if (std::isnan(value))
+        {
+            this->write("NaN");
+            return;
+        }
+        if (std::isinf(value))
+        {
+            this->write(value > 0 ? "+Inf" : "-Inf");
+            return;
+        }
+
+        char digits[32];
+        auto result = std::to_chars(digits, digits + sizeof(digits), value);
+        this->write(string_view(digits, result.ptr - digits));
+    };
+
+    void escaped(string_view text)
+    {
+        for (char c : text)
+        {
+            if (c == '"' || c == '\\')
+            {
+                this->put('\\');
+                this->put(c);
+            }
+            else if (c == '\n')
+            {
+                this->write("\\n");
+            }
+            else
+            {
+                this->put(c);
+            }
+        }
+    };
+
+    void put(char c)
+    {
+        this->write(string_view(&c, 1));
+    };
+
+    void write(string_view text)
+    {
+        const char *data = text.data();
+        size_t length = text.size();
+        this->total += length;
+
+        while (length > 0 && this->err == ESP_OK)
+        {
+            if (this->used == this->size)
+            {
+                this->flushBuffer();
+                continue;
+            }
+
+            size_t part = std::min(length, this->size - this->used);
+            std::copy(data, data + part, this->buffer + this->used);
+            this->used += part;
+            data += part;
+            length -= part;
+        }
+    };
+
+    void flushBuffer()
+    {
+        if (this->used > 0 && this->err == ESP_OK)
+        {
+            this->err = this->flush(this->buffer, this->used);
+        }
+        this->used = 0;
+    };
+};
+
+#endif /* _MetricsWriter_H_ */
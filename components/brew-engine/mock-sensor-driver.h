@@ -0,0 +1,63 @@
+#ifndef _MockSensorDriver_H_
+#define _MockSensorDriver_H_
+
+#include <random>
+#include "sensor-driver.h"
+
+// Sensor without hardware, returns temperature plus some noise, errors and delays can be injected.
+// Doesn't depend on any esp driver so the read path can also run on a linux host.
+class MockSensorDriver : public SensorDriver
+{
+public:
+    float temperature = 20;
+    float noise = 0.1;           // max deviation in °C
+    uint16_t conversionTime = 10; // in ms
+    bool ready = true;            // when false Poll keeps returning false
+    esp_err_t nextError = ESP_OK; // returned once by the next Read
+
+    MockSensorDriver(float temperature, float noise)
+    {
+        this->temperature = temperature;
+        this->noise = noise;
+    };
+
+    esp_err_t Start() override
+    {
+        this->started = true;
+        return ESP_OK;
+    };
+
+    bool Poll() override
+    {
+        return this->started && this->ready;
+    };
+
+    esp_err_t Read(float &temperature) override
+    {
+        this->started = false;
+
+        if (this->nextError != ESP_OK)
+        {
+            esp_err_t err = this->nextError;
+            this->nextError = ESP_OK;
+            return err;
+        }
+
+        std::uniform_real_distribution<float> distribution(-this->noise, this->noise);
+        temperature = this->temperature + distribution(this->generator);
+
+        return ESP_OK;
+    };
+
+    uint16_t ConversionTime() override
+    {
+        return this->conversionTime;
+    };
+
+protected:
+private:
+    bool started = false;
+    std::minstd_rand generator;
+};
+
+#endif /* _MockSensorDriver_H_ */
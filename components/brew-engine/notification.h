@@ -3,6 +3,7 @@
 
 #include <chrono>
 #include "nlohmann_json.hpp"
+#include "json-check.h"
 
 using namespace std;
 using namespace std::chrono;
@@ -37,6 +38,12 @@ public:
         return jNotification;
     }
 
+    // what from_json needs, for notifications we get from a client
+    static JsonCheck check_json(const json &jsonData)
+    {
+        return JsonCheck(jsonData).String("name").Number("timeFromStart").Bool("buzzer");
+    }
+
     void from_json(const json &jsonData)
     {
         this->name = jsonData["name"].get<string>();
@@ -44,7 +51,7 @@ public:
         this->buzzer = jsonData["buzzer"].get<bool>();
         this->done = false; // this can never come from json, always from control loop
 
-        if (!jsonData["message"].is_null() && jsonData["message"].is_string())
+        if (jsonData.contains("message") && jsonData["message"].is_string())
         {
             this->message = jsonData["message"];
         }
@@ -0,0 +1,117 @@
+#ifndef _RequestReader_H_
+#define _RequestReader_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <esp_http_server.h>
+
+#define REQUEST_READER_BUFFER_SIZE 256
+
+// Reads a request body in small chunks while a parser walks over it, so the body is never held as a whole.
+// The iterators are single pass, they all share the reader, end is reached when the body is done or a read failed.
+class RequestReader
+{
+public:
+    class Iterator
+    {
+    public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type = char;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const char *;
+        using reference = const char &;
+
+        Iterator(RequestReader *reader)
+        {
+            this->reader = reader;
+        };
+
+        reference operator*() const
+        {
+            return this->reader->buffer[this->reader->position];
+        };
+
+        Iterator &operator++()
+        {
+            this->reader->position++;
+            return *this;
+        };
+
+        bool operator==(const Iterator &other) const
+        {
+            return this->atEnd() == other.atEnd();
+        };
+
+    private:
+        RequestReader *reader;
+
+        bool atEnd() const
+        {
+            return this->reader == NULL || !this->reader->fill();
+        };
+    };
+
+    RequestReader(httpd_req_t *req)
+    {
+        this->req = req;
+        this->remaining = req->content_len;
+    };
+
+    Iterator begin()
+    {
+        return Iterator(this);
+    };
+
+    Iterator end()
+    {
+        return Iterator(NULL);
+    };
+
+    // ESP_OK when the body was read without socket errors
+    esp_err_t Error()
+    {
+        return this->err;
+    };
+
+protected:
+private:
+    httpd_req_t *req;
+    size_t remaining;
+    char buffer[REQUEST_READER_BUFFER_SIZE];
+    size_t position = 0;
+    size_t length = 0;
+    esp_err_t err = ESP_OK;
+
+    // true when there is a byte at position, reads the next chunk when we used the last one
+    bool fill()
+    {
+        while (this->position >= this->length)
+        {
+            if (this->remaining == 0 || this->err != ESP_OK)
+            {
+                return false;
+            }
+
+            int received = httpd_req_recv(this->req, this->buffer, std::min(this->remaining, sizeof(this->buffer)));
+            if (received == HTTPD_SOCK_ERR_TIMEOUT)
+            {
+                // timeout, just continue
+                continue;
+            }
+            if (received <= 0)
+            {
+                this->err = ESP_FAIL;
+                return false;
+            }
+
+            this->remaining -= received;
+            this->position = 0;
+            this->length = received;
+        }
+
+        return true;
+    };
+};
+
+#endif /* _RequestReader_H_ */
@@ -0,0 +1,34 @@
+#ifndef _SensorDriver_H_
+#define _SensorDriver_H_
+
+#include "esp_err.h"
+
+enum SensorType
+{
+    SensorDS18B20 = 0,  // 1-Wire, found by detection
+    SensorMAX31865 = 1, // PT100/PT1000 RTD over SPI
+    SensorMAX31855 = 2, // K-type thermocouple over SPI
+    SensorMock = 3      // no hardware, for simulation and host tests
+};
+
+// Async interface for all temperature sensor backends, the read loop starts a conversion,
+// waits at least ConversionTime without blocking and then polls and reads.
+class SensorDriver
+{
+public:
+    virtual ~SensorDriver() {};
+
+    virtual esp_err_t Init() { return ESP_OK; };
+    virtual esp_err_t Start() = 0;                  // start a conversion, must not wait for it
+    virtual bool Poll() = 0;                        // true when the conversion is done and Read can be called
+    virtual esp_err_t Read(float &temperature) = 0; // result in °C
+    virtual uint16_t ConversionTime() = 0;          // time in ms a conversion takes at the current settings
+
+    // only some sensors support changing resolution
+    virtual esp_err_t SetResolution(uint8_t resolution) { return ESP_ERR_NOT_SUPPORTED; };
+
+protected:
+private:
+};
+
+#endif /* _SensorDriver_H_ */
@@ -0,0 +1,102 @@
+#ifndef _SensorStats_H_
+#define _SensorStats_H_
+
+#include <array>
+#include <cmath>
+#include "esp_err.h"
+#include "nlohmann_json.hpp"
+
+using namespace std;
+using json = nlohmann::json;
+
+#define SENSOR_NOISE_WINDOW 16 // nr of sample to sample differences the noise is calculated over
+
+// Health counters of one sensor, all runtime, they start over on reboot
+class SensorStats
+{
+public:
+    uint32_t reads = 0;     // successful reads
+    uint32_t crcErrors = 0; // scratchpad or spi data didn't check out
+    uint32_t timeouts = 0;  // conversion wasn't done when we wanted to read
+    uint32_t errors = 0;    // other read errors
+
+    // conversion latency in µs, from the start of the conversion until the value was read
+    uint32_t latencyMin = 0;
+    uint32_t latencyMax = 0;
+    uint64_t latencySum = 0;
+
+    void AddRead(float temperature, uint32_t latency)
+    {
+        if (this->reads == 0 || latency < this->latencyMin)
+        {
+            this->latencyMin = latency;
+        }
+        this->latencyMax = std::max(this->latencyMax, latency);
+        this->latencySum += latency;
+
+        // differences between samples remove the slow heating trend, what is left is mostly noise
+        if (this->reads > 0)
+        {
+            float difference = temperature - this->lastTemperature;
+            this->noiseSum -= this->differences[this->next];
+            this->differences[this->next] = difference * difference;
+            this->noiseSum += this->differences[this->next];
+            this->next = (this->next + 1) % SENSOR_NOISE_WINDOW;
+            this->count = std::min<uint8_t>(this->count + 1, SENSOR_NOISE_WINDOW);
+        }
+
+        this->lastTemperature = temperature;
+        this->reads++;
+    };
+
+    void AddError(esp_err_t err)
+    {
+        if (err == ESP_ERR_INVALID_CRC)
+        {
+            this->crcErrors++;
+        }
+        else if (err == ESP_ERR_TIMEOUT)
+        {
+            this->timeouts++;
+        }
+        else
+        {
+            this->errors++;
+        }
+    };
+
+    // standard deviation of a sample, the difference of two samples has twice the variance
+    float Noise()
+    {
+        if (this->count == 0)
+        {
+            return 0;
+        }
+        return std::sqrt(std::max(0.0, this->noiseSum) / this->count / 2);
+    };
+
+    json to_json()
+    {
+        json jStats;
+        jStats["reads"] = this->reads;
+        jStats["crcErrors"] = this->crcErrors;
+        jStats["timeouts"] = this->timeouts;
+        jStats["errors"] = this->errors;
+        jStats["latencyMin"] = this->latencyMin / 1000;
+        jStats["latencyAvg"] = this->reads > 0 ? (uint32_t)(this->latencySum / this->reads / 1000) : 0;
+        jStats["latencyMax"] = this->latencyMax / 1000;
+        jStats["noise"] = (double)((int)(this->Noise() * 1000)) / 1000; // round float to 0.001 for display
+
+        return jStats;
+    };
+
+protected:
+private:
+    float lastTemperature = 0;
+    std::array<float, SENSOR_NOISE_WINDOW> differences = {};
+    double noiseSum = 0; // running sum of the window, double so removing values doesn't drift
+    uint8_t next = 0;
+    uint8_t count = 0;
+};
+
+#endif /* _SensorStats_H_ */
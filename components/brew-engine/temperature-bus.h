@@ -0,0 +1,128 @@
+#ifndef _TemperatureBus_H_
+#define _TemperatureBus_H_
+
+#include "driver/spi_master.h"
+#include "nlohmann_json.hpp"
+
+using namespace std;
+using json = nlohmann::json;
+
+#define ONEWIRE_MAX_DS18B20 10 // default max sensors per bus
+
+enum BusType
+{
+    BusOneWire = 0,
+    BusSpi = 1,
+    BusVirtual = 2 // no hardware, only hosts mock sensors
+};
+
+class TemperatureBus
+{
+public:
+    uint8_t id;
+    BusType type;
+    gpio_num_t pinNr; // 1-Wire data pin
+    uint8_t maxSensors;
+    uint16_t interval; // sample period in ms, 0 uses the global read interval
+
+    // spi only, chip selects are set per sensor
+    gpio_num_t misoPin;
+    gpio_num_t mosiPin;
+    gpio_num_t clkPin;
+
+    // runtime, doesn't go to json
+    bool ready;                   // true when the bus hardware is initialized
+    onewire_bus_handle_t handle;  // rmt backed bus, 1-Wire only
+    spi_host_device_t spiHost;    // spi only
+    TaskHandle_t readLoopHandle;  // every bus has its own acquisition task
+    esp_timer_handle_t readTimer; // wakes the read loop when a conversion or period is done
+    uint32_t lastSweepTime;       // time in ms it took to convert and read all sensors on this bus
+    int64_t conversionStart;      // esp_timer time the last conversion was started, for sensor latency
+
+    // background discovery, runs in the idle gaps of the read loop
+    onewire_device_iter_handle_t searchIter; // open while a search pass is in progress
+    int64_t nextSearch;                      // esp_timer time of the next pass, 0 for as soon as possible
+    uint8_t searchCount;                     // ds18b20s found in the current pass
+    uint32_t searchPasses;                   // completed passes, so we can wait for one
+
+    json to_json()
+    {
+        json jBus;
+        jBus["id"] = this->id;
+        jBus["type"] = this->type;
+        jBus["pinNr"] = this->pinNr;
+        jBus["maxSensors"] = this->maxSensors;
+        jBus["interval"] = this->interval;
+
+        if (this->type == BusSpi)
+        {
+            jBus["misoPin"] = this->misoPin;
+            jBus["mosiPin"] = this->mosiPin;
+            jBus["clkPin"] = this->clkPin;
+        }
+
+        return jBus;
+    };
+
+    void from_json(const json &jsonData)
+    {
+        this->id = jsonData["id"].get<uint8_t>();
+
+        if (jsonData.contains("type") && jsonData["type"].is_number())
+        {
+            this->type = (BusType)jsonData["type"].get<uint8_t>();
+        }
+        else
+        {
+            this->type = BusOneWire;
+        }
+
+        this->pinNr = (gpio_num_t)this->pin_from_json(jsonData, "pinNr");
+        this->misoPin = (gpio_num_t)this->pin_from_json(jsonData, "misoPin");
+        this->mosiPin = (gpio_num_t)this->pin_from_json(jsonData, "mosiPin");
+        this->clkPin = (gpio_num_t)this->pin_from_json(jsonData, "clkPin");
+
+        if (jsonData.contains("interval") && jsonData["interval"].is_number())
+        {
+            this->interval = jsonData["interval"].get<uint16_t>();
+        }
+        else
+        {
+            this->interval = 0;
+        }
+
+        if (jsonData.contains("maxSensors") && jsonData["maxSensors"].is_number())
+        {
+            this->maxSensors = jsonData["maxSensors"].get<uint8_t>();
+        }
+        else
+        {
+            this->maxSensors = ONEWIRE_MAX_DS18B20;
+        }
+
+        this->ready = false;
+        this->handle = NULL;
+        this->spiHost = SPI2_HOST;
+        this->readLoopHandle = NULL;
+        this->readTimer = NULL;
+        this->lastSweepTime = 0;
+        this->conversionStart = 0;
+        this->searchIter = NULL;
+        this->nextSearch = 0;
+        this->searchCount = 0;
+        this->searchPasses = 0;
+    };
+
+protected:
+private:
+    int pin_from_json(const json &jsonData, const char *key)
+    {
+        if (jsonData.contains(key) && jsonData[key].is_number())
+        {
+            return jsonData[key].get<int>();
+        }
+        return GPIO_NUM_NC;
+    };
+};
+
+#endif /* _TemperatureBus_H_ */
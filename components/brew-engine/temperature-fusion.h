@@ -0,0 +1,195 @@
+#ifndef _TemperatureFusion_H_
+#define _TemperatureFusion_H_
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <map>
+#include <optional>
+
+using namespace std;
+
+#define FUSION_MEDIAN_WINDOW 3        // odd, 3 already removes single spikes like the 85°C power-on value
+#define FUSION_STALE_TIME 30000000    // in µs, older samples are dropped from the median window
+#define FUSION_MIN_VARIANCE 0.0025    // 0.05° std, below that a sensor would get all the weight
+#define FUSION_INITIAL_VARIANCE 0.25  // we don't know the noise of a new sensor yet
+#define FUSION_MAX_GAP 60000000       // in µs, longer without measurement restarts the estimate
+
+// Median and noise state of one sensor, fed with compensated readings.
+// Until the window is full there is no median, so a power-on value can't get in before it can be voted out.
+class SensorFilter
+{
+public:
+    float value = 0;                           // median of the window, mean of the samples while it fills
+    float variance = FUSION_INITIAL_VARIANCE;  // recent noise, ewma of the squared deviation from the median
+    uint32_t outliers = 0;                     // rejected samples since start
+    bool control = false;                      // the sensor is used for control, set with every sample
+    int64_t lastTime = 0;                      // time of the last sample
+
+    // returns false when the sample was an outlier, value then stays the median and ignores it
+    bool Add(float temperature, int64_t time)
+    {
+        if (this->count > 0 && time - this->lastTime > FUSION_STALE_TIME)
+        {
+            this->count = 0;
+            this->variance = FUSION_INITIAL_VARIANCE;
+        }
+        this->lastTime = time;
+
+        // ring buffer, the median is taken over the sorted copy
+        this->window[this->next] = temperature;
+        this->next = (this->next + 1) % FUSION_MEDIAN_WINDOW;
+        this->count = std::min<uint8_t>(this->count + 1, FUSION_MEDIAN_WINDOW);
+
+        std::array<float, FUSION_MEDIAN_WINDOW> sorted = this->window;
+        std::sort(sorted.begin(), sorted.begin() + this->count);
+        this->value = this->count % 2 == 0 ? (sorted[this->count / 2 - 1] + sorted[this->count / 2]) / 2 : sorted[this->count / 2];
+
+        if (!this->Ready())
+        {
+            return true;
+        }
+
+        // the spread is only measured against a real median
+        float deviation = temperature - this->value;
+        float limit = std::max(1.0f, 4 * std::sqrt(this->variance));
+        if (std::abs(deviation) > limit)
+        {
+            this->outliers++;
+            return false;
+        }
+
+        this->variance = std::max<float>(FUSION_MIN_VARIANCE, 0.9f * this->variance + 0.1f * deviation * deviation);
+        return true;
+    };
+
+    // true when the window is full and value is a median
+    bool Ready()
+    {
+        return this->count == FUSION_MEDIAN_WINDOW;
+    };
+
+protected:
+private:
+    std::array<float, FUSION_MEDIAN_WINDOW> window = {};
+    uint8_t next = 0;
+    uint8_t count = 0;
+};
+
+// Combines the control sensors into one estimate, a noise weighted mean of the medians goes into a
+// constant rate kalman filter, so we get temperature and its rate of change with less lag then averaging over time.
+// Update fuses the latest median of every control sensor, it should be called once per read period and not per bus,
+// a mean over only some of the sensors would turn the offset between sensors into a rate.
+// Doesn't use any esp api, times are passed in µs so it can be fed with recorded traces.
+class TemperatureFusion
+{
+public:
+    float processNoise = 0.00001; // how fast the heating rate can change, in (°/s²)²
+
+    // sample of a sensor, returns the median filtered value, nothing while the median window fills
+    std::optional<float> AddSample(uint64_t sensorId, float temperature, int64_t time, bool useForControl)
+    {
+        SensorFilter &filter = this->filters[sensorId];
+        filter.control = useForControl;
+        filter.Add(temperature, time);
+
+        if (!filter.Ready())
+        {
+            return std::nullopt;
+        }
+
+        return filter.value;
+    };
+
+    // fuse the medians of all control sensors, false when none has one
+    bool Update(int64_t time)
+    {
+        // inverse variance weighting, a noisy sensor counts less
+        float weightSum = 0;
+        float weightedSum = 0;
+        for (auto &[key, filter] : this->filters)
+        {
+            if (filter.control && filter.Ready() && time - filter.lastTime <= FUSION_STALE_TIME)
+            {
+                float weight = 1 / filter.variance;
+                weightSum += weight;
+                weightedSum += weight * filter.value;
+            }
+        }
+
+        if (weightSum == 0)
+        {
+            return false;
+        }
+
+        float measurement = weightedSum / weightSum;
+        float measurementVariance = 1 / weightSum;
+
+        if (!this->valid || time - this->lastTime > FUSION_MAX_GAP)
+        {
+            this->temperature = measurement;
+            this->rate = 0;
+            this->p00 = measurementVariance;
+            this->p01 = 0;
+            this->p11 = 0.01;
+            this->lastTime = time;
+            this->valid = true;
+            return true;
+        }
+
+        float dt = (float)(time - this->lastTime) / 1000000;
+        this->lastTime = time;
+
+        // predict, x = F x, P = F P F' + Q
+        this->temperature += this->rate * dt;
+        float p00 = this->p00 + dt * (2 * this->p01 + dt * this->p11) + this->processNoise * dt * dt * dt / 3;
+        float p01 = this->p01 + dt * this->p11 + this->processNoise * dt * dt / 2;
+        float p11 = this->p11 + this->processNoise * dt;
+
+        // update, we only measure temperature
+        float innovation = measurement - this->temperature;
+        float s = p00 + measurementVariance;
+        float k0 = p00 / s;
+        float k1 = p01 / s;
+
+        this->temperature += k0 * innovation;
+        this->rate += k1 * innovation;
+        this->p00 = (1 - k0) * p00;
+        this->p01 = (1 - k0) * p01;
+        this->p11 = p11 - k1 * p01;
+
+        return true;
+    };
+
+    void Remove(uint64_t sensorId)
+    {
+        this->filters.erase(sensorId);
+    };
+
+    SensorFilter *Filter(uint64_t sensorId)
+    {
+        auto it = this->filters.find(sensorId);
+        return it == this->filters.end() ? NULL : &it->second;
+    };
+
+    bool Valid() { return this->valid; };
+    float Temperature() { return this->temperature; };
+    float Rate() { return this->rate; }; // in °/s
+
+protected:
+private:
+    std::map<uint64_t, SensorFilter> filters;
+
+    bool valid = false;
+    int64_t lastTime = 0;
+    float temperature = 0;
+    float rate = 0;
+
+    // covariance, symmetric so p10 is p01
+    float p00 = 0;
+    float p01 = 0;
+    float p11 = 0;
+};
+
+#endif /* _TemperatureFusion_H_ */
@@ -2,14 +2,28 @@
 #define _TemperatureSensor_H_
 
 #include "nlohmann_json.hpp"
+#include "json-check.h"
+#include "sensor-driver.h"
+#include "sensor-stats.h"
 
 using namespace std;
 using json = nlohmann::json;
 
+enum SensorResolution
+{
+    ResolutionAuto = 0, // fast 10 bit while far from target or boiling, 12 bit when close to target
+    Resolution9Bit = 9,
+    Resolution10Bit = 10,
+    Resolution11Bit = 11,
+    Resolution12Bit = 12
+};
+
 class TemperatureSensor
 {
 public:
     uint64_t id;
+    uint8_t busId; // id of the bus the sensor was found on or is connected to
+    SensorType type;
     string name;
     string color;
     bool show;
@@ -18,12 +32,30 @@ public:
     float compensateAbsolute;
     float compensateRelative;
     float lastTemp;
-    ds18b20_device_handle_t handle;
+    SensorResolution resolution; // configured resolution policy
+    uint8_t activeResolution;    // runtime, resolution in bits currently set in the sensor
+    float sampleRate;            // runtime, effective samples per second
+    int64_t lastReadTime;        // runtime, esp_timer time of the last successful read
+    SensorDriver *driver;        // runtime, backend for the sensor type, NULL when not detected yet
+    uint8_t driverBusId;         // runtime, bus whose read task uses the driver
+    SensorDriver *nextDriver;    // runtime, replacement the read task of driverBusId swaps in, see handOverDrivers
+    bool replaceDriver;          // runtime, nextDriver is waiting, it can be NULL to just drop the driver
+    bool nextConnected;          // runtime, connected state that goes with nextDriver
+    uint8_t consecutiveErrors;   // runtime, failed reads in a row, the sensor is disconnected after a few
+    SensorStats stats;           // runtime, health and latency counters
+
+    // spi sensors only, 1-Wire sensors are found by detection
+    gpio_num_t csPin;
+    uint16_t rtdNominal;  // 100 for PT100, 1000 for PT1000
+    uint16_t refResistor; // reference resistor on the max31865 board
+    uint8_t rtdWires;     // 2, 3 or 4 wire rtd
 
     json to_json()
     {
         json jSensor;
         jSensor["id"] = to_string(this->id); // js doesn't support uint64_t, so we convert to string
+        jSensor["busId"] = this->busId;
+        jSensor["type"] = this->type;
         jSensor["name"] = this->name;
         jSensor["color"] = this->color;
         jSensor["show"] = this->show;
@@ -32,10 +64,31 @@ public:
         jSensor["compensateAbsolute"] = this->compensateAbsolute;
         jSensor["compensateRelative"] = this->compensateRelative;
         jSensor["lastTemp"] = (double)((int)(this->lastTemp * 10)) / 10; // round float to 0.1 for display
+        jSensor["resolution"] = this->resolution;
+        jSensor["activeResolution"] = this->activeResolution;
+        jSensor["sampleRate"] = (double)((int)(this->sampleRate * 100)) / 100; // round float to 0.01 for display
+
+        if (this->type == SensorMAX31865 || this->type == SensorMAX31855)
+        {
+            jSensor["csPin"] = this->csPin;
+        }
+
+        if (this->type == SensorMAX31865)
+        {
+            jSensor["rtdNominal"] = this->rtdNominal;
+            jSensor["refResistor"] = this->refResistor;
+            jSensor["rtdWires"] = this->rtdWires;
+        }
 
         return jSensor;
     };
 
+    // a sensor in the settings we get from a client, new manual sensors come without id, name and color
+    static JsonCheck check_json(const json &jsonData)
+    {
+        return JsonCheck(jsonData).String("id", false).String("name", false).String("color", false);
+    };
+
     void from_json(const json &jsonData)
     {
         string stringId = jsonData["id"].get<string>(); // js doesn't support uint64_t, so we convert it from string
@@ -45,7 +98,16 @@ public:
         this->name = (string)jsonData["name"];
         this->color = (string)jsonData["color"];
 
-        if (!jsonData["show"].is_null() && jsonData["show"].is_boolean())
+        if (jsonData.contains("busId") && jsonData["busId"].is_number())
+        {
+            this->busId = jsonData["busId"].get<uint8_t>();
+        }
+        else
+        {
+            this->busId = 0;
+        }
+
+        if (jsonData.contains("show") && jsonData["show"].is_boolean())
         {
             this->show = jsonData["show"];
         }
@@ -54,7 +116,7 @@ public:
             this->show = true;
         }
 
-        if (!jsonData["useForControl"].is_null() && jsonData["useForControl"].is_boolean())
+        if (jsonData.contains("useForControl") && jsonData["useForControl"].is_boolean())
         {
             this->useForControl = jsonData["useForControl"];
         }
@@ -63,7 +125,7 @@ public:
             this->useForControl = true;
         }
 
-        if (!jsonData["compensateAbsolute"].is_null() && jsonData["compensateAbsolute"].is_number_float())
+        if (jsonData.contains("compensateAbsolute") && jsonData["compensateAbsolute"].is_number_float())
         {
             this->compensateAbsolute = (float)jsonData["compensateAbsolute"];
         }
@@ -72,7 +134,7 @@ public:
             this->compensateAbsolute = 0;
         }
 
-        if (!jsonData["compensateRelative"].is_null() && jsonData["compensateRelative"].is_number_float())
+        if (jsonData.contains("compensateRelative") && jsonData["compensateRelative"].is_number_float())
         {
             this->compensateRelative = (float)jsonData["compensateRelative"];
         }
@@ -81,8 +143,77 @@ public:
             this->compensateRelative = 1;
         }
 
+        if (jsonData.contains("resolution") && jsonData["resolution"].is_number())
+        {
+            this->resolution = (SensorResolution)jsonData["resolution"].get<uint8_t>();
+        }
+        else
+        {
+            this->resolution = ResolutionAuto;
+        }
+
+        this->driver_from_json(jsonData);
+
         // will be set by detection
+        this->driver = NULL;
+        this->driverBusId = this->busId;
+        this->nextDriver = NULL;
+        this->replaceDriver = false;
+        this->nextConnected = false;
         this->connected = false;
+        this->activeResolution = 0;
+        this->consecutiveErrors = 0;
+        this->sampleRate = 0;
+        this->lastReadTime = 0;
+    };
+
+    // driver settings can also change at runtime, so they are seperate
+    void driver_from_json(const json &jsonData)
+    {
+        if (jsonData.contains("type") && jsonData["type"].is_number())
+        {
+            this->type = (SensorType)jsonData["type"].get<uint8_t>();
+        }
+        else
+        {
+            this->type = SensorDS18B20;
+        }
+
+        if (jsonData.contains("csPin") && jsonData["csPin"].is_number())
+        {
+            this->csPin = (gpio_num_t)jsonData["csPin"].get<int>();
+        }
+        else
+        {
+            this->csPin = GPIO_NUM_NC;
+        }
+
+        if (jsonData.contains("rtdNominal") && jsonData["rtdNominal"].is_number())
+        {
+            this->rtdNominal = jsonData["rtdNominal"].get<uint16_t>();
+        }
+        else
+        {
+            this->rtdNominal = 100;
+        }
+
+        if (jsonData.contains("refResistor") && jsonData["refResistor"].is_number())
+        {
+            this->refResistor = jsonData["refResistor"].get<uint16_t>();
+        }
+        else
+        {
+            this->refResistor = 430;
+        }
+
+        if (jsonData.contains("rtdWires") && jsonData["rtdWires"].is_number())
+        {
+            this->rtdWires = jsonData["rtdWires"].get<uint8_t>();
+        }
+        else
+        {
+            this->rtdWires = 3;
+        }
     };
 
 protected:
@@ -0,0 +1,460 @@
+#ifndef _TimeSeries_H_
+#define _TimeSeries_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <ctime>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+#define TIMESERIES_MISSING INT16_MIN // value of a channel that had no sample in a row
+#define TIMESERIES_NO_BLOCK 0xFFFF
+
+// Fixed size columnar store, rows share one time column and every channel has its own column of int16 values.
+// Memory is a pool of blocks allocated once, when it runs out the oldest block of any column is reused.
+// A block holds zigzag varint deltas to the previous value of its column, a steady channel takes 1 byte per row.
+// Every row gets a sequence number, readers keep it as cursor so they only get what is new.
+class TimeSeries
+{
+public:
+    TimeSeries(uint16_t blockSize, uint16_t blockCount)
+    {
+        this->blockSize = blockSize;
+        this->blockCount = blockCount;
+        this->data = std::make_unique<uint8_t[]>(blockSize * blockCount);
+        this->blocks = std::make_unique<Block[]>(blockCount);
+        this->Clear();
+    };
+
+    // channels we don't know yet are added, known channels that are not in values get a missing value
+    void Append(time_t time, const std::map<string, int16_t> &values)
+    {
+        for (auto const &[name, value] : values)
+        {
+            if (this->findColumn(name) < 0)
+            {
+                Column column;
+                column.name = name;
+                this->columns.push_back(column);
+            }
+        }
+
+        uint32_t seq = this->nextSeq++;
+
+        this->appendValue(this->timeColumn, seq, time, true);
+
+        for (auto &column : this->columns)
+        {
+            auto it = values.find(column.name);
+            if (it != values.end() && it->second != TIMESERIES_MISSING)
+            {
+                this->appendValue(column, seq, it->second, true);
+            }
+            else
+            {
+                this->appendValue(column, seq, 0, false);
+            }
+        }
+
+        this->lastTime = time;
+    };
+
+    // true when a row with these values wouldn't add anything
+    bool SameAsLast(const std::map<string, int16_t> &values)
+    {
+        if (this->Empty())
+        {
+            return false;
+        }
+
+        for (auto const &column : this->columns)
+        {
+            auto it = values.find(column.name);
+            bool present = it != values.end() && it->second != TIMESERIES_MISSING;
+
+            if (present != column.lastPresent || (present && it->second != column.lastValue))
+            {
+                return false;
+            }
+        }
+
+        // a channel we don't know yet
+        return std::all_of(values.begin(), values.end(), [this](auto const &value)
+                           { return this->findColumn(value.first) >= 0; });
+    };
+
+    // calls callback for every row with a sequence nr of at least cursor, values are in the order of channels
+    // and TIMESERIES_MISSING when the channel had no value, returns the cursor for the next read
+    // maxRows limits the rows of one read, so a reader can read in batches
+    uint32_t Read(uint32_t cursor, const vector<string> &channels, const std::function<void(time_t time, const int16_t *values)> &callback, uint32_t maxRows = UINT32_MAX)
+    {
+        vector<Decoder> decoders;
+        for (auto const &channel : channels)
+        {
+            int index = this->findColumn(channel);
+            decoders.push_back(this->decoder(index < 0 ? TIMESERIES_NO_BLOCK : this->columns[index].firstBlock));
+        }
+
+        vector<int16_t> values(channels.size());
+
+        uint32_t rows = 0;
+
+        for (uint16_t block = this->timeColumn.firstBlock; block != TIMESERIES_NO_BLOCK; block = this->blocks[block].next)
+        {
+            // blocks decode on their own, so we don't need to decode what the reader already has
+            if (this->blocks[block].firstSeq + this->blocks[block].count <= cursor)
+            {
+                continue;
+            }
+
+            const uint8_t *position = this->blockData(block);
+            int64_t time = this->blocks[block].base;
+
+            for (uint16_t n = 0; n < this->blocks[block].count; n++)
+            {
+                time += decodeDelta(position);
+
+                uint32_t seq = this->blocks[block].firstSeq + n;
+                if (seq < cursor)
+                {
+                    continue;
+                }
+
+                for (size_t i = 0; i < decoders.size(); i++)
+                {
+                    values[i] = this->valueAt(decoders[i], seq);
+                }
+
+                callback((time_t)time, values.data());
+
+                if (++rows >= maxRows)
+                {
+                    return seq + 1;
+                }
+            }
+        }
+
+        return this->nextSeq;
+    };
+
+    vector<string> Channels()
+    {
+        vector<string> names;
+        for (auto const &column : this->columns)
+        {
+            names.push_back(column.name);
+        }
+        return names;
+    };
+
+    size_t ChannelCount()
+    {
+        return this->columns.size();
+    };
+
+    const string &ChannelName(size_t index)
+    {
+        return this->columns[index].name;
+    };
+
+    // frees the blocks of a channel, for sensors that are removed
+    void RemoveChannel(const string &name)
+    {
+        int index = this->findColumn(name);
+        if (index < 0)
+        {
+            return;
+        }
+
+        while (this->columns[index].firstBlock != TIMESERIES_NO_BLOCK)
+        {
+            this->freeFirstBlock(this->columns[index]);
+        }
+        this->columns.erase(this->columns.begin() + index);
+    };
+
+    bool Empty()
+    {
+        return this->timeColumn.firstBlock == TIMESERIES_NO_BLOCK;
+    };
+
+    time_t LastTime()
+    {
+        return this->lastTime;
+    };
+
+    // sequence nr the next row will get
+    uint32_t NextSeq()
+    {
+        return this->nextSeq;
+    };
+
+    // sequence numbers keep counting, so a client cursor from before the clear doesn't get old data
+    void Clear()
+    {
+        this->columns.clear();
+        this->timeColumn = Column();
+        this->lastTime = 0;
+
+        // all blocks go to the free list
+        for (uint16_t i = 0; i < this->blockCount; i++)
+        {
+            this->blocks[i].next = i + 1 < this->blockCount ? i + 1 : TIMESERIES_NO_BLOCK;
+        }
+        this->freeBlock = 0;
+    };
+
+    size_t MemoryUsage()
+    {
+        return this->blockCount * (this->blockSize + sizeof(Block));
+    };
+
+protected:
+private:
+    struct Block
+    {
+        int64_t base;      // value the first delta is relative to
+        uint32_t firstSeq; // sequence nr of the first value
+        uint16_t count;    // values in the block
+        uint16_t used;     // bytes used in data
+        uint16_t next;     // next block of the column or the free list
+    };
+
+    struct Column
+    {
+        string name;
+        uint16_t firstBlock = TIMESERIES_NO_BLOCK;
+        uint16_t lastBlock = TIMESERIES_NO_BLOCK;
+        int64_t lastValue = 0; // last present value, the next delta is relative to it
+        bool lastPresent = false;
+    };
+
+    struct Decoder
+    {
+        uint16_t block;
+        uint16_t index; // next value to decode in the block
+        const uint8_t *position;
+        int64_t value;
+    };
+
+    uint16_t blockSize;
+    uint16_t blockCount;
+    std::unique_ptr<uint8_t[]> data;
+    std::unique_ptr<Block[]> blocks;
+    uint16_t freeBlock;
+    Column timeColumn;
+    vector<Column> columns;
+    uint32_t nextSeq = 0;
+    time_t lastTime = 0;
+
+    int findColumn(const string &name)
+    {
+        for (size_t i = 0; i < this->columns.size(); i++)
+        {
+            if (this->columns[i].name == name)
+            {
+                return i;
+            }
+        }
+        return -1;
+    };
+
+    uint8_t *blockData(uint16_t block)
+    {
+        return &this->data[block * this->blockSize];
+    };
+
+    void appendValue(Column &column, uint32_t seq, int64_t value, bool present)
+    {
+        // the lowest bit tells if there is a value, the rest is the zigzag delta
+        uint8_t encoded[10];
+        uint8_t length = 0;
+        if (present)
+        {
+            int64_t delta = value - column.lastValue;
+            length = writeVarint(encoded, (((uint64_t)delta << 1) ^ (uint64_t)(delta >> 63)) << 1);
+        }
+        else
+        {
+            encoded[length++] = 1;
+        }
+
+        if (column.lastBlock == TIMESERIES_NO_BLOCK || this->blocks[column.lastBlock].used + length > this->blockSize)
+        {
+            uint16_t block = this->allocateBlock();
+            if (block == TIMESERIES_NO_BLOCK)
+            {
+                return;
+            }
+
+            this->blocks[block].base = column.lastValue;
+            this->blocks[block].firstSeq = seq;
+            this->blocks[block].count = 0;
+            this->blocks[block].used = 0;
+            this->blocks[block].next = TIMESERIES_NO_BLOCK;
+
+            if (column.lastBlock == TIMESERIES_NO_BLOCK)
+            {
+                column.firstBlock = block;
+            }
+            else
+            {
+                this->blocks[column.lastBlock].next = block;
+            }
+            column.lastBlock = block;
+        }
+
+        Block &block = this->blocks[column.lastBlock];
+        std::copy(encoded, encoded + length, this->blockData(column.lastBlock) + block.used);
+        block.used += length;
+        block.count++;
+
+        if (present)
+        {
+            column.lastValue = value;
+        }
+        column.lastPresent = present;
+    };
+
+    uint16_t allocateBlock()
+    {
+        if (this->freeBlock == TIMESERIES_NO_BLOCK)
+        {
+            // full, the column with the oldest first block gives it up, blocks still being written are kept
+            Column *oldest = NULL;
+            for (Column *column : this->allColumns())
+            {
+                if (column->firstBlock != TIMESERIES_NO_BLOCK && column->firstBlock != column->lastBlock &&
+                    (oldest == NULL || this->blocks[column->firstBlock].firstSeq < this->blocks[oldest->firstBlock].firstSeq))
+                {
+                    oldest = column;
+                }
+            }
+
+            if (oldest == NULL)
+            {
+                return TIMESERIES_NO_BLOCK;
+            }
+
+            this->freeFirstBlock(*oldest);
+        }
+
+        uint16_t block = this->freeBlock;
+        this->freeBlock = this->blocks[block].next;
+        return block;
+    };
+
+    void freeFirstBlock(Column &column)
+    {
+        uint16_t block = column.firstBlock;
+        column.firstBlock = this->blocks[block].next;
+        if (column.firstBlock == TIMESERIES_NO_BLOCK)
+        {
+            column.lastBlock = TIMESERIES_NO_BLOCK;
+        }
+
+        this->blocks[block].next = this->freeBlock;
+        this->freeBlock = block;
+    };
+
+    vector<Column *> allColumns()
+    {
+        vector<Column *> all = {&this->timeColumn};
+        for (auto &column : this->columns)
+        {
+            all.push_back(&column);
+        }
+        return all;
+    };
+
+    Decoder decoder(uint16_t block)
+    {
+        Decoder decoder;
+        decoder.block = block;
+        decoder.index = 0;
+        if (block != TIMESERIES_NO_BLOCK)
+        {
+            decoder.position = this->blockData(block);
+            decoder.value = this->blocks[block].base;
+        }
+        return decoder;
+    };
+
+    // rows are read in order, so the decoder only moves forward
+    int16_t valueAt(Decoder &decoder, uint32_t seq)
+    {
+        while (decoder.block != TIMESERIES_NO_BLOCK)
+        {
+            Block &block = this->blocks[decoder.block];
+
+            if (decoder.index >= block.count || block.firstSeq + block.count <= seq)
+            {
+                decoder = this->decoder(block.next);
+                continue;
+            }
+
+            // the column started later or lost this row
+            uint32_t valueSeq = block.firstSeq + decoder.index;
+            if (valueSeq > seq)
+            {
+                return TIMESERIES_MISSING;
+            }
+
+            uint64_t code = readVarint(decoder.position);
+            decoder.index++;
+
+            bool present = (code & 1) == 0;
+            if (present)
+            {
+                code >>= 1;
+                decoder.value += (int64_t)(code >> 1) ^ -(int64_t)(code & 1);
+            }
+
+            if (valueSeq == seq)
+            {
+                return present ? (int16_t)decoder.value : TIMESERIES_MISSING;
+            }
+        }
+
+        return TIMESERIES_MISSING;
+    };
+
+    // the time column has no missing values, but uses the same encoding
+    static int64_t decodeDelta(const uint8_t *&position)
+    {
+        uint64_t code = readVarint(position) >> 1;
+        return (int64_t)(code >> 1) ^ -(int64_t)(code & 1);
+    };
+
+    static uint8_t writeVarint(uint8_t *buffer, uint64_t value)
+    {
+        uint8_t length = 0;
+        while (value >= 0x80)
+        {
+            buffer[length++] = (uint8_t)(value | 0x80);
+            value >>= 7;
+        }
+        buffer[length++] = (uint8_t)value;
+        return length;
+    };
+
+    static uint64_t readVarint(const uint8_t *&buffer)
+    {
+        uint64_t value = 0;
+        uint8_t shift = 0;
+        while (*buffer & 0x80)
+        {
+            value |= (uint64_t)(*buffer++ & 0x7F) << shift;
+            shift += 7;
+        }
+        value |= (uint64_t)(*buffer++) << shift;
+        return value;
+    };
+};
+
+#endif /* _TimeSeries_H_ */
@@ -38,6 +38,7 @@ Pop-Location
 
 # Copy to release
 Copy-Item build/esp-brew-engine.bin -Destination "release/esp-brew-engine_${target}_${version_file}.bin"
+Copy-Item build/webui.bin -Destination "release/esp-brew-engine-webui_${target}_${version_file}.bin"
 
 # Combine Loader Release
 esptool.py --chip $target merge_bin `
@@ -60,4 +61,5 @@ esptool.py --chip $target merge_bin `
   0x8000 loader/build/partition_table/partition-table.bin `
   0x40000 loader/build/esp-brew-engine-loader.bin `
   0x35000 misc/ota_boot_ota0.bin `
-  0x110000 build/esp-brew-engine.bin
+  0x110000 build/esp-brew-engine.bin `
+  0x33E000 build/webui.bin
@@ -44,6 +44,7 @@ cd ..
 
 # Copy to release
 cp build/esp-brew-engine.bin release/esp-brew-engine_${target}_${version_file}.bin
+cp build/webui.bin release/esp-brew-engine-webui_${target}_${version_file}.bin
 
 # Combine Loader Release to make it flashable with gui and web
 esptool.py --chip $target merge_bin \
@@ -66,4 +67,5 @@ esptool.py --chip $target merge_bin \
   0x8000 loader/build/partition_table/partition-table.bin \
   0x40000 loader/build/esp-brew-engine-loader.bin \
   0x35000 misc/ota_boot_ota0.bin \
-  0x110000 build/esp-brew-engine.bin
+  0x110000 build/esp-brew-engine.bin \
+  0x33E000 build/webui.bin
@@ -1,5 +1,5 @@
 #/bin/bash
-cp ./web/dist/index.html ./components/brew-engine/index.html
-gzip -f ./components/brew-engine/index.html 
+cp ./web/dist/index.html ./components/brew-engine/webui/index.html
+gzip -f ./components/brew-engine/webui/index.html 
 
-cp ./web/dist/manifest.json ./components/brew-engine/manifest.json
\ No newline at end of file
+cp ./web/dist/manifest.json ./components/brew-engine/webui/manifest.json
\ No newline at end of file
@@ -0,0 +1,200 @@
+// Minimal cbor (rfc 8949) for the api, the controller answers in cbor when we ask for it
+// Only what json can hold is supported, tags are skipped and byte strings become Uint8Array
+
+const textEncoder = new TextEncoder();
+const textDecoder = new TextDecoder();
+
+export function encodeCbor(value: any): Uint8Array {
+  const bytes: Array<number> = [];
+
+  const head = (major: number, argument: number) => {
+    const type = major << 5;
+    if (argument < 24) {
+      bytes.push(type | argument);
+    } else if (argument <= 0xff) {
+      bytes.push(type | 24, argument);
+    } else if (argument <= 0xffff) {
+      bytes.push(type | 25, argument >> 8, argument & 0xff);
+    } else if (argument <= 0xffffffff) {
+      bytes.push(type | 26, (argument >>> 24) & 0xff, (argument >> 16) & 0xff, (argument >> 8) & 0xff, argument & 0xff);
+    } else {
+      bytes.push(type | 27);
+      [Math.floor(argument / 0x100000000), argument >>> 0].forEach((part) => {
+        bytes.push((part >>> 24) & 0xff, (part >> 16) & 0xff, (part >> 8) & 0xff, part & 0xff);
+      });
+    }
+  };
+
+  const write = (item: any) => {
+    if (item === null || item === undefined) {
+      bytes.push(0xf6);
+    } else if (item === false || item === true) {
+      bytes.push(item ? 0xf5 : 0xf4);
+    } else if (typeof item === "number") {
+      if (Number.isSafeInteger(item)) {
+        head(item < 0 ? 1 : 0, item < 0 ? -1 - item : item);
+      } else {
+        const view = new DataView(new ArrayBuffer(8));
+        view.setFloat64(0, item);
+        bytes.push(0xfb, ...new Uint8Array(view.buffer));
+      }
+    } else if (typeof item === "string") {
+      const text = textEncoder.encode(item);
+      head(3, text.length);
+      bytes.push(...text);
+    } else if (Array.isArray(item)) {
+      head(4, item.length);
+      item.forEach(write);
+    } else {
+      // like JSON.stringify, undefined members are left out
+      const entries = Object.entries(item).filter(([, member]) => member !== undefined);
+      head(5, entries.length);
+      entries.forEach(([key, member]) => {
+        write(key);
+        write(member);
+      });
+    }
+  };
+
+  write(value);
+
+  return new Uint8Array(bytes);
+}
+
+export function decodeCbor(buffer: ArrayBuffer): any {
+  const view = new DataView(buffer);
+  let offset = 0;
+
+  const argument = (info: number): number => {
+    if (info < 24) {
+      return info;
+    }
+
+    let value: number;
+    if (info === 24) {
+      value = view.getUint8(offset);
+      offset += 1;
+    } else if (info === 25) {
+      value = view.getUint16(offset);
+      offset += 2;
+    } else if (info === 26) {
+      value = view.getUint32(offset);
+      offset += 4;
+    } else if (info === 27) {
+      value = view.getUint32(offset) * 0x100000000 + view.getUint32(offset + 4);
+      offset += 8;
+    } else {
+      throw new Error(`Invalid cbor length ${info}`);
+    }
+    return value;
+  };
+
+  // the controller sends temperatures as float32, back to the digits it meant
+  const float16 = (half: number) => {
+    const exponent = (half >> 10) & 0x1f;
+    const fraction = half & 0x3ff;
+    const sign = half & 0x8000 ? -1 : 1;
+    if (exponent === 0) {
+      return sign * 2 ** -14 * (fraction / 1024);
+    }
+    if (exponent === 0x1f) {
+      return fraction ? NaN : sign * Infinity;
+    }
+    return sign * 2 ** (exponent - 15) * (1 + fraction / 1024);
+  };
+
+  const read = (): any => {
+    const initial = view.getUint8(offset);
+    offset += 1;
+    const major = initial >> 5;
+    const info = initial & 0x1f;
+
+    if (major === 7) {
+      switch (info) {
+        case 20:
+          return false;
+        case 21:
+          return true;
+        case 22:
+        case 23:
+          return null;
+        case 25: {
+          const value = float16(view.getUint16(offset));
+          offset += 2;
+          return value;
+        }
+        case 26: {
+          const value = view.getFloat32(offset);
+          offset += 4;
+          return Number.isFinite(value) ? Number(value.toPrecision(7)) : value;
+        }
+        case 27: {
+          const value = view.getFloat64(offset);
+          offset += 8;
+          return value;
+        }
+        default:
+          throw new Error(`Unsupported cbor simple value ${info}`);
+      }
+    }
+
+    const indefinite = info === 31;
+    const length = indefinite ? 0 : argument(info);
+    const atBreak = () => {
+      if (view.getUint8(offset) === 0xff) {
+        offset += 1;
+        return true;
+      }
+      return false;
+    };
+
+    switch (major) {
+      case 0:
+        return length;
+      case 1:
+        return -1 - length;
+      case 2:
+      case 3: {
+        const chunks: Array<Uint8Array> = [];
+        if (indefinite) {
+          while (!atBreak()) {
+            const chunkInfo = view.getUint8(offset) & 0x1f;
+            offset += 1;
+            const chunkLength = argument(chunkInfo);
+            chunks.push(new Uint8Array(buffer, offset, chunkLength));
+            offset += chunkLength;
+          }
+        } else {
+          chunks.push(new Uint8Array(buffer, offset, length));
+          offset += length;
+        }
+        const joined = new Uint8Array(chunks.reduce((total, chunk) => total + chunk.length, 0));
+        chunks.reduce((position, chunk) => {
+          joined.set(chunk, position);
+          return position + chunk.length;
+        }, 0);
+        return major === 3 ? textDecoder.decode(joined) : joined;
+      }
+      case 4: {
+        const array: Array<any> = [];
+        for (let i = 0; indefinite ? !atBreak() : i < length; i += 1) {
+          array.push(read());
+        }
+        return array;
+      }
+      case 5: {
+        const object: any = {};
+        for (let i = 0; indefinite ? !atBreak() : i < length; i += 1) {
+          const key = read();
+          object[key] = read();
+        }
+        return object;
+      }
+      default:
+        // tag, we only need what it wraps
+        return read();
+    }
+  };
+
+  return read();
+}
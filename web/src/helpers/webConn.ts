@@ -1,5 +1,6 @@
 // Wrapper function for webrequests so we can change the used class or total backend logic
 import type { IApiResult } from "@/interfaces/IApiResult";
+import { decodeCbor, encodeCbor } from "@/helpers/cbor";
 
 export default class WebConn {
   public rootUrl: string | null = null;
@@ -17,16 +18,21 @@ export default class WebConn {
         mode: "cors", // no-cors, *cors, same-origin //no-cors doesn't give any data, only gives error about json parse (bug?)
         cache: "no-cache", // *default, no-cache, reload, force-cache, only-if-cached
         credentials: "omit", // include, *same-origin, omit
+        // cbor is smaller and quicker to make on the controller, errors still come back as json
         headers: {
-          "Content-Type": "application/json",
+          "Content-Type": "application/cbor",
+          Accept: "application/cbor, application/json",
         },
         // redirect: "follow", // manual, *follow, error
         // referrerPolicy: "no-referrer", // no-referrer, *no-referrer-when-downgrade, origin, origin-when-cross-origin, same-origin, strict-origin, strict-origin-when-cross-origin, unsafe-url
-        body: JSON.stringify(data), // body data type must match "Content-Type" header
+        body: encodeCbor(data), // body data type must match "Content-Type" header
       })
-        .then((result) => {
-          const apiResult = result.json();
-          resolve(apiResult);
+        .then(async (result) => {
+          if (result.headers.get("Content-Type")?.startsWith("application/cbor")) {
+            resolve(decodeCbor(await result.arrayBuffer()));
+          } else {
+            resolve(result.json());
+          }
         })
         .catch((error) => {
           console.error(error);
@@ -39,4 +45,31 @@ export default class WebConn {
         });
     });
   }
+
+  // runs the commands in order in one request, the results are in the same order
+  async doBatchRequest(commands: Array<any>): Promise<Array<IApiResult>> {
+    const results: any = await this.doPostRequest(commands);
+
+    if (!Array.isArray(results)) {
+      // the whole request failed, every command gets that result
+      return commands.map(() => results as IApiResult);
+    }
+
+    return results;
+  }
+
+  // live data pushed by the controller, only what changed is sent
+  openLiveSocket(onMessage: (data: any) => void, onClose: () => void): WebSocket {
+    const url = `${this.rootUrl}ws`.replace(/^http/, "ws");
+    const socket = new WebSocket(url);
+
+    socket.onmessage = (event) => {
+      onMessage(JSON.parse(event.data));
+    };
+    socket.onclose = () => {
+      onClose();
+    };
+
+    return socket;
+  }
 }
@@ -0,0 +1,5 @@
+// columnar history from the Data command, every channel has a value (or null) for each time
+export interface IHistory {
+  time: Array<number>;
+  [channel: string]: Array<number | null>;
+}
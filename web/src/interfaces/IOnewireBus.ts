@@ -0,0 +1,11 @@
+export interface IOnewireBus {
+  id: number;
+  type: number; // 0 1-Wire, 1 SPI, 2 virtual
+  pinNr: number;
+  maxSensors: number;
+  interval: number; // sample period in ms, 0 uses the global interval
+  misoPin?: number; // spi only
+  mosiPin?: number;
+  clkPin?: number;
+  sweepTime?: number; // runtime only, time in ms for a full sweep of the bus
+}
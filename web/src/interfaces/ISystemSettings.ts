@@ -1,10 +1,12 @@
 import type TemperatureScale from "@/enums/TemperatureScale";
+import type { IOnewireBus } from "./IOnewireBus";
 
 export interface ISystemSettings {
-  onewirePin: number;
+  onewireBuses: Array<IOnewireBus>;
   stirPin: number;
   buzzerPin: number;
   buzzerTime: number;
+  tempReadInterval: number;
   invertOutputs: boolean;
   mqttUri: string;
   temperatureScale: TemperatureScale;
@@ -1,5 +1,7 @@
 export interface ITempSensor {
   id: string; // js doesn't support uint64_t, so we convert to string
+  busId: number;
+  type: number; // 0 DS18B20, 1 MAX31865, 2 MAX31855, 3 mock
   color: string;
   name: string;
   show: boolean;
@@ -8,4 +10,11 @@ export interface ITempSensor {
   compensateAbsolute: number;
   compensateRelative: number;
   lastTemp: number;
+  resolution: number; // 0 is auto, otherwise 9-12 bit
+  activeResolution: number;
+  sampleRate: number;
+  csPin?: number; // spi sensors only
+  rtdNominal?: number; // MAX31865 only
+  refResistor?: number;
+  rtdWires?: number;
 }
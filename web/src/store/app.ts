@@ -38,13 +38,16 @@ export const useAppStore = () => {
         return;
       }
 
+      // we also get our schedules, in the same request
       const webConn = new WebConn(rootUrl.value);
-      const requestData = {
-        command: "GetSystemSettings",
-        data: null,
-      };
+      const [apiResult, schedulesResult] = await webConn.doBatchRequest([
+        { command: "GetSystemSettings", data: null },
+        { command: "GetMashSchedules", data: null },
+      ]);
 
-      const apiResult = await webConn?.doPostRequest(requestData);
+      if (schedulesResult !== undefined && schedulesResult.success) {
+        mashSchedules.value = schedulesResult.data;
+      }
 
       if (apiResult === undefined || apiResult.success === false) {
         return;
@@ -55,9 +58,6 @@ export const useAppStore = () => {
         tempUnit.value = "°F";
       }
 
-      // also get our schedules
-      getMashSchedules();
-
       systemSettingsLoaded.value = true;
     }
 